@@ -20,7 +20,16 @@ namespace AForge
     /// 
     /// <remarks><para>The class allows to parallel loop's iteration computing them in separate threads,
     /// what allows their simultaneous execution on multiple CPUs/cores.
-    /// </para></remarks>
+    /// </para>
+    /// 
+    /// <para>Loops are run by a pool of worker threads shared by all callers, so loops started at the
+    /// same time from different threads (for example, by image processing routines of several video
+    /// sources) run concurrently. Each thread keeps its own queue of loop's parts - it splits the range
+    /// of loop's iterations in halves while other threads need work, and threads running out of work
+    /// steal parts from queues of other threads. A thread calling <see cref="For(int, int, ForLoopBody)"/>
+    /// runs loop's iterations itself as well, so loops may be nested - a loop's body may start another
+    /// loop.</para>
+    /// </remarks>
     ///
     public sealed class Parallel
     {
@@ -32,31 +41,44 @@ namespace AForge
         /// 
         public delegate void ForLoopBody( int index );
 
+        /// <summary>
+        /// Delegate defining body of for-loop processing a range of loop's indexes.
+        /// </summary>
+        /// 
+        /// <param name="fromIndex">The first index of the range (inclusive).</param>
+        /// <param name="toIndex">The last index of the range (exclusive).</param>
+        /// 
+        public delegate void ForRangeBody( int fromIndex, int toIndex );
+
         // number of threads for parallel computations
         private static int threadsCount = System.Environment.ProcessorCount;
         // object used for synchronization
         private static object sync = new Object( );
 
-        // single instance of the class to implement singleton pattern
-        private static volatile Parallel instance = null;
-        // background threads for parallel computation
-        private Thread[] threads = null;
+        // number of worker threads, calling threads make the rest of threads
+        private static int workersCount = 0;
+        // queues of all threads running loops - worker threads and threads calling For()
+        private static volatile WorkQueue[] queues = new WorkQueue[0];
+        // queue of the current thread
+        [ThreadStatic]
+        private static WorkQueue localQueue;
 
-        // events to signal about job availability and thread availability
-        private AutoResetEvent[] jobAvailable = null;
-        private ManualResetEvent[] threadIdle = null;
+        // object idle worker threads wait on, number of such threads and counter of queued loop's parts,
+        // which lets workers notice parts queued while they were going to wait
+        private static object idleSync = new Object( );
+        private static int idleWorkers = 0;
+        private static int workVersion = 0;
 
-        // loop's body and its current and stop index
-        private int currentIndex;
-        private int stopIndex;
-        private ForLoopBody loopBody;
+        // number of loop's parts per thread to make, if all threads are available
+        private const int partsPerThread = 8;
 
         /// <summary>
         /// Number of threads used for parallel computations.
         /// </summary>
         /// 
-        /// <remarks><para>The property sets how many worker threads are created for paralleling
-        /// loops' computations.</para>
+        /// <remarks><para>The property sets how many threads run loops' computations - the thread
+        /// calling <see cref="For(int, int, ForLoopBody)"/> and the worker threads, which are created
+        /// for the rest. Worker threads are shared by all loops.</para>
         /// 
         /// <para>By default the property is set to number of CPU's in the system
         /// (see <see cref="System.Environment.ProcessorCount"/>).</para>
@@ -71,6 +93,12 @@ namespace AForge
                 {
                     threadsCount = System.Math.Max( 1, value );
                 }
+
+                // let extra workers finish
+                lock ( idleSync )
+                {
+                    Monitor.PulseAll( idleSync );
+                }
             }
         }
 
@@ -99,138 +127,467 @@ namespace AForge
         /// </code>
         /// </remarks>
         /// 
+        /// <exception cref="AggregateException">Loop's body has thrown an exception, which is kept as inner exception.</exception>
+        /// 
         public static void For( int start, int stop, ForLoopBody loopBody  )
         {
-            lock ( sync )
-            {
-                // get instance of parallel computation manager
-                Parallel instance = Instance;
+            For( start, stop, loopBody, CancellationToken.None );
+        }
 
-                instance.currentIndex   = start - 1;
-                instance.stopIndex      = stop;
-                instance.loopBody       = loopBody;
+        /// <summary>
+        /// Executes a for-loop in which iterations may run in parallel, which may be cancelled.
+        /// </summary>
+        /// 
+        /// <param name="start">Loop's start index.</param>
+        /// <param name="stop">Loop's stop index.</param>
+        /// <param name="loopBody">Loop's body.</param>
+        /// <param name="cancellationToken">Token to cancel the loop.</param>
+        /// 
+        /// <remarks><para>The method does the same as <see cref="For(int, int, ForLoopBody)"/>, but
+        /// stops starting new iterations as soon as cancellation of the loop is requested.</para></remarks>
+        /// 
+        /// <exception cref="OperationCanceledException">The loop was cancelled.</exception>
+        /// <exception cref="AggregateException">Loop's body has thrown an exception, which is kept as inner exception.</exception>
+        /// 
+        public static void For( int start, int stop, ForLoopBody loopBody, CancellationToken cancellationToken )
+        {
+            if ( loopBody == null )
+                throw new ArgumentNullException( "loopBody" );
 
-                // signal about available job for all threads and mark them busy
-                for ( int i = 0; i < threadsCount; i++ )
+            ForRange( start, stop, delegate( int fromIndex, int toIndex )
+            {
+                for ( int i = fromIndex; ( i < toIndex ) && ( !cancellationToken.IsCancellationRequested ); i++ )
                 {
-                    instance.threadIdle[i].Reset( );
-                    instance.jobAvailable[i].Set( );
+                    loopBody( i );
                 }
+            }, cancellationToken );
+        }
+
+        /// <summary>
+        /// Executes a for-loop, which ranges of iterations may run in parallel.
+        /// </summary>
+        /// 
+        /// <param name="start">Loop's start index.</param>
+        /// <param name="stop">Loop's stop index.</param>
+        /// <param name="rangeBody">Loop's body processing a range of indexes.</param>
+        /// 
+        /// <remarks><para>The method splits loop's indexes into ranges, which are given to the
+        /// loop's body. It allows to avoid calling loop's body for every index and to keep per
+        /// range state, like buffers or pointers.</para>
+        /// 
+        /// <para>Sample usage:</para>
+        /// <code>
+        /// Parallel.ForRange( 0, image.Height, delegate( int fromY, int toY )
+        /// {
+        ///     for ( int y = fromY; y &lt; toY; y++ )
+        ///     {
+        ///         // process image's row
+        ///     }
+        /// } );
+        /// </code>
+        /// </remarks>
+        /// 
+        /// <exception cref="AggregateException">Loop's body has thrown an exception, which is kept as inner exception.</exception>
+        /// 
+        public static void ForRange( int start, int stop, ForRangeBody rangeBody )
+        {
+            ForRange( start, stop, rangeBody, CancellationToken.None );
+        }
 
-                // wait until all threads become idle
-                for ( int i = 0; i < threadsCount; i++ )
+        /// <summary>
+        /// Executes a for-loop, which ranges of iterations may run in parallel and which may be cancelled.
+        /// </summary>
+        /// 
+        /// <param name="start">Loop's start index.</param>
+        /// <param name="stop">Loop's stop index.</param>
+        /// <param name="rangeBody">Loop's body processing a range of indexes.</param>
+        /// <param name="cancellationToken">Token to cancel the loop.</param>
+        /// 
+        /// <remarks><para>The method does the same as <see cref="ForRange(int, int, ForRangeBody)"/>, but
+        /// stops starting new ranges as soon as cancellation of the loop is requested.</para></remarks>
+        /// 
+        /// <exception cref="OperationCanceledException">The loop was cancelled.</exception>
+        /// <exception cref="AggregateException">Loop's body has thrown an exception, which is kept as inner exception.</exception>
+        /// 
+        public static void ForRange( int start, int stop, ForRangeBody rangeBody, CancellationToken cancellationToken )
+        {
+            if ( rangeBody == null )
+                throw new ArgumentNullException( "rangeBody" );
+
+            cancellationToken.ThrowIfCancellationRequested( );
+
+            if ( stop <= start )
+                return;
+
+            int threads = threadsCount;
+
+            if ( workersCount < threads - 1 )
+                StartWorkers( );
+
+            // size of the smallest part of the loop, the loop is split into bigger parts only
+            // while other threads have nothing to do
+            long partSize = ( (long) stop - start ) / ( threads * partsPerThread );
+            Loop loop = new Loop( rangeBody, cancellationToken, (int) System.Math.Max( 1, partSize ) );
+
+            // threads, which are not workers, get queue for the time of the loop
+            WorkQueue queue = localQueue;
+            bool temporaryQueue = ( queue == null );
+
+            if ( temporaryQueue )
+            {
+                queue = new WorkQueue( );
+                localQueue = queue;
+                AddQueue( queue );
+            }
+
+            try
+            {
+                Execute( new WorkItem( loop, start, stop ), queue );
+
+                // help other threads with the rest of the loop
+                while ( !loop.Completed.IsSet )
                 {
-                    instance.threadIdle[i].WaitOne( );
-                }
+                    WorkItem item = FindWork( queue, loop );
 
-                instance.loopBody = null;
+                    if ( item != null )
+                    {
+                        Execute( item, queue );
+                    }
+                    else
+                    {
+                        // new parts may be split by other threads, so check them from time to time
+                        loop.Completed.Wait( 1 );
+                    }
+                }
             }
+            finally
+            {
+                if ( temporaryQueue )
+                {
+                    RemoveQueue( queue );
+                    localQueue = null;
+                }
+            }
+
+            if ( loop.Error != null )
+                throw new AggregateException( loop.Error );
+
+            cancellationToken.ThrowIfCancellationRequested( );
         }
 
         // Private constructor to avoid class instantiation
         private Parallel( ) { }
 
-        // Get instace of the Parallel class
-        private static Parallel Instance
+        // Run part of a loop, splitting it in halves while other threads have nothing to take from this one
+        private static void Execute( WorkItem item, WorkQueue queue )
         {
-            get
+            Loop loop  = item.Loop;
+            int  from  = item.From;
+            int  to    = item.To;
+
+            try
             {
-                if ( instance == null )
+                while ( ( from < to ) && ( !loop.Stopped ) )
                 {
-                    instance = new Parallel( );
-                    instance.Initialize( );
+                    if ( loop.CancellationToken.IsCancellationRequested )
+                    {
+                        loop.Stopped = true;
+                        break;
+                    }
+
+                    long length = (long) to - from;
+
+                    if ( ( length > loop.PartSize ) && ( !queue.HasWorkOf( loop ) ) )
+                    {
+                        int middle = (int) ( from + length / 2 );
+
+                        Interlocked.Increment( ref loop.PendingParts );
+                        queue.Push( new WorkItem( loop, middle, to ) );
+                        SignalWork( );
+
+                        to = middle;
+                    }
+                    else
+                    {
+                        int partStop = ( length > loop.PartSize ) ? from + loop.PartSize : to;
+
+                        loop.Body( from, partStop );
+                        from = partStop;
+                    }
                 }
-                else
+            }
+            catch ( Exception ex )
+            {
+                Interlocked.CompareExchange( ref loop.Error, ex, null );
+                loop.Stopped = true;
+            }
+            finally
+            {
+                if ( Interlocked.Decrement( ref loop.PendingParts ) == 0 )
                 {
-                    if ( instance.threads.Length != threadsCount )
-                    {
-                        // terminate old threads
-                        instance.Terminate( );
-                        // reinitialize
-                        instance.Initialize( );
+                    loop.Completed.Set( );
+                }
+            }
+        }
+
+        // Find work in queue of the thread or in queues of other threads, taking only parts
+        // of the specified loop if it is set
+        private static WorkItem FindWork( WorkQueue queue, Loop loop )
+        {
+            WorkItem item = queue.Pop( loop );
+
+            if ( item == null )
+            {
+                WorkQueue[] all = queues;
+                int n = all.Length;
 
-                        // TODO: change reinitialization to reuse already created objects
+                // start from different queues, so thieves do not compete for the same queue
+                int first = ( n == 0 ) ? 0 : (int) ( (uint) queue.StealCounter++ % (uint) n );
+
+                for ( int i = 0; ( i < n ) && ( item == null ); i++ )
+                {
+                    WorkQueue victim = all[( first + i ) % n];
+
+                    if ( victim != queue )
+                    {
+                        item = victim.Steal( loop );
                     }
                 }
-                return instance;
             }
+
+            return item;
         }
 
-        // Initialize Parallel class's instance creating required number of threads
-        // and synchronization objects
-        private void Initialize( )
+        // Notify idle workers about new work
+        private static void SignalWork( )
         {
-            // array of events, which signal about available job
-            jobAvailable = new AutoResetEvent[threadsCount];
-            // array of events, which signal about available thread
-            threadIdle = new ManualResetEvent[threadsCount];
-            // array of threads
-            threads = new Thread[threadsCount];
+            Interlocked.Increment( ref workVersion );
+
+            if ( Thread.VolatileRead( ref idleWorkers ) != 0 )
+            {
+                lock ( idleSync )
+                {
+                    Monitor.Pulse( idleSync );
+                }
+            }
+        }
 
-            for ( int i = 0; i < threadsCount; i++ )
+        // Start worker threads, so their number corresponds to number of threads to use
+        private static void StartWorkers( )
+        {
+            lock ( sync )
             {
-                jobAvailable[i] = new AutoResetEvent( false );
-                threadIdle[i]   = new ManualResetEvent( true );
+                while ( workersCount < threadsCount - 1 )
+                {
+                    Thread thread = new Thread( new ThreadStart( WorkerThread ) );
+                    thread.Name = "AForge.Parallel";
+                    thread.IsBackground = true;
+                    thread.Start( );
 
-                threads[i] = new Thread( new ParameterizedThreadStart( WorkerThread ) );
-                threads[i].Name = "AForge.Parallel";
-                threads[i].IsBackground = true;
-                threads[i].Start( i );
+                    workersCount++;
+                }
             }
         }
 
-        // Terminate all worker threads used for parallel computations and close all
-        // synchronization objects
-        private void Terminate( )
+        // Add queue to the list of queues other threads may steal work from
+        private static void AddQueue( WorkQueue queue )
         {
-            // finish thread by setting null loop body and signaling about available work
-            loopBody = null;
-            for ( int i = 0, threadsCount = threads.Length ; i < threadsCount; i++ )
+            lock ( sync )
             {
-                jobAvailable[i].Set( );
-                // wait for thread termination
-                threads[i].Join( );
+                WorkQueue[] newQueues = new WorkQueue[queues.Length + 1];
+
+                Array.Copy( queues, newQueues, queues.Length );
+                newQueues[queues.Length] = queue;
 
-                // close events
-                jobAvailable[i].Close( );
-                threadIdle[i].Close( );
+                queues = newQueues;
             }
+        }
 
-            // clean all array references
-            jobAvailable    = null;
-            threadIdle      = null;
-            threads         = null;
+        // Remove queue from the list of queues other threads may steal work from
+        private static void RemoveQueue( WorkQueue queue )
+        {
+            lock ( sync )
+            {
+                int index = Array.IndexOf( queues, queue );
+
+                if ( index != -1 )
+                {
+                    WorkQueue[] newQueues = new WorkQueue[queues.Length - 1];
+
+                    Array.Copy( queues, 0, newQueues, 0, index );
+                    Array.Copy( queues, index + 1, newQueues, index, newQueues.Length - index );
+
+                    queues = newQueues;
+                }
+            }
         }
 
-        // Worker thread performing parallel computations in loop
-        private void WorkerThread( object index )
+        // Worker thread running parts of all loops
+        private static void WorkerThread( )
         {
-            int threadIndex = (int) index;
-            int localIndex = 0;
+            WorkQueue queue = new WorkQueue( );
+
+            localQueue = queue;
+            AddQueue( queue );
 
             while ( true )
             {
-                // wait until there is job to do
-                jobAvailable[threadIndex].WaitOne( );
-
-                // exit on null body
-                if ( loopBody == null )
-                    break;
+                int version = Thread.VolatileRead( ref workVersion );
+                WorkItem item = FindWork( queue, null );
 
-                while ( true )
+                if ( item != null )
                 {
-                    // get local index incrementing global loop's current index
-                    localIndex = Interlocked.Increment( ref currentIndex );
+                    Execute( item, queue );
+                    continue;
+                }
 
-                    if ( localIndex >= stopIndex )
+                // finish the thread if there are more workers than needed
+                lock ( sync )
+                {
+                    if ( workersCount > threadsCount - 1 )
+                    {
+                        workersCount--;
                         break;
+                    }
+                }
+
+                lock ( idleSync )
+                {
+                    // wait for work unless some was queued since the search
+                    Interlocked.Increment( ref idleWorkers );
+
+                    if ( version == Thread.VolatileRead( ref workVersion ) )
+                    {
+                        Monitor.Wait( idleSync );
+                    }
+
+                    Interlocked.Decrement( ref idleWorkers );
+                }
+            }
+
+            RemoveQueue( queue );
+            localQueue = null;
+        }
+
+        // State of a running loop
+        private sealed class Loop
+        {
+            public readonly ForRangeBody Body;
+            public readonly CancellationToken CancellationToken;
+            public readonly int PartSize;
+
+            // number of loop's parts, which are queued or running
+            public int PendingParts = 1;
+            public volatile bool Stopped = false;
+            public Exception Error = null;
+            public readonly ManualResetEventSlim Completed = new ManualResetEventSlim( false );
+
+            public Loop( ForRangeBody body, CancellationToken cancellationToken, int partSize )
+            {
+                Body = body;
+                CancellationToken = cancellationToken;
+                PartSize = partSize;
+            }
+        }
+
+        // Range of loop's indexes to process
+        private sealed class WorkItem
+        {
+            public readonly Loop Loop;
+            public readonly int From;
+            public readonly int To;
+
+            public WorkItem( Loop loop, int from, int to )
+            {
+                Loop = loop;
+                From = from;
+                To   = to;
+            }
+        }
+
+        // Queue of loops' parts of a thread - the thread adds and takes parts at the tail,
+        // other threads steal parts from the head, which are the biggest ones
+        private sealed class WorkQueue
+        {
+            private WorkItem[] items = new WorkItem[16];
+            private int head = 0;
+            private int tail = 0;
+
+            // counter used by the thread to choose queue to steal from
+            public int StealCounter = 0;
 
-                    // run loop's body
-                    loopBody( localIndex );
+            // Check if the most recently added part belongs to the specified loop
+            public bool HasWorkOf( Loop loop )
+            {
+                lock ( this )
+                {
+                    return ( tail != head ) && ( items[tail - 1].Loop == loop );
                 }
+            }
 
-                // signal about thread availability
-                threadIdle[threadIndex].Set( );
+            public void Push( WorkItem item )
+            {
+                lock ( this )
+                {
+                    if ( tail == items.Length )
+                    {
+                        int count = tail - head;
+
+                        // move parts to the beginning if most of the queue is free, or grow the queue
+                        if ( head > items.Length / 2 )
+                        {
+                            Array.Copy( items, head, items, 0, count );
+                            Array.Clear( items, count, tail - count );
+                        }
+                        else
+                        {
+                            WorkItem[] newItems = new WorkItem[items.Length * 2];
+                            Array.Copy( items, head, newItems, 0, count );
+                            items = newItems;
+                        }
+
+                        head = 0;
+                        tail = count;
+                    }
+
+                    items[tail++] = item;
+                }
+            }
+
+            // Take the most recently added part, if it belongs to the specified loop or any loop is accepted
+            public WorkItem Pop( Loop loop )
+            {
+                lock ( this )
+                {
+                    if ( ( tail == head ) || ( ( loop != null ) && ( items[tail - 1].Loop != loop ) ) )
+                        return null;
+
+                    WorkItem item = items[--tail];
+                    items[tail] = null;
+
+                    if ( tail == head )
+                        head = tail = 0;
+
+                    return item;
+                }
+            }
+
+            // Take the oldest part, if it belongs to the specified loop or any loop is accepted
+            public WorkItem Steal( Loop loop )
+            {
+                lock ( this )
+                {
+                    if ( ( tail == head ) || ( ( loop != null ) && ( items[head].Loop != loop ) ) )
+                        return null;
+
+                    WorkItem item = items[head];
+                    items[head++] = null;
+
+                    if ( tail == head )
+                        head = tail = 0;
+
+                    return item;
+                }
             }
         }
     }
@@ -74,6 +74,18 @@ namespace AForge.Imaging.Filters
             set { minError = value; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The threshold is calculated from the entire image, so the value is always -1.</para></remarks>
+        /// 
+        public override int StripRadius
+        {
+            get { return -1; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="IterativeThreshold"/> class.
         /// </summary>
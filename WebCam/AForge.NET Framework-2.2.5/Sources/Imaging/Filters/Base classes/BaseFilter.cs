@@ -31,6 +31,8 @@ namespace AForge.Imaging.Filters
     /// 
     public abstract class BaseFilter : IFilter, IFilterInformation
     {
+        private bool enableParallelProcessing = false;
+
         /// <summary>
         /// Format translations dictionary.
         /// </summary>
@@ -44,6 +46,25 @@ namespace AForge.Imaging.Filters
         ///
         public abstract Dictionary<PixelFormat, PixelFormat> FormatTranslations { get; }
 
+        /// <summary>
+        /// Enable or not parallel processing on multi-core CPUs.
+        /// </summary>
+        /// 
+        /// <remarks><para>If the property is set to <see langword="true"/> and the filter implements
+        /// <see cref="IStripFilter"/> interface, then image is split into horizontal bands, which are
+        /// processed in parallel using <see cref="AForge.Parallel"/>. Filters, which process pixel's neighbourhood,
+        /// get <see cref="IStripFilter.StripRadius"/> rows around each band, so the result is the same as the
+        /// result of processing the entire image.</para>
+        /// 
+        /// <para>Default value is set to <see langword="false"/>.</para>
+        /// </remarks>
+        /// 
+        public bool EnableParallelProcessing
+        {
+            get { return enableParallelProcessing; }
+            set { enableParallelProcessing = value; }
+        }
+
 		/// <summary>
 		/// Apply filter to an image.
 		/// </summary>
@@ -125,7 +146,7 @@ namespace AForge.Imaging.Filters
             try
             {
                 // process the filter
-                ProcessFilter( new UnmanagedImage( imageData ), new UnmanagedImage( dstData ) );
+                ProcessFilterInBands( new UnmanagedImage( imageData ), new UnmanagedImage( dstData ) );
             }
             finally
             {
@@ -159,7 +180,7 @@ namespace AForge.Imaging.Filters
             UnmanagedImage dstImage = UnmanagedImage.Create( image.Width, image.Height, FormatTranslations[image.PixelFormat] );
 
             // process the filter
-            ProcessFilter( image, dstImage );
+            ProcessFilterInBands( image, dstImage );
 
             return dstImage;
         }
@@ -201,7 +222,7 @@ namespace AForge.Imaging.Filters
             }
 
             // process the filter
-            ProcessFilter( sourceImage, destinationImage );
+            ProcessFilterInBands( sourceImage, destinationImage );
         }
 
         /// <summary>
@@ -213,6 +234,26 @@ namespace AForge.Imaging.Filters
         /// 
         protected abstract unsafe void ProcessFilter( UnmanagedImage sourceData, UnmanagedImage destinationData );
 
+        // Process the filter on the specified image splitting it into bands if parallel processing is enabled
+        private void ProcessFilterInBands( UnmanagedImage sourceData, UnmanagedImage destinationData )
+        {
+            int radius = ParallelBands.GetRadius( this, enableParallelProcessing, sourceData.Height );
+
+            if ( radius < 0 )
+            {
+                ProcessFilter( sourceData, destinationData );
+            }
+            else
+            {
+                ParallelBands.Process( sourceData, destinationData, new Rectangle( 0, 0, sourceData.Width, sourceData.Height ), radius,
+                    delegate( UnmanagedImage source, UnmanagedImage destination, Rectangle rect )
+                    {
+                        ProcessFilter( ParallelBands.GetRows( source, rect.Top, rect.Bottom ),
+                            ParallelBands.GetRows( destination, rect.Top, rect.Bottom ) );
+                    } );
+            }
+        }
+
         // Check pixel format of the source image
         private void CheckSourceFormat( PixelFormat pixelFormat )
         {
@@ -24,6 +24,8 @@ namespace AForge.Imaging.Filters
     /// 
     public abstract class BaseInPlaceFilter : IFilter, IInPlaceFilter, IFilterInformation
     {
+        private bool enableParallelProcessing = false;
+
         /// <summary>
         /// Format translations dictionary.
         /// </summary>
@@ -37,6 +39,25 @@ namespace AForge.Imaging.Filters
         ///
         public abstract Dictionary<PixelFormat, PixelFormat> FormatTranslations { get; }
 
+        /// <summary>
+        /// Enable or not parallel processing on multi-core CPUs.
+        /// </summary>
+        /// 
+        /// <remarks><para>If the property is set to <see langword="true"/> and the filter implements
+        /// <see cref="IStripFilter"/> interface, then image is split into horizontal bands, which are
+        /// processed in parallel using <see cref="AForge.Parallel"/>. Only filters processing each
+        /// pixel independently (see <see cref="IStripFilter.StripRadius"/>) are split into bands, since bands are
+        /// processed in place.</para>
+        /// 
+        /// <para>Default value is set to <see langword="false"/>.</para>
+        /// </remarks>
+        /// 
+        public bool EnableParallelProcessing
+        {
+            get { return enableParallelProcessing; }
+            set { enableParallelProcessing = value; }
+        }
+
         /// <summary>
         /// Apply filter to an image.
         /// </summary>
@@ -121,7 +142,7 @@ namespace AForge.Imaging.Filters
             try
             {
                 // process the filter
-                ProcessFilter( new UnmanagedImage( dstData ) );
+                ProcessFilterInBands( new UnmanagedImage( dstData ) );
             }
             finally
             {
@@ -216,7 +237,7 @@ namespace AForge.Imaging.Filters
             }
 
             // process the filter
-            ProcessFilter( destinationImage );
+            ProcessFilterInBands( destinationImage );
         }
 
         /// <summary>
@@ -242,7 +263,7 @@ namespace AForge.Imaging.Filters
             try
             {
                 // process the filter
-                ProcessFilter( new UnmanagedImage( data ) );
+                ProcessFilterInBands( new UnmanagedImage( data ) );
             }
             finally
             {
@@ -267,7 +288,7 @@ namespace AForge.Imaging.Filters
             CheckSourceFormat( imageData.PixelFormat );
 
             // process the filter
-            ProcessFilter( new UnmanagedImage( imageData ) );
+            ProcessFilterInBands( new UnmanagedImage( imageData ) );
         }
 
         /// <summary>
@@ -286,7 +307,7 @@ namespace AForge.Imaging.Filters
             CheckSourceFormat( image.PixelFormat );
 
             // process the filter
-            ProcessFilter( image );
+            ProcessFilterInBands( image );
         }
 
         /// <summary>
@@ -297,6 +318,23 @@ namespace AForge.Imaging.Filters
         ///
         protected abstract unsafe void ProcessFilter( UnmanagedImage image );
 
+        // Process the filter on the specified image splitting it into bands if parallel processing is enabled
+        private void ProcessFilterInBands( UnmanagedImage image )
+        {
+            if ( ParallelBands.GetRadius( this, enableParallelProcessing, image.Height ) != 0 )
+            {
+                ProcessFilter( image );
+            }
+            else
+            {
+                ParallelBands.Process( image, image, new Rectangle( 0, 0, image.Width, image.Height ), 0,
+                    delegate( UnmanagedImage source, UnmanagedImage destination, Rectangle rect )
+                    {
+                        ProcessFilter( ParallelBands.GetRows( destination, rect.Top, rect.Bottom ) );
+                    } );
+            }
+        }
+
         // Check pixel format of the source image
         private void CheckSourceFormat( PixelFormat pixelFormat )
         {
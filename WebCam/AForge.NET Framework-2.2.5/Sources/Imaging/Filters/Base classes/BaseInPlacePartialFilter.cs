@@ -25,6 +25,8 @@ namespace AForge.Imaging.Filters
     /// 
     public abstract class BaseInPlacePartialFilter : IFilter, IInPlaceFilter, IInPlacePartialFilter, IFilterInformation
     {
+        private bool enableParallelProcessing = false;
+
         /// <summary>
         /// Format translations dictionary.
         /// </summary>
@@ -38,6 +40,25 @@ namespace AForge.Imaging.Filters
         ///
         public abstract Dictionary<PixelFormat, PixelFormat> FormatTranslations { get; }
 
+        /// <summary>
+        /// Enable or not parallel processing on multi-core CPUs.
+        /// </summary>
+        /// 
+        /// <remarks><para>If the property is set to <see langword="true"/> and the filter implements
+        /// <see cref="IStripFilter"/> interface, then image is split into horizontal bands, which are
+        /// processed in parallel using <see cref="AForge.Parallel"/>. Only filters processing each
+        /// pixel independently (see <see cref="IStripFilter.StripRadius"/>) are split into bands, since bands are
+        /// processed in place.</para>
+        /// 
+        /// <para>Default value is set to <see langword="false"/>.</para>
+        /// </remarks>
+        /// 
+        public bool EnableParallelProcessing
+        {
+            get { return enableParallelProcessing; }
+            set { enableParallelProcessing = value; }
+        }
+
         /// <summary>
         /// Apply filter to an image.
         /// </summary>
@@ -122,7 +143,7 @@ namespace AForge.Imaging.Filters
             try
             {
                 // process the filter
-                ProcessFilter( new UnmanagedImage( dstData ), new Rectangle( 0, 0, width, height ) );
+                ProcessFilterInBands( new UnmanagedImage( dstData ), new Rectangle( 0, 0, width, height ) );
             }
             finally
             {
@@ -217,7 +238,7 @@ namespace AForge.Imaging.Filters
             }
 
             // process the filter
-            ProcessFilter( destinationImage, new Rectangle( 0, 0, destinationImage.Width, destinationImage.Height ) );
+            ProcessFilterInBands( destinationImage, new Rectangle( 0, 0, destinationImage.Width, destinationImage.Height ) );
         }
 
         /// <summary>
@@ -252,7 +273,7 @@ namespace AForge.Imaging.Filters
             CheckSourceFormat( imageData.PixelFormat );
 
             // apply the filter
-            ProcessFilter( new UnmanagedImage( imageData ), new Rectangle( 0, 0, imageData.Width, imageData.Height ) );
+            ProcessFilterInBands( new UnmanagedImage( imageData ), new Rectangle( 0, 0, imageData.Width, imageData.Height ) );
         }
 
         /// <summary>
@@ -271,7 +292,7 @@ namespace AForge.Imaging.Filters
             CheckSourceFormat( image.PixelFormat );
 
             // process the filter
-            ProcessFilter( image, new Rectangle( 0, 0, image.Width, image.Height ) );
+            ProcessFilterInBands( image, new Rectangle( 0, 0, image.Width, image.Height ) );
         }
 
         /// <summary>
@@ -342,7 +363,7 @@ namespace AForge.Imaging.Filters
 
             // process the filter if rectangle is not empty
             if ( ( rect.Width | rect.Height ) != 0 )
-                ProcessFilter( image, rect );
+                ProcessFilterInBands( image, rect );
         }
 
         /// <summary>
@@ -354,6 +375,23 @@ namespace AForge.Imaging.Filters
         ///
         protected abstract unsafe void ProcessFilter( UnmanagedImage image, Rectangle rect );
 
+        // Process the filter on the specified image splitting it into bands if parallel processing is enabled
+        private void ProcessFilterInBands( UnmanagedImage image, Rectangle rect )
+        {
+            if ( ParallelBands.GetRadius( this, enableParallelProcessing, rect.Height ) != 0 )
+            {
+                ProcessFilter( image, rect );
+            }
+            else
+            {
+                ParallelBands.Process( image, image, rect, 0,
+                    delegate( UnmanagedImage source, UnmanagedImage destination, Rectangle bandRect )
+                    {
+                        ProcessFilter( destination, bandRect );
+                    } );
+            }
+        }
+
         // Check pixel format of the source image
         private void CheckSourceFormat( PixelFormat pixelFormat )
         {
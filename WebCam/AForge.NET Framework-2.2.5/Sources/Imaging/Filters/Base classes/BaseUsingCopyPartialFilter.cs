@@ -34,6 +34,8 @@ namespace AForge.Imaging.Filters
     ///
     public abstract class BaseUsingCopyPartialFilter : IFilter, IInPlaceFilter, IInPlacePartialFilter, IFilterInformation
     {
+        private bool enableParallelProcessing = false;
+
         /// <summary>
         /// Format translations dictionary.
         /// </summary>
@@ -47,6 +49,26 @@ namespace AForge.Imaging.Filters
         ///
         public abstract Dictionary<PixelFormat, PixelFormat> FormatTranslations { get; }
 
+        /// <summary>
+        /// Enable or not parallel processing on multi-core CPUs.
+        /// </summary>
+        /// 
+        /// <remarks><para>If the property is set to <see langword="true"/> and the filter implements
+        /// <see cref="IStripFilter"/> interface, then image is split into horizontal bands, which are
+        /// processed in parallel using <see cref="AForge.Parallel"/>. Filters, which process pixel's neighbourhood,
+        /// get <see cref="IStripFilter.StripRadius"/> rows around each band, so the result is the same as the
+        /// result of processing the entire image. Filters, which do not implement the interface, may use the
+        /// property to run their own parallel processing.</para>
+        /// 
+        /// <para>Default value is set to <see langword="false"/>.</para>
+        /// </remarks>
+        /// 
+        public bool EnableParallelProcessing
+        {
+            get { return enableParallelProcessing; }
+            set { enableParallelProcessing = value; }
+        }
+
         /// <summary>
         /// Apply filter to an image.
         /// </summary>
@@ -128,7 +150,7 @@ namespace AForge.Imaging.Filters
             try
             {
                 // process the filter
-                ProcessFilter( new UnmanagedImage( imageData ), new UnmanagedImage( dstData ), new Rectangle( 0, 0, width, height ) );
+                ProcessFilterInBands( new UnmanagedImage( imageData ), new UnmanagedImage( dstData ), new Rectangle( 0, 0, width, height ) );
             }
             finally
             {
@@ -162,7 +184,7 @@ namespace AForge.Imaging.Filters
             UnmanagedImage dstImage = UnmanagedImage.Create( image.Width, image.Height, FormatTranslations[image.PixelFormat] );
 
             // process the filter
-            ProcessFilter( image, dstImage, new Rectangle( 0, 0, image.Width, image.Height ) );
+            ProcessFilterInBands( image, dstImage, new Rectangle( 0, 0, image.Width, image.Height ) );
 
             return dstImage;
         }
@@ -204,7 +226,7 @@ namespace AForge.Imaging.Filters
             }
 
             // process the filter
-            ProcessFilter( sourceImage, destinationImage, new Rectangle( 0, 0, sourceImage.Width, sourceImage.Height ) );
+            ProcessFilterInBands( sourceImage, destinationImage, new Rectangle( 0, 0, sourceImage.Width, sourceImage.Height ) );
         }
 
         /// <summary>
@@ -331,7 +353,7 @@ namespace AForge.Imaging.Filters
                 AForge.SystemTools.CopyUnmanagedMemory( imageCopy, image.ImageData, size );
 
                 // process the filter
-                ProcessFilter(
+                ProcessFilterInBands(
                     new UnmanagedImage( imageCopy, image.Width, image.Height, image.Stride, image.PixelFormat ),
                     image, rect );
 
@@ -349,6 +371,25 @@ namespace AForge.Imaging.Filters
         /// 
         protected abstract unsafe void ProcessFilter( UnmanagedImage sourceData, UnmanagedImage destinationData, Rectangle rect );
 
+        // Process the filter on the specified image splitting it into bands if parallel processing is enabled
+        private void ProcessFilterInBands( UnmanagedImage sourceData, UnmanagedImage destinationData, Rectangle rect )
+        {
+            int radius = ParallelBands.GetRadius( this, enableParallelProcessing, rect.Height );
+
+            if ( radius < 0 )
+            {
+                ProcessFilter( sourceData, destinationData, rect );
+            }
+            else
+            {
+                ParallelBands.Process( sourceData, destinationData, rect, radius,
+                    delegate( UnmanagedImage source, UnmanagedImage destination, Rectangle bandRect )
+                    {
+                        ProcessFilter( source, destination, bandRect );
+                    } );
+            }
+        }
+
         // Check pixel format of the source image
         private void CheckSourceFormat( PixelFormat pixelFormat )
         {
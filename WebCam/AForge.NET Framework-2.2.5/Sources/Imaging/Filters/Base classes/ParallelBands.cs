@@ -0,0 +1,167 @@
+﻿// AForge Image Processing Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2005-2011
+// contacts@aforgenet.com
+//
+
+namespace AForge.Imaging.Filters
+{
+    using System;
+    using System.Drawing;
+
+    /// <summary>
+    /// Helper class to process image by filters in horizontal bands running in parallel.
+    /// </summary>
+    /// 
+    /// <remarks><para>The class is used by base classes of filters, which implement
+    /// <see cref="IStripFilter"/> interface and have parallel processing enabled.</para></remarks>
+    /// 
+    internal static class ParallelBands
+    {
+        /// <summary>
+        /// Delegate processing the specified rectangle of source image and putting result to destination image.
+        /// </summary>
+        public delegate void ProcessRectangle( UnmanagedImage source, UnmanagedImage destination, Rectangle rect );
+
+        // minimum height of a band
+        private const int minBandHeight = 16;
+        // number of bands per thread
+        private const int bandsPerThread = 4;
+
+        /// <summary>
+        /// Get radius of the filter, if an image of the specified height should be processed by it in bands.
+        /// </summary>
+        /// 
+        /// <param name="filter">Filter to process image.</param>
+        /// <param name="enabled">Parallel processing is enabled for the filter or not.</param>
+        /// <param name="height">Height of image's part to process.</param>
+        /// 
+        /// <returns>Returns filter's <see cref="IStripFilter.StripRadius"/> or -1 if the image
+        /// should be processed as whole.</returns>
+        /// 
+        public static int GetRadius( object filter, bool enabled, int height )
+        {
+            IStripFilter stripFilter = filter as IStripFilter;
+
+            if ( ( !enabled ) || ( stripFilter == null ) || ( AForge.Parallel.ThreadsCount < 2 ) )
+                return -1;
+
+            int radius = stripFilter.StripRadius;
+
+            // there is no use to split small images
+            if ( ( radius < 0 ) || ( height < 2 * GetMinBandHeight( radius ) ) )
+                return -1;
+
+            return radius;
+        }
+
+        /// <summary>
+        /// Process rectangle of an image in bands running in parallel.
+        /// </summary>
+        /// 
+        /// <param name="source">Source image.</param>
+        /// <param name="destination">Destination image, which may be the same as source image for filters with zero radius.</param>
+        /// <param name="rect">Rectangle to process.</param>
+        /// <param name="radius">Filter's radius.</param>
+        /// <param name="process">Filter's processing routine.</param>
+        /// 
+        /// <remarks><para>Filters with zero radius get bands of the rectangle. Filters with non zero radius
+        /// get <paramref name="radius"/> more rows of the rectangle above and below a band, and result of
+        /// their processing is put into temporary image, so only band's rows are copied to destination image -
+        /// rows around a band are treated by filters as the edge of the image, so they are not complete.</para>
+        /// </remarks>
+        /// 
+        public static void Process( UnmanagedImage source, UnmanagedImage destination, Rectangle rect, int radius, ProcessRectangle process )
+        {
+            // rows are spread evenly between bands, so none of them is smaller than the minimum height
+            int bandsCount = Math.Max( 1, Math.Min( AForge.Parallel.ThreadsCount * bandsPerThread,
+                rect.Height / GetMinBandHeight( radius ) ) );
+
+            try
+            {
+                // ranges of neighbour bands make single band, so rows around it are processed only once
+                AForge.Parallel.ForRange( 0, bandsCount, delegate( int fromBand, int toBand )
+                {
+                    int startY = rect.Top + (int) ( (long) rect.Height * fromBand / bandsCount );
+                    int stopY  = rect.Top + (int) ( (long) rect.Height * toBand / bandsCount );
+
+                    if ( radius == 0 )
+                    {
+                        process( source, destination, new Rectangle( rect.Left, startY, rect.Width, stopY - startY ) );
+                    }
+                    else
+                    {
+                        ProcessBandWithRadius( source, destination, rect, startY, stopY, radius, process );
+                    }
+                } );
+            }
+            catch ( AggregateException ex )
+            {
+                // report errors the same way as they are reported by filters without parallel processing
+                throw ex.InnerException;
+            }
+        }
+
+        /// <summary>
+        /// Get rows of an image as separate image sharing memory with it.
+        /// </summary>
+        /// 
+        /// <param name="image">Image to get rows of.</param>
+        /// <param name="startY">The first row to get.</param>
+        /// <param name="stopY">Row next to the last row to get.</param>
+        /// 
+        /// <returns>Returns image, which must not be used after the original image is disposed.</returns>
+        /// 
+        public static unsafe UnmanagedImage GetRows( UnmanagedImage image, int startY, int stopY )
+        {
+            return new UnmanagedImage( (IntPtr) ( (byte*) image.ImageData.ToPointer( ) + startY * image.Stride ),
+                image.Width, stopY - startY, image.Stride, image.PixelFormat );
+        }
+
+        // Process band using rows around it and copy its rows to destination image
+        private static unsafe void ProcessBandWithRadius( UnmanagedImage source, UnmanagedImage destination, Rectangle rect,
+            int startY, int stopY, int radius, ProcessRectangle process )
+        {
+            int top    = Math.Max( rect.Top, startY - radius );
+            int bottom = Math.Min( rect.Bottom, stopY + radius );
+
+            int stride = destination.Stride;
+            int size   = stride * ( bottom - top );
+
+            IntPtr bandData = MemoryManager.Alloc( size );
+
+            try
+            {
+                UnmanagedImage band = new UnmanagedImage( bandData, destination.Width, bottom - top, stride, destination.PixelFormat );
+
+                process( GetRows( source, top, bottom ), band, new Rectangle( rect.Left, 0, rect.Width, bottom - top ) );
+
+                // copy band's rows of the rectangle
+                int pixelSize = System.Drawing.Image.GetPixelFormatSize( destination.PixelFormat ) / 8;
+                int lineSize  = rect.Width * pixelSize;
+
+                byte* src = (byte*) bandData.ToPointer( ) + ( startY - top ) * stride + rect.Left * pixelSize;
+                byte* dst = (byte*) destination.ImageData.ToPointer( ) + startY * stride + rect.Left * pixelSize;
+
+                for ( int y = startY; y < stopY; y++ )
+                {
+                    AForge.SystemTools.CopyUnmanagedMemory( dst, src, lineSize );
+                    src += stride;
+                    dst += stride;
+                }
+            }
+            finally
+            {
+                MemoryManager.Free( bandData );
+            }
+        }
+
+        // Get minimum height of a band, so rows around it are not too big part of processed rows
+        private static int GetMinBandHeight( int radius )
+        {
+            return Math.Max( minBandHeight, 4 * radius );
+        }
+    }
+}
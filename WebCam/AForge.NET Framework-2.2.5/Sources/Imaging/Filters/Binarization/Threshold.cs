@@ -41,7 +41,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/threshold.jpg" width="480" height="361" />
     /// </remarks>
     /// 
-    public class Threshold : BaseInPlacePartialFilter
+    public class Threshold : BaseInPlacePartialFilter, IStripFilter
     {
         /// <summary>
         /// Threshold value.
@@ -71,6 +71,19 @@ namespace AForge.Imaging.Filters
             set { threshold = value; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is set to 0.
+        /// Filters, which calculate threshold from the image, set it to -1.</para></remarks>
+        /// 
+        public virtual int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="Threshold"/> class.
         /// </summary>
@@ -47,7 +47,7 @@ namespace AForge.Imaging.Filters
     /// 
     /// <seealso cref="LevelsLinear"/>
     /// 
-    public class BrightnessCorrection : BaseInPlacePartialFilter
+    public class BrightnessCorrection : BaseInPlacePartialFilter, IStripFilter
     {
         private LevelsLinear baseFilter = new LevelsLinear( );
         private int adjustValue;
@@ -95,6 +95,18 @@ namespace AForge.Imaging.Filters
             get { return baseFilter.FormatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="BrightnessCorrection"/> class.
         /// </summary>
@@ -46,7 +46,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="HSLFiltering"/>
     /// <seealso cref="YCbCrFiltering"/>
     /// 
-    public class ColorFiltering : BaseInPlacePartialFilter
+    public class ColorFiltering : BaseInPlacePartialFilter, IStripFilter
     {
         private IntRange red   = new IntRange( 0, 255 );
         private IntRange green = new IntRange( 0, 255 );
@@ -68,6 +68,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         #region Public properties
 
         /// <summary>
@@ -45,7 +45,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/color_remapping.jpg" width="480" height="361" />
     /// </remarks>
     /// 
-    public class ColorRemapping : BaseInPlacePartialFilter
+    public class ColorRemapping : BaseInPlacePartialFilter, IStripFilter
     {
         // color maps
         private byte[] redMap;
@@ -64,6 +64,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// Remapping array for red color plane.
         /// </summary>
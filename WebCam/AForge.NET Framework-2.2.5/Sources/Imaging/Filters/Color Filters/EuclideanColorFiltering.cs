@@ -43,7 +43,7 @@ namespace AForge.Imaging.Filters
     /// 
     /// <seealso cref="ColorFiltering"/>
     /// 
-    public class EuclideanColorFiltering : BaseInPlacePartialFilter
+    public class EuclideanColorFiltering : BaseInPlacePartialFilter, IStripFilter
     {
         private short radius = 100;
         private RGB center = new RGB( 255, 255, 255 );
@@ -61,6 +61,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// RGB sphere's radius, [0, 450].
         /// </summary>
@@ -41,7 +41,7 @@ namespace AForge.Imaging.Filters
     /// 
     /// <seealso cref="ReplaceChannel"/>
     /// 
-    public class ExtractChannel : BaseFilter
+    public class ExtractChannel : BaseFilter, IStripFilter
     {
         private short channel = RGB.R;
 
@@ -56,6 +56,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// ARGB channel to extract.
         /// </summary>
@@ -36,7 +36,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/gamma.jpg" width="480" height="361" />
     /// </remarks>
     /// 
-    public class GammaCorrection : BaseInPlacePartialFilter
+    public class GammaCorrection : BaseInPlacePartialFilter, IStripFilter
     {
         private double gamma;
         private byte[] table = new byte[256];
@@ -52,6 +52,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// Gamma value, [0.1, 5.0].
         /// </summary>
@@ -43,7 +43,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="GrayscaleRMY"/>
     /// <seealso cref="GrayscaleY"/>
     ///
-    public class Grayscale : BaseFilter
+    public class Grayscale : BaseFilter, IStripFilter
     {
         /// <summary>
         /// Set of predefined common grayscaling algorithms, which have aldready initialized
@@ -141,6 +141,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="Grayscale"/> class.
         /// </summary>
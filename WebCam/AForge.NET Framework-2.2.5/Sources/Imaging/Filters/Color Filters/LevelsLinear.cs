@@ -45,7 +45,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="HSLLinear"/>
     /// <seealso cref="YCbCrLinear"/>
     /// 
-    public class LevelsLinear : BaseInPlacePartialFilter
+    public class LevelsLinear : BaseInPlacePartialFilter, IStripFilter
     {
         private IntRange inRed = new IntRange(0, 255);
         private IntRange inGreen = new IntRange(0, 255);
@@ -70,6 +70,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         #region Public Propertis
 
         /// <summary>
@@ -66,7 +66,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/sepia.jpg" width="480" height="361" />
     /// </remarks> 
     ///
-    public sealed class Sepia : BaseInPlacePartialFilter
+    public sealed class Sepia : BaseInPlacePartialFilter, IStripFilter
     {
         // private format translation dictionary
         private Dictionary<PixelFormat, PixelFormat> formatTranslations = new Dictionary<PixelFormat, PixelFormat>( );
@@ -79,6 +79,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter processes each pixel independently, so the value is always 0.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 0; }
+        }
+
         /// <summary>   
         /// Initializes a new instance of the <see cref="Sepia"/> class.
         /// </summary>
@@ -50,7 +50,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/emboss.jpg" width="480" height="361" />
     /// </remarks>
 	/// 
-    public class Convolution : BaseUsingCopyPartialFilter
+    public class Convolution : BaseUsingCopyPartialFilter, IStripFilter
 	{
         // convolution kernel
         private int[,] kernel;
@@ -186,6 +186,18 @@ namespace AForge.Imaging.Filters
             set { processAlpha = value; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value equals to radius of the convolution <see cref="Kernel">kernel</see>.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return size >> 1; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="Convolution"/> class.
         /// </summary>
@@ -273,33 +285,40 @@ namespace AForge.Imaging.Filters
                 int srcStride = source.Stride;
                 int dstStride = destination.Stride;
 
-                int srcOffset = srcStride - rect.Width * pixelSize;
-                int dstOffset = dstStride - rect.Width * pixelSize;
-
                 byte* src = (byte*) source.ImageData.ToPointer( );
                 byte* dst = (byte*) destination.ImageData.ToPointer( );
 
-                // allign pointers to the first pixel to process
-                src += ( startY * srcStride + startX * pixelSize );
-                dst += ( startY * dstStride + startX * pixelSize );
+                // part of the rectangle, where kernel does not go out of its edges
+                int radius = size >> 1;
+                Rectangle interior = rect;
+                interior.Inflate( -radius, -radius );
 
-                // do the processing job
-                if ( destination.PixelFormat == PixelFormat.Format8bppIndexed )
+                if ( ( interior.Width > 0 ) && ( interior.Height > 0 ) && ( CanProcessInterior( ) ) )
                 {
-                    // grayscale image
-                    Process8bppImage( src, dst, srcStride, dstStride, srcOffset, dstOffset, startX, startY, stopX, stopY );
-                }
-                else
-                {
-                    // RGB image
-                    if ( ( pixelSize == 3 ) || ( !processAlpha ) )
+                    bool copyAlpha = ( pixelSize == 4 ) && ( !processAlpha );
+
+                    if ( ( radius <= 2 ) && ( IsKernelSymmetric( ) ) )
                     {
-                        Process24bppImage( src, dst, srcStride, dstStride, srcOffset, dstOffset, startX, startY, stopX, stopY, pixelSize );
+                        ProcessSymmetricInterior( src, dst, srcStride, dstStride, rect, pixelSize, copyAlpha );
                     }
                     else
                     {
-                        Process32bppImage( src, dst, srcStride, dstStride, srcOffset, dstOffset, startX, startY, stopX, stopY );
+                        ProcessInterior( src, dst, srcStride, dstStride, rect, pixelSize, copyAlpha );
                     }
+
+                    // process edges, where dynamic divisor may be required
+                    ProcessByteImage( src, dst, srcStride, dstStride, rect, pixelSize,
+                        new Rectangle( startX, startY, rect.Width, radius ) );
+                    ProcessByteImage( src, dst, srcStride, dstStride, rect, pixelSize,
+                        new Rectangle( startX, interior.Bottom, rect.Width, radius ) );
+                    ProcessByteImage( src, dst, srcStride, dstStride, rect, pixelSize,
+                        new Rectangle( startX, interior.Top, radius, interior.Height ) );
+                    ProcessByteImage( src, dst, srcStride, dstStride, rect, pixelSize,
+                        new Rectangle( interior.Right, interior.Top, radius, interior.Height ) );
+                }
+                else
+                {
+                    ProcessByteImage( src, dst, srcStride, dstStride, rect, pixelSize, rect );
                 }
             }
             else
@@ -337,10 +356,469 @@ namespace AForge.Imaging.Filters
             }
         }
 
+        // Process the specified area of 8 bpp, 24 bpp or 32 bpp image, checking for each kernel element
+        // if it is inside of the rectangle
+        private unsafe void ProcessByteImage( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                              Rectangle rect, int pixelSize, Rectangle area )
+        {
+            if ( ( area.Width <= 0 ) || ( area.Height <= 0 ) )
+                return;
+
+            // processing start and stop X,Y positions
+            int startX  = rect.Left;
+            int startY  = rect.Top;
+            int stopX   = startX + rect.Width;
+            int stopY   = startY + rect.Height;
+
+            if ( pixelSize == 1 )
+            {
+                // grayscale image
+                Process8bppImage( baseSrc, baseDst, srcStride, dstStride, startX, startY, stopX, stopY, area );
+            }
+            else
+            {
+                // RGB image
+                if ( ( pixelSize == 3 ) || ( !processAlpha ) )
+                {
+                    Process24bppImage( baseSrc, baseDst, srcStride, dstStride, startX, startY, stopX, stopY, area, pixelSize );
+                }
+                else
+                {
+                    Process32bppImage( baseSrc, baseDst, srcStride, dstStride, startX, startY, stopX, stopY, area );
+                }
+            }
+        }
+
+        // Check if integer sums of interior processing can not overflow
+        private bool CanProcessInterior( )
+        {
+            long sum = 0;
+
+            for ( int i = 0; i < size; i++ )
+            {
+                for ( int j = 0; j < size; j++ )
+                {
+                    sum += Math.Abs( (long) kernel[i, j] );
+                }
+            }
+
+            return ( sum * 255 <= int.MaxValue );
+        }
+
+        // Check if kernel does not change being flipped vertically or horizontally
+        private bool IsKernelSymmetric( )
+        {
+            for ( int i = 0; i < size; i++ )
+            {
+                for ( int j = 0; j < size; j++ )
+                {
+                    if ( ( kernel[i, j] != kernel[size - 1 - i, j] ) || ( kernel[i, j] != kernel[i, size - 1 - j] ) )
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        // Process the part of 8 bpp, 24 bpp or 32 bpp image, where symmetric 3x3 or 5x5 kernel does not go
+        // out of the rectangle. The first pass sums each column of the kernel with rows at the same distance
+        // from the center, and the second pass sums the results at the same distance from the pixel.
+        private unsafe void ProcessSymmetricInterior( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                                      Rectangle rect, int pixelSize, bool copyAlpha )
+        {
+            // kernel's radius
+            int radius = size >> 1;
+
+            // rows are processed as arrays of bytes, since all channels are convolved the same way
+            int lineSize   = rect.Width * pixelSize;
+            int startN     = radius * pixelSize;
+            int stopN      = lineSize - startN;
+
+            int p1 = pixelSize;
+            int p2 = pixelSize * 2;
+
+            // quarter of the kernel, the first index is distance from the center row
+            int k00 = kernel[radius, radius];
+            int k01 = kernel[radius, radius + 1];
+            int k10 = kernel[radius + 1, radius];
+            int k11 = kernel[radius + 1, radius + 1];
+            int k02 = 0, k12 = 0, k20 = 0, k21 = 0, k22 = 0;
+
+            if ( radius == 2 )
+            {
+                k02 = kernel[2, 4];
+                k12 = kernel[3, 4];
+                k20 = kernel[4, 2];
+                k21 = kernel[4, 3];
+                k22 = kernel[4, 4];
+            }
+
+            // weighted sums of rows for kernel's columns at distance 0, 1 and 2 from the center
+            int[] columnSums0 = new int[lineSize];
+            int[] columnSums1 = new int[lineSize];
+            int[] columnSums2 = new int[( radius == 2 ) ? lineSize : 1];
+
+            fixed ( int* c0 = columnSums0, c1 = columnSums1, c2 = columnSums2 )
+            {
+                for ( int y = rect.Top + radius, stopY = rect.Bottom - radius; y < stopY; y++ )
+                {
+                    byte* src = baseSrc + y * srcStride + rect.Left * pixelSize;
+                    byte* dst = baseDst + y * dstStride + rect.Left * pixelSize;
+                    long g;
+
+                    if ( radius == 1 )
+                    {
+                        byte* up   = src - srcStride;
+                        byte* down = src + srcStride;
+
+                        for ( int n = 0; n < lineSize; n++ )
+                        {
+                            int v0 = src[n];
+                            int v1 = up[n] + down[n];
+
+                            c0[n] = k00 * v0 + k10 * v1;
+                            c1[n] = k01 * v0 + k11 * v1;
+                        }
+
+                        for ( int n = startN; n < stopN; n++ )
+                        {
+                            g = ( c0[n] + c1[n - p1] + c1[n + p1] ) / divisor + threshold;
+                            dst[n] = (byte) ( ( g > 255 ) ? 255 : ( ( g < 0 ) ? 0 : g ) );
+                        }
+                    }
+                    else
+                    {
+                        byte* up1   = src - srcStride;
+                        byte* down1 = src + srcStride;
+                        byte* up2   = up1 - srcStride;
+                        byte* down2 = down1 + srcStride;
+
+                        for ( int n = 0; n < lineSize; n++ )
+                        {
+                            int v0 = src[n];
+                            int v1 = up1[n] + down1[n];
+                            int v2 = up2[n] + down2[n];
+
+                            c0[n] = k00 * v0 + k10 * v1 + k20 * v2;
+                            c1[n] = k01 * v0 + k11 * v1 + k21 * v2;
+                            c2[n] = k02 * v0 + k12 * v1 + k22 * v2;
+                        }
+
+                        for ( int n = startN; n < stopN; n++ )
+                        {
+                            g = ( c0[n] + c1[n - p1] + c1[n + p1] + c2[n - p2] + c2[n + p2] ) / divisor + threshold;
+                            dst[n] = (byte) ( ( g > 255 ) ? 255 : ( ( g < 0 ) ? 0 : g ) );
+                        }
+                    }
+
+                    // take care of alpha channel
+                    if ( copyAlpha )
+                    {
+                        for ( int n = startN + RGB.A; n < stopN; n += 4 )
+                        {
+                            dst[n] = src[n];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Process the part of 8 bpp, 24 bpp or 32 bpp image, where kernel does not go out of the rectangle.
+        // The kernel is decomposed into one dimensional kernels (single pair for separable kernels), so
+        // each row is calculated by passes over contiguous integer buffers without any edge checks.
+        private unsafe void ProcessInterior( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                             Rectangle rect, int pixelSize, bool copyAlpha )
+        {
+            // kernel's radius
+            int radius = size >> 1;
+
+            List<int[]> verticalKernels   = new List<int[]>( );
+            List<int[]> horizontalKernels = new List<int[]>( );
+
+            DecomposeKernel( verticalKernels, horizontalKernels );
+
+            int termsCount = verticalKernels.Count;
+
+            // non zero elements of one dimensional kernels
+            int[][] rowIndexes    = new int[termsCount][];
+            int[][] rowWeights    = new int[termsCount][];
+            int[][] columnOffsets = new int[termsCount][];
+            int[][] columnWeights = new int[termsCount][];
+
+            for ( int t = 0; t < termsCount; t++ )
+            {
+                GetKernelTaps( verticalKernels[t], 1, 0, out rowIndexes[t], out rowWeights[t] );
+                GetKernelTaps( horizontalKernels[t], pixelSize, radius, out columnOffsets[t], out columnWeights[t] );
+            }
+
+            // rows are processed as arrays of bytes, since all channels are convolved the same way
+            int lineSize   = rect.Width * pixelSize;
+            int startN     = radius * pixelSize;
+            int stopN      = lineSize - startN;
+
+            int[] rowsSum  = new int[lineSize];
+            int[] sums     = new int[lineSize];
+
+            // source rows covered by kernel
+            byte** rows = stackalloc byte*[size];
+
+            fixed ( int* rowsSumPtr = rowsSum, sumsPtr = sums )
+            {
+                for ( int y = rect.Top + radius, stopY = rect.Bottom - radius; y < stopY; y++ )
+                {
+                    for ( int i = 0; i < size; i++ )
+                    {
+                        rows[i] = baseSrc + ( y + i - radius ) * srcStride + rect.Left * pixelSize;
+                    }
+
+                    for ( int t = 0; t < termsCount; t++ )
+                    {
+                        SumRows( rows, rowIndexes[t], rowWeights[t], rowsSumPtr, lineSize );
+                        ConvolveRow( rowsSumPtr, columnOffsets[t], columnWeights[t], sumsPtr, startN, stopN, t != 0 );
+                    }
+
+                    byte* dst = baseDst + y * dstStride + rect.Left * pixelSize;
+                    long g;
+
+                    for ( int n = startN; n < stopN; n++ )
+                    {
+                        g = sumsPtr[n] / divisor + threshold;
+                        dst[n] = (byte) ( ( g > 255 ) ? 255 : ( ( g < 0 ) ? 0 : g ) );
+                    }
+
+                    // take care of alpha channel
+                    if ( copyAlpha )
+                    {
+                        byte* src = rows[radius];
+
+                        for ( int n = startN + RGB.A; n < stopN; n += 4 )
+                        {
+                            dst[n] = src[n];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Decompose kernel into sum of products of vertical and horizontal one dimensional kernels - kernel's
+        // rows, which are multiples of the same row of integers, make single term
+        private void DecomposeKernel( List<int[]> verticalKernels, List<int[]> horizontalKernels )
+        {
+            for ( int i = 0; i < size; i++ )
+            {
+                // greatest common divisor of row's elements, which sign is the sign of its first non zero element
+                int factor = 0;
+                int sign   = 0;
+
+                for ( int j = 0; j < size; j++ )
+                {
+                    factor = GreatestCommonDivisor( factor, Math.Abs( kernel[i, j] ) );
+
+                    if ( sign == 0 )
+                        sign = Math.Sign( kernel[i, j] );
+                }
+
+                // skip zero row
+                if ( factor == 0 )
+                    continue;
+
+                factor *= sign;
+
+                int[] row = new int[size];
+
+                for ( int j = 0; j < size; j++ )
+                {
+                    row[j] = kernel[i, j] / factor;
+                }
+
+                // find term with the same row
+                int term = 0;
+
+                for ( ; term < horizontalKernels.Count; term++ )
+                {
+                    int[] termRow = horizontalKernels[term];
+                    int j = 0;
+
+                    while ( ( j < size ) && ( termRow[j] == row[j] ) )
+                        j++;
+
+                    if ( j == size )
+                        break;
+                }
+
+                if ( term == horizontalKernels.Count )
+                {
+                    verticalKernels.Add( new int[size] );
+                    horizontalKernels.Add( row );
+                }
+
+                verticalKernels[term][i] = factor;
+            }
+
+            // kernel of zeros makes single term of zeros
+            if ( horizontalKernels.Count == 0 )
+            {
+                verticalKernels.Add( new int[size] );
+                horizontalKernels.Add( new int[size] );
+            }
+        }
+
+        // Calculate greatest common divisor of two non negative numbers
+        private static int GreatestCommonDivisor( int a, int b )
+        {
+            while ( b != 0 )
+            {
+                int t = a % b;
+                a = b;
+                b = t;
+            }
+            return a;
+        }
+
+        // Get non zero elements of one dimensional kernel as indexes and weights, padded with zero
+        // weights, so elements are split into groups of five and the last group of three or five
+        private static void GetKernelTaps( int[] kernel, int scale, int zeroIndex, out int[] indexes, out int[] weights )
+        {
+            int count = 0;
+
+            for ( int i = 0; i < kernel.Length; i++ )
+            {
+                if ( kernel[i] != 0 )
+                    count++;
+            }
+
+            int paddedCount = 0;
+
+            while ( count - paddedCount > 5 )
+                paddedCount += 5;
+            paddedCount += ( count - paddedCount > 3 ) ? 5 : 3;
+
+            indexes = new int[paddedCount];
+            weights = new int[paddedCount];
+
+            for ( int i = 0, j = 0; i < paddedCount; i++ )
+            {
+                while ( ( j < kernel.Length ) && ( kernel[j] == 0 ) )
+                    j++;
+
+                if ( j < kernel.Length )
+                {
+                    indexes[i] = ( j - zeroIndex ) * scale;
+                    weights[i] = kernel[j];
+                    j++;
+                }
+                else
+                {
+                    // padding element, which points to the center of the kernel
+                    indexes[i] = 0;
+                    weights[i] = 0;
+                }
+            }
+        }
+
+        // Calculate weighted sum of rows, taking up to five rows per pass
+        private static unsafe void SumRows( byte** rows, int[] indexes, int[] weights, int* sum, int length )
+        {
+            for ( int i = 0; i < indexes.Length; )
+            {
+                byte* r0 = rows[indexes[i]];
+                byte* r1 = rows[indexes[i + 1]];
+                byte* r2 = rows[indexes[i + 2]];
+
+                int k0 = weights[i];
+                int k1 = weights[i + 1];
+                int k2 = weights[i + 2];
+
+                if ( indexes.Length - i == 3 )
+                {
+                    if ( i == 0 )
+                    {
+                        for ( int n = 0; n < length; n++ )
+                            sum[n] = k0 * r0[n] + k1 * r1[n] + k2 * r2[n];
+                    }
+                    else
+                    {
+                        for ( int n = 0; n < length; n++ )
+                            sum[n] += k0 * r0[n] + k1 * r1[n] + k2 * r2[n];
+                    }
+                    i += 3;
+                }
+                else
+                {
+                    byte* r3 = rows[indexes[i + 3]];
+                    byte* r4 = rows[indexes[i + 4]];
+
+                    int k3 = weights[i + 3];
+                    int k4 = weights[i + 4];
+
+                    if ( i == 0 )
+                    {
+                        for ( int n = 0; n < length; n++ )
+                            sum[n] = k0 * r0[n] + k1 * r1[n] + k2 * r2[n] + k3 * r3[n] + k4 * r4[n];
+                    }
+                    else
+                    {
+                        for ( int n = 0; n < length; n++ )
+                            sum[n] += k0 * r0[n] + k1 * r1[n] + k2 * r2[n] + k3 * r3[n] + k4 * r4[n];
+                    }
+                    i += 5;
+                }
+            }
+        }
+
+        // Convolve row with one dimensional kernel, taking up to five kernel elements per pass, and
+        // put result to sums or add it to them
+        private static unsafe void ConvolveRow( int* row, int[] offsets, int[] weights, int* sum, int start, int stop, bool add )
+        {
+            for ( int i = 0; i < offsets.Length; )
+            {
+                int* p0 = row + offsets[i];
+                int* p1 = row + offsets[i + 1];
+                int* p2 = row + offsets[i + 2];
+
+                int k0 = weights[i];
+                int k1 = weights[i + 1];
+                int k2 = weights[i + 2];
+
+                if ( offsets.Length - i == 3 )
+                {
+                    if ( ( i == 0 ) && ( !add ) )
+                    {
+                        for ( int n = start; n < stop; n++ )
+                            sum[n] = k0 * p0[n] + k1 * p1[n] + k2 * p2[n];
+                    }
+                    else
+                    {
+                        for ( int n = start; n < stop; n++ )
+                            sum[n] += k0 * p0[n] + k1 * p1[n] + k2 * p2[n];
+                    }
+                    i += 3;
+                }
+                else
+                {
+                    int* p3 = row + offsets[i + 3];
+                    int* p4 = row + offsets[i + 4];
+
+                    int k3 = weights[i + 3];
+                    int k4 = weights[i + 4];
+
+                    if ( ( i == 0 ) && ( !add ) )
+                    {
+                        for ( int n = start; n < stop; n++ )
+                            sum[n] = k0 * p0[n] + k1 * p1[n] + k2 * p2[n] + k3 * p3[n] + k4 * p4[n];
+                    }
+                    else
+                    {
+                        for ( int n = start; n < stop; n++ )
+                            sum[n] += k0 * p0[n] + k1 * p1[n] + k2 * p2[n] + k3 * p3[n] + k4 * p4[n];
+                    }
+                    i += 5;
+                }
+            }
+        }
+
         // Process 8 bpp grayscale images
-        private unsafe void Process8bppImage( byte* src, byte* dst,
-                                              int srcStride, int dstStride, int srcOffset, int dstOffset,
-                                              int startX, int startY, int stopX, int stopY )
+        private unsafe void Process8bppImage( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                              int startX, int startY, int stopX, int stopY, Rectangle area )
         {
             // loop and array indexes
             int i, j, t, k, ir, jr;
@@ -355,10 +833,13 @@ namespace AForge.Imaging.Filters
             int processedKernelSize;
 
             // for each line
-            for ( int y = startY; y < stopY; y++ )
+            for ( int y = area.Top; y < area.Bottom; y++ )
             {
+                byte* src = baseSrc + y * srcStride + area.Left;
+                byte* dst = baseDst + y * dstStride + area.Left;
+
                 // for each pixel
-                for ( int x = startX; x < stopX; x++, src++, dst++ )
+                for ( int x = area.Left; x < area.Right; x++, src++, dst++ )
                 {
                     g = div = processedKernelSize = 0;
 
@@ -420,15 +901,12 @@ namespace AForge.Imaging.Filters
                     g += threshold;
                     *dst = (byte) ( ( g > 255 ) ? 255 : ( ( g < 0 ) ? 0 : g ) );
                 }
-                src += srcOffset;
-                dst += dstOffset;
             }
         }
 
         // Process 24 bpp images or 32 bpp images with copying alpha channel
-        private unsafe void Process24bppImage( byte* src, byte* dst,
-                                               int srcStride, int dstStride, int srcOffset, int dstOffset,
-                                               int startX, int startY, int stopX, int stopY, int pixelSize )
+        private unsafe void Process24bppImage( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                               int startX, int startY, int stopX, int stopY, Rectangle area, int pixelSize )
         {
             // loop and array indexes
             int i, j, t, k, ir, jr;
@@ -445,10 +923,13 @@ namespace AForge.Imaging.Filters
             byte* p;
 
             // for each line
-            for ( int y = startY; y < stopY; y++ )
+            for ( int y = area.Top; y < area.Bottom; y++ )
             {
+                byte* src = baseSrc + y * srcStride + area.Left * pixelSize;
+                byte* dst = baseDst + y * dstStride + area.Left * pixelSize;
+
                 // for each pixel
-                for ( int x = startX; x < stopX; x++, src += pixelSize, dst += pixelSize )
+                for ( int x = area.Left; x < area.Right; x++, src += pixelSize, dst += pixelSize )
                 {
                     r = g = b = div = processedKernelSize = 0;
 
@@ -526,15 +1007,12 @@ namespace AForge.Imaging.Filters
                     if ( pixelSize == 4 )
                         dst[RGB.A] = src[RGB.A];
                 }
-                src += srcOffset;
-                dst += dstOffset;
             }
         }
 
         // Process 32 bpp images including alpha channel
-        private unsafe void Process32bppImage( byte* src, byte* dst,
-                                               int srcStride, int dstStride, int srcOffset, int dstOffset,
-                                               int startX, int startY, int stopX, int stopY )
+        private unsafe void Process32bppImage( byte* baseSrc, byte* baseDst, int srcStride, int dstStride,
+                                               int startX, int startY, int stopX, int stopY, Rectangle area )
         {
             // loop and array indexes
             int i, j, t, k, ir, jr;
@@ -551,10 +1029,13 @@ namespace AForge.Imaging.Filters
             byte* p;
 
             // for each line
-            for ( int y = startY; y < stopY; y++ )
+            for ( int y = area.Top; y < area.Bottom; y++ )
             {
+                byte* src = baseSrc + y * srcStride + area.Left * 4;
+                byte* dst = baseDst + y * dstStride + area.Left * 4;
+
                 // for each pixel
-                for ( int x = startX; x < stopX; x++, src += 4, dst += 4 )
+                for ( int x = area.Left; x < area.Right; x++, src += 4, dst += 4 )
                 {
                     r = g = b = a = div = processedKernelSize = 0;
 
@@ -632,8 +1113,6 @@ namespace AForge.Imaging.Filters
                     dst[RGB.B] = (byte) ( ( b > 255 ) ? 255 : ( ( b < 0 ) ? 0 : b ) );
                     dst[RGB.A] = (byte) ( ( a > 255 ) ? 255 : ( ( a < 0 ) ? 0 : a ) );
                 }
-                src += srcOffset;
-                dst += dstOffset;
             }
         }
 
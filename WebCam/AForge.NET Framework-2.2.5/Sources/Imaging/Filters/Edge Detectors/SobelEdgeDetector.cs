@@ -61,7 +61,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="DifferenceEdgeDetector"/>
     /// <seealso cref="HomogenityEdgeDetector"/>
     /// 
-    public class SobelEdgeDetector : BaseUsingCopyPartialFilter
+    public class SobelEdgeDetector : BaseUsingCopyPartialFilter, IStripFilter
     {
         private bool scaleIntensity = true;
 
@@ -93,6 +93,20 @@ namespace AForge.Imaging.Filters
             set { scaleIntensity = value; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value is set to 1, which is radius of Sobel operator. If
+        /// <see cref="ScaleIntensity">intensity scaling</see> is enabled, the value is set to -1,
+        /// since scaling factor is found from the entire image.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return ( scaleIntensity ) ? -1 : 1; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="SobelEdgeDetector"/> class.
         /// </summary>
@@ -12,6 +12,7 @@ namespace AForge.Imaging.Filters
 	using System.Drawing;
 	using System.Drawing.Imaging;
 	using System.Collections;
+	using System.Runtime.InteropServices;
 
 	/// <summary>
     /// Filters' collection to apply to an image in sequence.
@@ -35,10 +36,59 @@ namespace AForge.Imaging.Filters
     /// // apply the filter
     /// Bitmap newImage = filter.Apply( image );
     /// </code>
+    /// 
+    /// <para>Consecutive filters, which implement <see cref="IStripFilter"/> interface, are applied
+    /// to an image strip by strip - each strip goes through all these filters before the next one is
+    /// taken, so it is processed while it is in processor's cache. Strips of intermediate images are
+    /// kept in buffers, which are reused by subsequent calls made from the same thread, so only the
+    /// result image is allocated. Result of the filtering is the same as if filters were applied
+    /// one by one (see <see cref="StripProcessing"/> property).</para>
     /// </remarks>
     /// 
 	public class FiltersSequenceCollection : CollectionBase, IFilter
 	{
+        // buffers of image strips, one per thread, so sequences may be used by several threads at once
+        [ThreadStatic]
+        private static StripBuffers stripBuffers;
+
+        private bool stripProcessing = true;
+        private int  stripCacheSize = 512 * 1024;
+
+        /// <summary>
+        /// Apply filters to an image strip by strip or not.
+        /// </summary>
+        /// 
+        /// <remarks><para>The property specifies if consecutive filters implementing <see cref="IStripFilter"/>
+        /// interface are applied to an image strip by strip. If the property is set to <see langword="false"/>,
+        /// all filters are applied to the entire image one after another.</para>
+        /// 
+        /// <para>Default value is set to <see langword="true"/>.</para>
+        /// </remarks>
+        /// 
+        public bool StripProcessing
+        {
+            get { return stripProcessing; }
+            set { stripProcessing = value; }
+        }
+
+        /// <summary>
+        /// Amount of memory (in bytes) taken by a strip of all images it goes through.
+        /// </summary>
+        /// 
+        /// <remarks><para>The property defines height of image strips processed by filters
+        /// - it is calculated so rows of the source image, rows of all intermediate images and rows of
+        /// the result image fit into the specified amount of memory. The value should be close to size of
+        /// processor's second level cache.</para>
+        /// 
+        /// <para>Default value is set to <b>524288</b>. Minimum value is <b>16384</b>.</para>
+        /// </remarks>
+        /// 
+        public int StripCacheSize
+        {
+            get { return stripCacheSize; }
+            set { stripCacheSize = Math.Max( 16384, value ); }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="FiltersSequenceCollection"/> class.
         /// </summary>
@@ -163,27 +213,7 @@ namespace AForge.Imaging.Filters
         ///
         public UnmanagedImage Apply( UnmanagedImage image )
         {
-            int n = InnerList.Count;
-
-            // check for empty sequence
-            if ( n == 0 )
-                throw new ApplicationException( "No filters in the sequence." );
-
-            UnmanagedImage dstImg = null;
-            UnmanagedImage tmpImg = null;
-
-            // apply the first filter
-            dstImg = ( (IFilter) InnerList[0] ).Apply( image );
-
-            // apply other filters
-            for ( int i = 1; i < n; i++ )
-            {
-                tmpImg = dstImg;
-                dstImg = ( (IFilter) InnerList[i] ).Apply( tmpImg );
-                tmpImg.Dispose( );
-            }
-
-            return dstImg;
+            return ApplySequence( image, null );
         }
 
         /// <summary>
@@ -201,8 +231,17 @@ namespace AForge.Imaging.Filters
         /// </remarks>
         /// 
         /// <exception cref="ApplicationException">No filters were added into the filters' sequence.</exception>
+        /// <exception cref="InvalidImagePropertiesException">Incorrect destination pixel format.</exception>
+        /// <exception cref="InvalidImagePropertiesException">Destination image has wrong width and/or height.</exception>
         ///
         public void Apply( UnmanagedImage sourceImage, UnmanagedImage destinationImage )
+        {
+            ApplySequence( sourceImage, destinationImage );
+        }
+
+        // Apply filters of the sequence putting result of the last filter into destination image,
+        // or into new image if destination image is not specified
+        private UnmanagedImage ApplySequence( UnmanagedImage sourceImage, UnmanagedImage destinationImage )
         {
             int n = InnerList.Count;
 
@@ -210,28 +249,282 @@ namespace AForge.Imaging.Filters
             if ( n == 0 )
                 throw new ApplicationException( "No filters in the sequence." );
 
-            if ( n == 1 )
+            UnmanagedImage image = sourceImage;
+
+            for ( int i = 0; i < n; )
             {
-                ( (IFilter) InnerList[0] ).Apply( sourceImage, destinationImage );
+                UnmanagedImage result = null;
+                PixelFormat resultFormat;
+
+                // check how many filters may be applied strip by strip
+                int count = GetStripFiltersCount( i, image.PixelFormat, out resultFormat );
+
+                if ( count > 1 )
+                {
+                    if ( ( i + count == n ) && ( destinationImage != null ) )
+                    {
+                        // ensure destination image has correct format and size
+                        if ( destinationImage.PixelFormat != resultFormat )
+                        {
+                            throw new InvalidImagePropertiesException( "Destination pixel format is specified incorrectly." );
+                        }
+                        if ( ( destinationImage.Width != image.Width ) || ( destinationImage.Height != image.Height ) )
+                        {
+                            throw new InvalidImagePropertiesException( "Destination image must have the same width and height as source image." );
+                        }
+
+                        result = destinationImage;
+                    }
+                    else
+                    {
+                        result = UnmanagedImage.Create( image.Width, image.Height, resultFormat );
+                    }
+
+                    ApplyStrips( image, result, i, count );
+                }
+                else
+                {
+                    IFilter filter = (IFilter) InnerList[i];
+
+                    count = 1;
+
+                    if ( ( i + 1 == n ) && ( destinationImage != null ) )
+                    {
+                        filter.Apply( image, destinationImage );
+                        result = destinationImage;
+                    }
+                    else
+                    {
+                        result = filter.Apply( image );
+                    }
+                }
+
+                // dispose intermediate image
+                if ( image != sourceImage )
+                    image.Dispose( );
+
+                image = result;
+                i += count;
             }
-            else
+
+            return image;
+        }
+
+        // Get number of consecutive filters starting from the specified one, which may be applied
+        // strip by strip to image of the specified format, and format of their result
+        private int GetStripFiltersCount( int first, PixelFormat format, out PixelFormat resultFormat )
+        {
+            int i = first;
+
+            resultFormat = format;
+
+            if ( stripProcessing )
             {
-                UnmanagedImage tmpImg1 = null;
-                UnmanagedImage tmpImg2 = null;
+                for ( int n = InnerList.Count; i < n; i++ )
+                {
+                    IStripFilter stripFilter = InnerList[i] as IStripFilter;
+                    IFilterInformation filterInfo = InnerList[i] as IFilterInformation;
 
-                // apply the first filter
-                tmpImg1 = ( (IFilter) InnerList[0] ).Apply( sourceImage );
+                    if ( ( stripFilter == null ) || ( filterInfo == null ) || ( stripFilter.StripRadius < 0 ) ||
+                         ( !filterInfo.FormatTranslations.ContainsKey( resultFormat ) ) )
+                        break;
+
+                    resultFormat = filterInfo.FormatTranslations[resultFormat];
+                }
+            }
+
+            return i - first;
+        }
+
+        // Apply the specified number of filters starting from the specified one strip by strip
+        private unsafe void ApplyStrips( UnmanagedImage sourceImage, UnmanagedImage destinationImage, int first, int count )
+        {
+            int width  = sourceImage.Width;
+            int height = sourceImage.Height;
 
-                // apply other filters, except the last one
-                n--;
-                for ( int i = 1; i < n; i++ )
+            IFilter[]     filters = new IFilter[count];
+            PixelFormat[] formats = new PixelFormat[count];
+            int[] radius  = new int[count];
+            // number of rows to add above and below a strip of filter's result, so next filters get all rows they need
+            int[] margin  = new int[count];
+            // offsets of strip buffers, or -1 for filters applied in place or directly to destination image
+            int[] offsets = new int[count];
+            int[] strides = new int[count];
+
+            PixelFormat format = sourceImage.PixelFormat;
+
+            for ( int k = 0; k < count; k++ )
+            {
+                filters[k] = (IFilter) InnerList[first + k];
+                radius[k]  = ( (IStripFilter) filters[k] ).StripRadius;
+                formats[k] = ( (IFilterInformation) filters[k] ).FormatTranslations[format];
+
+                int pixelSize = Image.GetPixelFormatSize( formats[k] ) / 8;
+
+                strides[k] = width * pixelSize;
+                if ( strides[k] % 4 != 0 )
+                {
+                    strides[k] += ( 4 - ( strides[k] % 4 ) );
+                }
+
+                // per pixel filters, which keep pixel format, may modify strip of previous filter's result;
+                // the last per pixel filter puts its result directly into destination image
+                if ( ( radius[k] == 0 ) && ( ( k == count - 1 ) ||
+                     ( ( k != 0 ) && ( formats[k] == format ) && ( filters[k] is IInPlaceFilter ) ) ) )
                 {
-                    tmpImg2 = tmpImg1;
-                    tmpImg1 = ( (IFilter) InnerList[i] ).Apply( tmpImg2 );
-                    tmpImg2.Dispose( );
+                    offsets[k] = -1;
+                }
+
+                format = formats[k];
+            }
+
+            int totalRadius = 0;
+
+            for ( int k = count - 1; k >= 0; k-- )
+            {
+                margin[k] = totalRadius;
+                totalRadius += radius[k];
+            }
+
+            // get height of strips, so all their rows fit into cache, but keep it big enough
+            // comparing to rows, which are processed again as part of neighbour strips
+            int rowSize = sourceImage.Stride + destinationImage.Stride;
+
+            for ( int k = 0; k < count; k++ )
+            {
+                if ( offsets[k] != -1 )
+                    rowSize += strides[k];
+            }
+
+            int stripHeight = Math.Min( height, Math.Max( stripCacheSize / rowSize, Math.Max( 8, 4 * totalRadius ) ) );
+
+            // place strip buffers in memory reused by all sequences of the thread
+            int buffersSize = 0;
+
+            for ( int k = 0; k < count; k++ )
+            {
+                if ( offsets[k] != -1 )
+                {
+                    offsets[k] = buffersSize;
+                    buffersSize += strides[k] * Math.Min( height, stripHeight + 2 * ( margin[k] + radius[k] ) );
+                }
+            }
+
+            // take buffers from the thread, so they are not used by filters applied to the strips
+            StripBuffers buffers = stripBuffers;
+            stripBuffers = null;
+
+            if ( buffers == null )
+                buffers = new StripBuffers( );
+
+            try
+            {
+                byte* buffer = (byte*) buffers.Reserve( buffersSize ).ToPointer( );
+                byte* src = (byte*) sourceImage.ImageData.ToPointer( );
+                byte* dst = (byte*) destinationImage.ImageData.ToPointer( );
+
+                int srcStride = sourceImage.Stride;
+                int dstStride = destinationImage.Stride;
+                int lineSize  = Math.Min( strides[count - 1], dstStride );
+
+                for ( int stripStart = 0; stripStart < height; stripStart += stripHeight )
+                {
+                    int stripStop = Math.Min( height, stripStart + stripHeight );
+
+                    // rows of the source image needed for the strip
+                    int top    = Math.Max( 0, stripStart - totalRadius );
+                    int bottom = Math.Min( height, stripStop + totalRadius );
+
+                    UnmanagedImage strip = new UnmanagedImage( (IntPtr) ( src + top * srcStride ),
+                        width, bottom - top, srcStride, sourceImage.PixelFormat );
+
+                    for ( int k = 0; k < count; k++ )
+                    {
+                        if ( offsets[k] != -1 )
+                        {
+                            UnmanagedImage result = new UnmanagedImage( (IntPtr) ( buffer + offsets[k] ),
+                                width, bottom - top, strides[k], formats[k] );
+
+                            filters[k].Apply( strip, result );
+                            strip = result;
+                        }
+                        else if ( k != count - 1 )
+                        {
+                            ( (IInPlaceFilter) filters[k] ).ApplyInPlace( strip );
+                        }
+                        else
+                        {
+                            UnmanagedImage result = new UnmanagedImage( (IntPtr) ( dst + top * dstStride ),
+                                width, bottom - top, dstStride, formats[k] );
+
+                            filters[k].Apply( strip, result );
+                            strip = null;
+                            break;
+                        }
+
+                        // leave only rows needed by next filters, others are incomplete
+                        int stripTop    = Math.Max( 0, stripStart - margin[k] );
+                        int stripBottom = Math.Min( height, stripStop + margin[k] );
+
+                        if ( ( stripTop != top ) || ( stripBottom != bottom ) )
+                        {
+                            strip = new UnmanagedImage( (IntPtr) ( (byte*) strip.ImageData.ToPointer( ) + ( stripTop - top ) * strip.Stride ),
+                                width, stripBottom - stripTop, strip.Stride, strip.PixelFormat );
+                        }
+
+                        top    = stripTop;
+                        bottom = stripBottom;
+                    }
+
+                    // copy result of the last filter, if it was put into strip buffer
+                    if ( strip != null )
+                    {
+                        byte* stripData = (byte*) strip.ImageData.ToPointer( );
+
+                        for ( int y = stripStart; y < stripStop; y++ )
+                        {
+                            AForge.SystemTools.CopyUnmanagedMemory( dst + y * dstStride, stripData, lineSize );
+                            stripData += strip.Stride;
+                        }
+                    }
+                }
+            }
+            finally
+            {
+                stripBuffers = buffers;
+            }
+        }
+
+        // Memory for strips of intermediate images, which grows to the biggest requested size
+        private sealed class StripBuffers
+        {
+            private IntPtr memory = IntPtr.Zero;
+            private int size = 0;
+
+            ~StripBuffers( )
+            {
+                if ( memory != IntPtr.Zero )
+                {
+                    Marshal.FreeHGlobal( memory );
+                }
+            }
+
+            public IntPtr Reserve( int requiredSize )
+            {
+                if ( requiredSize > size )
+                {
+                    if ( memory != IntPtr.Zero )
+                    {
+                        Marshal.FreeHGlobal( memory );
+                        memory = IntPtr.Zero;
+                        size = 0;
+                    }
+
+                    memory = Marshal.AllocHGlobal( Math.Max( requiredSize, 1 ) );
+                    size = requiredSize;
                 }
 
-                ( (IFilter) InnerList[n] ).Apply( tmpImg1, destinationImage );
+                return memory;
             }
         }
 	}
@@ -0,0 +1,42 @@
+﻿// AForge Image Processing Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2005-2011
+// contacts@aforgenet.com
+//
+
+namespace AForge.Imaging.Filters
+{
+    using System;
+
+    /// <summary>
+    /// Interface of filters, which may be applied to an image strip by strip.
+    /// </summary>
+    /// 
+    /// <remarks><para>Filters implementing the interface calculate every row of the result image
+    /// only from those rows of the source image, which are not further from it than
+    /// <see cref="StripRadius"/> rows. Such filter applied to a horizontal strip of an image gives
+    /// the same rows, as the filter applied to the entire image, except <see cref="StripRadius"/>
+    /// rows at the top and at the bottom of the strip (unless they are also top or bottom rows of
+    /// the image).</para>
+    /// 
+    /// <para>The interface is used by <see cref="FiltersSequenceCollection"/> to pass each strip
+    /// of an image through several filters, while the strip is still in processor's cache.</para>
+    /// </remarks>
+    /// 
+    public interface IStripFilter
+    {
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value is set to 0 for filters, which process each pixel independently,
+        /// and to vertical radius of kernel for filters, which process pixel's neighbourhood. Filters,
+        /// which need the entire image to calculate its rows (for example, to scale intensities
+        /// of the result image), set the value to -1.</para></remarks>
+        /// 
+        int StripRadius { get; }
+    }
+}
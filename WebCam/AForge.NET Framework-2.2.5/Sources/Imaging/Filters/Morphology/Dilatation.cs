@@ -50,7 +50,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="Dilatation3x3"/>
     /// <seealso cref="BinaryDilatation3x3"/>
     /// 
-    public class Dilatation : BaseUsingCopyPartialFilter
+    public class Dilatation : BaseUsingCopyPartialFilter, IStripFilter
     {
         // structuring element
         private short[,] se = new short[3, 3] { { 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 } };
@@ -67,6 +67,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value equals to radius of the structuring element.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return size >> 1; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="Dilatation"/> class.
         /// </summary>
@@ -32,7 +32,7 @@ namespace AForge.Imaging.Filters
     /// <seealso cref="Dilatation"/>
     /// <seealso cref="Dilatation3x3"/>
     /// 
-    public class BinaryDilatation3x3 : BaseUsingCopyPartialFilter
+    public class BinaryDilatation3x3 : BaseUsingCopyPartialFilter, IStripFilter
     {
         // private format translation dictionary
         private Dictionary<PixelFormat, PixelFormat> formatTranslations = new Dictionary<PixelFormat, PixelFormat>( );
@@ -45,6 +45,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The filter uses 3x3 structuring element, so the value is always 1.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return 1; }
+        }
+
         /// <summary>
         /// Initializes a new instance of the <see cref="BinaryDilatation3x3"/> class.
         /// </summary>
@@ -74,7 +74,6 @@ namespace AForge.Imaging.Filters
         private bool colorPropertiesChanged = true;
 
         private bool limitKernelSize = true;
-        private bool enableParallelProcessing = false;
 
         /// <summary>
         /// Specifies if exception must be thrown in the case a large
@@ -92,23 +91,6 @@ namespace AForge.Imaging.Filters
             set { limitKernelSize = value; }
         }
 
-        /// <summary>
-        /// Enable or not parallel processing on multi-core CPUs.
-        /// </summary>
-        /// 
-        /// <remarks><para>If the property is set to <see langword="true"/>, then this image processing
-        /// routine will run in parallel on the systems with multiple core/CPUs. The <see cref="AForge.Parallel.For"/>
-        /// is used to make it parallel.</para>
-        /// 
-        /// <para>Default value is set to <see langword="false"/>.</para>
-        /// </remarks>
-        /// 
-        public bool EnableParallelProcessing
-        {
-            get { return enableParallelProcessing; }
-            set { enableParallelProcessing = value; }
-        }
-
         /// <summary>
         /// Size of a square for limiting surrounding pixels that take part in calculations, [3, 255].
         /// </summary>
@@ -350,7 +332,7 @@ namespace AForge.Imaging.Filters
                 Rectangle safeArea = rect;
                 safeArea.Inflate( -kernelHalf, -kernelHalf );
 
-                if ( ( Environment.ProcessorCount > 1 ) && ( enableParallelProcessing ) )
+                if ( ( AForge.Parallel.ThreadsCount > 1 ) && ( EnableParallelProcessing ) )
                 {
                     ProcessWithoutChecksParallel( source, destination, safeArea );
                 }
@@ -48,7 +48,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/conservative_smoothing.png" width="480" height="361" />
     /// </remarks>
     /// 
-    public class ConservativeSmoothing : BaseUsingCopyPartialFilter
+    public class ConservativeSmoothing : BaseUsingCopyPartialFilter, IStripFilter
     {
         private int size = 3;
 
@@ -63,6 +63,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value equals to radius of the processing square, which is half of its <see cref="KernelSize">size</see>.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return size >> 1; }
+        }
+
         /// <summary>
         /// Kernel size, [3, 25].
         /// </summary>
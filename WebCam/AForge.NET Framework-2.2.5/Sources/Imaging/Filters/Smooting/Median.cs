@@ -22,9 +22,10 @@ namespace AForge.Imaging.Filters
     /// filter of preserving useful detail in the image.</para>
     /// 
     /// <para>Each pixel of the original source image is replaced with the median of neighboring pixel
-    /// values. The median is calculated by first sorting all the pixel values from the surrounding
-    /// neighborhood into numerical order and then replacing the pixel being considered with the
-    /// middle pixel value.</para>
+    /// values. The median is found using histograms of pixel values in the surrounding neighborhood,
+    /// which are updated incrementally while moving through the image, so processing time does not
+    /// depend on <see cref="Size">size</see> of the neighborhood. See <see cref="RankFilter"/> for
+    /// other percentiles of neighboring pixel values.</para>
     /// 
     /// <para>The filter accepts 8 bpp grayscale images and 24/32 bpp
     /// color images for processing.</para>
@@ -43,7 +44,7 @@ namespace AForge.Imaging.Filters
     /// <img src="img/imaging/median.png" width="480" height="361" />
     /// </remarks>
     /// 
-    public class Median : BaseUsingCopyPartialFilter
+    public class Median : BaseUsingCopyPartialFilter, IStripFilter
     {
         private int size = 3;
 
@@ -58,6 +59,18 @@ namespace AForge.Imaging.Filters
             get { return formatTranslations; }
         }
 
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value equals to radius of the processing square, which is half of its <see cref="Size">size</see>.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return size >> 1; }
+        }
+
         /// <summary>
         /// Processing square size for the median filter, [3, 25].
         /// </summary>
@@ -103,149 +116,9 @@ namespace AForge.Imaging.Filters
         /// <param name="destination">Destination image data.</param>
         /// <param name="rect">Image rectangle for processing by the filter.</param>
         /// 
-        protected override unsafe void ProcessFilter( UnmanagedImage source, UnmanagedImage destination, Rectangle rect )
+        protected override void ProcessFilter( UnmanagedImage source, UnmanagedImage destination, Rectangle rect )
         {
-            int pixelSize = Image.GetPixelFormatSize( source.PixelFormat ) / 8;
-
-            // processing start and stop X,Y positions
-            int startX  = rect.Left;
-            int startY  = rect.Top;
-            int stopX   = startX + rect.Width;
-            int stopY   = startY + rect.Height;
-
-            int srcStride = source.Stride;
-            int dstStride = destination.Stride;
-            int srcOffset = srcStride - rect.Width * pixelSize;
-            int dstOffset = dstStride - rect.Width * pixelSize;
-
-            // loop and array indexes
-            int i, j, t;
-            // processing square's radius
-            int radius = size >> 1;
-            // number of elements
-            int c;
-
-            // array to hold pixel values (R, G, B)
-            byte[] r = new byte[size * size];
-            byte[] g = new byte[size * size];
-            byte[] b = new byte[size * size];
-
-            byte* src = (byte*) source.ImageData.ToPointer( );
-            byte* dst = (byte*) destination.ImageData.ToPointer( );
-            byte* p;
-
-            // allign pointers to the first pixel to process
-            src += ( startY * srcStride + startX * pixelSize );
-            dst += ( startY * dstStride + startX * pixelSize );
-
-            // do the processing job
-            if ( destination.PixelFormat == PixelFormat.Format8bppIndexed )
-            {
-                // grayscale image
-
-                // for each line
-                for ( int y = startY; y < stopY; y++ )
-                {
-                    // for each pixel
-                    for ( int x = startX; x < stopX; x++, src++, dst++ )
-                    {
-                        c = 0;
-
-                        // for each kernel row
-                        for ( i = -radius; i <= radius; i++ )
-                        {
-                            t = y + i;
-
-                            // skip row
-                            if ( t < startY )
-                                continue;
-                            // break
-                            if ( t >= stopY )
-                                break;
-
-                            // for each kernel column
-                            for ( j = -radius; j <= radius; j++ )
-                            {
-                                t = x + j;
-
-                                // skip column
-                                if ( t < startX )
-                                    continue;
-
-                                if ( t < stopX )
-                                {
-                                    g[c++] = src[i * srcStride + j];
-                                }
-                            }
-                        }
-                        // sort elements
-                        Array.Sort( g, 0, c );
-                        // get the median
-                        *dst = g[c >> 1];
-                    }
-                    src += srcOffset;
-                    dst += dstOffset;
-                }
-            }
-            else
-            {
-                // RGB image
-
-                // for each line
-                for ( int y = startY; y < stopY; y++ )
-                {
-                    // for each pixel
-                    for ( int x = startX; x < stopX; x++, src += pixelSize, dst += pixelSize )
-                    {
-                        c = 0;
-
-                        // for each kernel row
-                        for ( i = -radius; i <= radius; i++ )
-                        {
-                            t = y + i;
-
-                            // skip row
-                            if ( t < startY )
-                                continue;
-                            // break
-                            if ( t >= stopY )
-                                break;
-
-                            // for each kernel column
-                            for ( j = -radius; j <= radius; j++ )
-                            {
-                                t = x + j;
-
-                                // skip column
-                                if ( t < startX )
-                                    continue;
-
-                                if ( t < stopX )
-                                {
-                                    p = &src[i * srcStride + j * pixelSize];
-
-                                    r[c] = p[RGB.R];
-                                    g[c] = p[RGB.G];
-                                    b[c] = p[RGB.B];
-                                    c++;
-                                }
-                            }
-                        }
-
-                        // sort elements
-                        Array.Sort( r, 0, c );
-                        Array.Sort( g, 0, c );
-                        Array.Sort( b, 0, c );
-                        // get the median
-                        t = c >> 1;
-                        dst[RGB.R] = r[t];
-                        dst[RGB.G] = g[t];
-                        dst[RGB.B] = b[t];
-                    }
-                    src += srcOffset;
-                    dst += dstOffset;
-                }
-            }
+            RankFilter.ProcessImage( source, destination, rect, size >> 1, 0.5 );
         }
     }
 }
@@ -0,0 +1,357 @@
+﻿// AForge Image Processing Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2005-2012
+// contacts@aforgenet.com
+//
+
+namespace AForge.Imaging.Filters
+{
+    using System;
+    using System.Collections.Generic;
+    using System.Drawing;
+    using System.Drawing.Imaging;
+
+    /// <summary>
+    /// Rank filter.
+    /// </summary>
+    /// 
+    /// <remarks><para>The filter replaces each pixel of the source image with the value, which
+    /// has the specified <see cref="Percentile">percentile</see> among values of neighboring pixels.
+    /// Percentile of 50 gives the <see cref="Median">median filter</see>, percentile of 0 gives
+    /// minimum of the neighborhood (like grayscale <see cref="Erosion">erosion</see>) and
+    /// percentile of 100 gives its maximum (like grayscale <see cref="Dilatation">dilatation</see>),
+    /// while values in between allow to remove noise being less sensitive to outliers, than
+    /// minimum and maximum.</para>
+    /// 
+    /// <para>The neighborhood is a square, which is clipped by edges of the processing rectangle.
+    /// For a square of <b>N</b> pixels the result is the value with <b>N * percentile / 100</b>
+    /// index (limited to <b>N - 1</b>) among the values sorted in ascending order. Color images
+    /// are processed channel by channel.</para>
+    /// 
+    /// <para>The filter keeps histograms of pixel values in each column of the processing square
+    /// and in the square itself, which are updated incrementally while moving through the image,
+    /// so processing time does not depend on <see cref="Size">size</see> of the square.</para>
+    /// 
+    /// <para>The filter accepts 8 bpp grayscale images and 24/32 bpp
+    /// color images for processing.</para>
+    /// 
+    /// <para>Sample usage:</para>
+    /// <code>
+    /// // create filter
+    /// RankFilter filter = new RankFilter( 7, 25 );
+    /// // apply the filter
+    /// filter.ApplyInPlace( image );
+    /// </code>
+    /// </remarks>
+    /// 
+    /// <seealso cref="Median"/>
+    /// 
+    public class RankFilter : BaseUsingCopyPartialFilter, IStripFilter
+    {
+        private int size = 3;
+        private double percentile = 50;
+
+        // private format translation dictionary
+        private Dictionary<PixelFormat, PixelFormat> formatTranslations = new Dictionary<PixelFormat, PixelFormat>( );
+
+        /// <summary>
+        /// Format translations dictionary.
+        /// </summary>
+        public override Dictionary<PixelFormat, PixelFormat> FormatTranslations
+        {
+            get { return formatTranslations; }
+        }
+
+        /// <summary>
+        /// Number of rows above and below a row of the source image, which are used to calculate
+        /// the row of the result image.
+        /// </summary>
+        /// 
+        /// <remarks><para>The value equals to radius of the processing square, which is half of its <see cref="Size">size</see>.</para></remarks>
+        /// 
+        public int StripRadius
+        {
+            get { return size >> 1; }
+        }
+
+        /// <summary>
+        /// Processing square size for the rank filter, [3, 255].
+        /// </summary>
+        /// 
+        /// <remarks><para>Default value is set to <b>3</b>.</para>
+        /// 
+        /// <para><note>The value should be odd.</note></para>
+        /// </remarks>
+        /// 
+        public int Size
+        {
+            get { return size; }
+            set { size = Math.Max( 3, Math.Min( 255, value | 1 ) ); }
+        }
+
+        /// <summary>
+        /// Percentile of neighboring pixel values, which is put into result image, [0, 100].
+        /// </summary>
+        /// 
+        /// <remarks><para>Default value is set to <b>50</b>, which corresponds to median.</para></remarks>
+        /// 
+        public double Percentile
+        {
+            get { return percentile; }
+            set { percentile = Math.Max( 0, Math.Min( 100, value ) ); }
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="RankFilter"/> class.
+        /// </summary>
+        public RankFilter( )
+        {
+            formatTranslations[PixelFormat.Format8bppIndexed] = PixelFormat.Format8bppIndexed;
+            formatTranslations[PixelFormat.Format24bppRgb]    = PixelFormat.Format24bppRgb;
+            formatTranslations[PixelFormat.Format32bppRgb]    = PixelFormat.Format32bppRgb;
+            formatTranslations[PixelFormat.Format32bppArgb]   = PixelFormat.Format32bppArgb;
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="RankFilter"/> class.
+        /// </summary>
+        /// 
+        /// <param name="size">Processing square size.</param>
+        /// 
+        public RankFilter( int size ) : this( )
+        {
+            Size = size;
+        }
+
+        /// <summary>
+        /// Initializes a new instance of the <see cref="RankFilter"/> class.
+        /// </summary>
+        /// 
+        /// <param name="size">Processing square size.</param>
+        /// <param name="percentile">Percentile of neighboring pixel values.</param>
+        /// 
+        public RankFilter( int size, double percentile ) : this( )
+        {
+            Size = size;
+            Percentile = percentile;
+        }
+
+        /// <summary>
+        /// Process the filter on the specified image.
+        /// </summary>
+        /// 
+        /// <param name="source">Source image data.</param>
+        /// <param name="destination">Destination image data.</param>
+        /// <param name="rect">Image rectangle for processing by the filter.</param>
+        /// 
+        protected override void ProcessFilter( UnmanagedImage source, UnmanagedImage destination, Rectangle rect )
+        {
+            ProcessImage( source, destination, rect, size >> 1, percentile / 100 );
+        }
+
+        // Replace each pixel of the rectangle with the value of the specified rank in its neighborhood,
+        // which is the square of the specified radius clipped by the rectangle
+        internal static unsafe void ProcessImage( UnmanagedImage source, UnmanagedImage destination, Rectangle rect, int radius, double rank )
+        {
+            int pixelSize = Image.GetPixelFormatSize( source.PixelFormat ) / 8;
+            int width  = rect.Width;
+            int height = rect.Height;
+
+            // histograms of pixel values in columns of the processing square - full histograms with
+            // 256 bins and coarse histograms with 16 bins, each of which sums 16 bins of the full one
+            ushort[] columnsFine   = new ushort[width * 256];
+            ushort[] columnsCoarse = new ushort[width * 16];
+
+            byte* src = (byte*) source.ImageData.ToPointer( );
+            byte* dst = (byte*) destination.ImageData.ToPointer( );
+
+            // allign pointers to the first pixel to process
+            src += ( rect.Top * source.Stride + rect.Left * pixelSize );
+            dst += ( rect.Top * destination.Stride + rect.Left * pixelSize );
+
+            fixed ( ushort* fine = columnsFine, coarse = columnsCoarse )
+            {
+                if ( destination.PixelFormat == PixelFormat.Format8bppIndexed )
+                {
+                    // grayscale image
+                    ProcessChannel( src, dst, source.Stride, destination.Stride, 1,
+                        width, height, radius, rank, fine, coarse );
+                }
+                else
+                {
+                    // RGB image - alpha channel is not processed
+                    ProcessChannel( src + RGB.R, dst + RGB.R, source.Stride, destination.Stride, pixelSize,
+                        width, height, radius, rank, fine, coarse );
+
+                    Array.Clear( columnsFine, 0, columnsFine.Length );
+                    Array.Clear( columnsCoarse, 0, columnsCoarse.Length );
+
+                    ProcessChannel( src + RGB.G, dst + RGB.G, source.Stride, destination.Stride, pixelSize,
+                        width, height, radius, rank, fine, coarse );
+
+                    Array.Clear( columnsFine, 0, columnsFine.Length );
+                    Array.Clear( columnsCoarse, 0, columnsCoarse.Length );
+
+                    ProcessChannel( src + RGB.B, dst + RGB.B, source.Stride, destination.Stride, pixelSize,
+                        width, height, radius, rank, fine, coarse );
+                }
+            }
+        }
+
+        // Process single channel of the rectangle, which is addressed by pointers to its first pixel,
+        // using the algorithm of S. Perreault and P. Hebert ("Median Filtering in Constant Time") -
+        // histogram of the processing square is a sum of histograms of its columns, the coarse level
+        // of it is kept up to date for each pixel, while a segment of the full level is brought up
+        // to date only when the searched value falls into it
+        private static unsafe void ProcessChannel( byte* src, byte* dst, int srcStride, int dstStride, int pixelSize,
+            int width, int height, int radius, double rank, ushort* columnsFine, ushort* columnsCoarse )
+        {
+            int diameter = 2 * radius + 1;
+
+            // histograms of the processing square
+            ushort* fine   = stackalloc ushort[256];
+            ushort* coarse = stackalloc ushort[16];
+            // columns of processing squares, for which segments of the full histogram were calculated
+            int* segmentColumns = stackalloc int[16];
+
+            // collect columns of the processing square of the first row
+            for ( int y = 0, stopY = Math.Min( radius, height - 1 ); y <= stopY; y++ )
+            {
+                UpdateColumns( src + y * srcStride, pixelSize, width, columnsFine, columnsCoarse, 1 );
+            }
+
+            // for each line
+            for ( int y = 0; y < height; y++ )
+            {
+                if ( y != 0 )
+                {
+                    // move columns of the processing square one row down
+                    if ( y - radius - 1 >= 0 )
+                        UpdateColumns( src + ( y - radius - 1 ) * srcStride, pixelSize, width, columnsFine, columnsCoarse, -1 );
+                    if ( y + radius < height )
+                        UpdateColumns( src + ( y + radius ) * srcStride, pixelSize, width, columnsFine, columnsCoarse, 1 );
+                }
+
+                int rows = Math.Min( y + radius, height - 1 ) - Math.Max( y - radius, 0 ) + 1;
+
+                // coarse histogram of the processing square of the first pixel,
+                // full histogram is calculated on demand
+                for ( int i = 0; i < 16; i++ )
+                {
+                    coarse[i] = 0;
+                    segmentColumns[i] = -1;
+                }
+                for ( int x = 0, stopX = Math.Min( radius, width - 1 ); x <= stopX; x++ )
+                {
+                    AddHistogram( coarse, columnsCoarse + x * 16, 1 );
+                }
+
+                byte* d = dst + y * dstStride;
+
+                // for each pixel
+                for ( int x = 0; x < width; x++, d += pixelSize )
+                {
+                    if ( x != 0 )
+                    {
+                        // move the processing square one column right
+                        if ( x + radius < width )
+                            AddHistogram( coarse, columnsCoarse + ( x + radius ) * 16, 1 );
+                        if ( x - radius - 1 >= 0 )
+                            AddHistogram( coarse, columnsCoarse + ( x - radius - 1 ) * 16, -1 );
+                    }
+
+                    // index of the searched value among sorted values of the processing square
+                    int count = rows * ( Math.Min( x + radius, width - 1 ) - Math.Max( x - radius, 0 ) + 1 );
+                    int index = (int) ( count * rank );
+
+                    if ( index >= count )
+                        index = count - 1;
+
+                    // find segment of the searched value
+                    int segment = 0;
+                    int sum = coarse[0];
+
+                    while ( sum <= index )
+                    {
+                        sum += coarse[++segment];
+                    }
+                    sum -= coarse[segment];
+
+                    // bring the segment up to date
+                    ushort* histogram = fine + ( segment << 4 );
+                    int column = segmentColumns[segment];
+
+                    if ( ( column < 0 ) || ( x - column >= diameter ) )
+                    {
+                        // the processing square does not share columns with the one, for which
+                        // the segment was calculated, so calculate it from scratch
+                        for ( int i = 0; i < 16; i++ )
+                        {
+                            histogram[i] = 0;
+                        }
+                        for ( int c = Math.Max( x - radius, 0 ), stopC = Math.Min( x + radius, width - 1 ); c <= stopC; c++ )
+                        {
+                            AddHistogram( histogram, columnsFine + c * 256 + ( segment << 4 ), 1 );
+                        }
+                    }
+                    else
+                    {
+                        for ( int c = column + 1; c <= x; c++ )
+                        {
+                            if ( c + radius < width )
+                                AddHistogram( histogram, columnsFine + ( c + radius ) * 256 + ( segment << 4 ), 1 );
+                            if ( c - radius - 1 >= 0 )
+                                AddHistogram( histogram, columnsFine + ( c - radius - 1 ) * 256 + ( segment << 4 ), -1 );
+                        }
+                    }
+                    segmentColumns[segment] = x;
+
+                    // find the searched value within the segment
+                    int value = 0;
+
+                    while ( ( sum += histogram[value] ) <= index )
+                    {
+                        value++;
+                    }
+
+                    *d = (byte) ( ( segment << 4 ) + value );
+                }
+            }
+        }
+
+        // Add pixel values of the row to histograms of columns or remove them
+        private static unsafe void UpdateColumns( byte* row, int pixelSize, int width, ushort* columnsFine, ushort* columnsCoarse, int delta )
+        {
+            for ( int x = 0; x < width; x++, row += pixelSize, columnsFine += 256, columnsCoarse += 16 )
+            {
+                columnsFine[*row] = (ushort) ( columnsFine[*row] + delta );
+                columnsCoarse[*row >> 4] = (ushort) ( columnsCoarse[*row >> 4] + delta );
+            }
+        }
+
+        // Add 16 bins of a column histogram to the histogram of the processing square or subtract them,
+        // 4 bins at once - bins never overflow or become negative, so there is no carry between them
+        private static unsafe void AddHistogram( ushort* histogram, ushort* column, int sign )
+        {
+            ulong* h = (ulong*) histogram;
+            ulong* c = (ulong*) column;
+
+            if ( sign > 0 )
+            {
+                h[0] += c[0];
+                h[1] += c[1];
+                h[2] += c[2];
+                h[3] += c[3];
+            }
+            else
+            {
+                h[0] -= c[0];
+                h[1] -= c[1];
+                h[2] -= c[2];
+                h[3] -= c[3];
+            }
+        }
+    }
+}
@@ -16,7 +16,7 @@ using namespace System::Security::Permissions;
 [assembly:AssemblyConfigurationAttribute("")];
 [assembly:AssemblyCompanyAttribute("AForge")];
 [assembly:AssemblyProductAttribute("AForge.NET")];
-[assembly:AssemblyCopyrightAttribute("AForge  2012")];
+[assembly:AssemblyCopyrightAttribute("AForge © 2012")];
 [assembly:AssemblyTrademarkAttribute("")];
 [assembly:AssemblyCultureAttribute("")];
 
@@ -0,0 +1,161 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#include "StdAfx.h"
+#include "DecodedVideoFrame.h"
+#include "VideoFileReader.h"
+
+namespace libffmpeg
+{
+	extern "C"
+	{
+#include "libavutil\frame.h"
+#include "libswscale\swscale.h"
+	}
+}
+
+using namespace System::Drawing::Imaging;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			// Class constructor
+			DecodedVideoFrame::DecodedVideoFrame(VideoFileReader^ reader, int width, int height, VideoPixelFormat format, bool convert) :
+				m_reader(reader), m_width(width), m_height(height), m_format(format),
+				m_frame(nullptr), m_converted(nullptr), m_planes(nullptr)
+			{
+				m_frame = libffmpeg::av_frame_alloc();
+				if (m_frame == nullptr)
+					throw gcnew VideoException("Cannot allocate video frame.");
+
+				if (convert)
+				{
+					m_converted = libffmpeg::av_frame_alloc();
+					if (m_converted == nullptr)
+					{
+						Free();
+						throw gcnew VideoException("Cannot allocate video frame.");
+					}
+
+					m_converted->format = video_pixel_formats[(int)format];
+					m_converted->width = width;
+					m_converted->height = height;
+
+					if (libffmpeg::av_frame_get_buffer(m_converted, 32) < 0)
+					{
+						Free();
+						throw gcnew VideoException("Cannot allocate video frame.");
+					}
+				}
+			}
+
+			// Gives the frame back to the reader
+			DecodedVideoFrame::~DecodedVideoFrame()
+			{
+				if (m_planes == nullptr)
+					return;
+
+				m_planes = nullptr;
+				libffmpeg::av_frame_unref(m_frame);
+				m_reader->ReturnDecodedFrame(this);
+			}
+
+			// Frees native memory of the frame
+			DecodedVideoFrame::!DecodedVideoFrame()
+			{
+				m_planes = nullptr;
+
+				if (m_frame != nullptr)
+				{
+					libffmpeg::AVFrame* frame = m_frame;
+					libffmpeg::av_frame_free(&frame);
+					m_frame = nullptr;
+				}
+
+				if (m_converted != nullptr)
+				{
+					libffmpeg::AVFrame* frame = m_converted;
+					libffmpeg::av_frame_free(&frame);
+					m_converted = nullptr;
+				}
+			}
+
+			// Checks out the frame holding the specified decoded frame
+			void DecodedVideoFrame::CheckOut(libffmpeg::AVFrame* decodedFrame, libffmpeg::SwsContext* convertContext, TimeSpan timestamp)
+			{
+				if (m_converted != nullptr)
+				{
+					libffmpeg::sws_scale(convertContext, decodedFrame->data, decodedFrame->linesize, 0,
+						decodedFrame->height, m_converted->data, m_converted->linesize);
+					m_planes = m_converted;
+				}
+				else
+				{
+					// keep reference to decoder's memory, so it is not reused until the frame is given back
+					if (libffmpeg::av_frame_ref(m_frame, decodedFrame) < 0)
+						throw gcnew VideoException("Cannot reference decoded video frame.");
+					m_planes = m_frame;
+				}
+
+				m_timestamp = timestamp;
+			}
+
+			// Get pointer to the first line of the specified plane
+			IntPtr DecodedVideoFrame::GetPlane(int plane)
+			{
+				CheckIfCheckedOut();
+
+				if ((plane < 0) || (plane >= PlaneCount))
+					throw gcnew ArgumentOutOfRangeException("plane", "The video frame does not have plane with the specified index.");
+
+				return IntPtr(m_planes->data[plane]);
+			}
+
+			// Get line size of the specified plane
+			int DecodedVideoFrame::GetStride(int plane)
+			{
+				CheckIfCheckedOut();
+
+				if ((plane < 0) || (plane >= PlaneCount))
+					throw gcnew ArgumentOutOfRangeException("plane", "The video frame does not have plane with the specified index.");
+
+				return m_planes->linesize[plane];
+			}
+
+			// Get unmanaged image sharing memory with the frame
+			UnmanagedImage^ DecodedVideoFrame::ToUnmanagedImage()
+			{
+				CheckIfCheckedOut();
+
+				PixelFormat pixelFormat;
+
+				switch (m_format)
+				{
+				case VideoPixelFormat::Bgr24:
+					pixelFormat = PixelFormat::Format24bppRgb;
+					break;
+				case VideoPixelFormat::Bgra:
+					pixelFormat = PixelFormat::Format32bppArgb;
+					break;
+				case VideoPixelFormat::Gray8:
+				case VideoPixelFormat::Nv12:
+				case VideoPixelFormat::Yuv420P:
+					pixelFormat = PixelFormat::Format8bppIndexed;
+					break;
+				default:
+					throw gcnew InvalidOperationException("The pixel format of the video frame cannot be represented by unmanaged image.");
+				}
+
+				return gcnew UnmanagedImage(IntPtr(m_planes->data[0]), m_width, m_height, m_planes->linesize[0], pixelFormat);
+			}
+		}
+	}
+}
@@ -0,0 +1,232 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+#include "VideoPixelFormat.h"
+
+using namespace System;
+using namespace AForge::Imaging;
+
+namespace libffmpeg
+{
+	struct AVFrame;
+	struct SwsContext;
+}
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			ref class VideoFileReader;
+
+			/// <summary>
+			/// Decoded video frame, which provides direct access to planes of the frame.
+			/// </summary>
+			///
+			/// <remarks><para>The class is returned by <see cref="VideoFileReader::ReadDecodedFrame()"/> and keeps
+			/// the video frame checked out of the reader until it is disposed. If the decoder produces frames in the
+			/// requested <see cref="VideoFileReader::OutputFormat">output format</see>, planes of the frame are the
+			/// decoder's own memory, so no conversion or copying is done at all. Otherwise the frame is converted
+			/// into memory, which is allocated once and reused for further frames.</para>
+			///
+			/// <para>Disposing the frame gives it back to the reader, so it is reused for further frames. Planes of
+			/// the frame must not be accessed after that.</para>
+			///
+			/// <para>Sample usage:</para>
+			/// <code>
+			/// VideoFileReader reader = new VideoFileReader( );
+			/// reader.OutputFormat = VideoPixelFormat.Gray8;
+			/// reader.Open( "test.avi" );
+			///
+			/// while ( true )
+			/// {
+			///     using ( DecodedVideoFrame frame = reader.ReadDecodedFrame( ) )
+			///     {
+			///         if ( frame == null )
+			///             break;
+			///
+			///         // process luma of the frame with no colour conversion
+			///         blobCounter.ProcessImage( frame.ToUnmanagedImage( ) );
+			///     }
+			/// }
+			///
+			/// reader.Close( );
+			/// </code>
+			/// </remarks>
+			///
+			public ref class DecodedVideoFrame : IDisposable
+			{
+				VideoFileReader^ m_reader;
+				int m_width;
+				int m_height;
+				VideoPixelFormat m_format;
+				TimeSpan m_timestamp;
+
+				// reference to frame of the decoder, frame converted to output format if the
+				// decoder produces other format, and the one of them with planes provided to user
+				libffmpeg::AVFrame* m_frame;
+				libffmpeg::AVFrame* m_converted;
+				libffmpeg::AVFrame* m_planes;
+
+				// Checks if the frame is checked out
+				void CheckIfCheckedOut()
+				{
+					if (m_planes == nullptr)
+						throw gcnew System::ObjectDisposedException("The video frame was already given back to the reader.");
+				}
+
+			internal:
+				DecodedVideoFrame(VideoFileReader^ reader, int width, int height, VideoPixelFormat format, bool convert);
+
+				// Checks out the frame holding the specified decoded frame
+				void CheckOut(libffmpeg::AVFrame* decodedFrame, libffmpeg::SwsContext* convertContext, TimeSpan timestamp);
+
+				// Frees memory of the frame, which is no longer reused
+				void Free()
+				{
+					this->!DecodedVideoFrame();
+				}
+
+				property bool IsConverted
+				{
+					bool get()
+					{
+						return (m_converted != nullptr);
+					}
+				}
+
+			protected:
+				/// <summary>
+				/// Object's finalizer.
+				/// </summary>
+				///
+				!DecodedVideoFrame();
+
+			public:
+
+				/// <summary>
+				/// Disposes the object and gives the video frame back to the reader.
+				/// </summary>
+				///
+				~DecodedVideoFrame();
+
+				/// <summary>
+				/// Width of the video frame.
+				/// </summary>
+				///
+				property int Width
+				{
+					int get()
+					{
+						return m_width;
+					}
+				}
+
+				/// <summary>
+				/// Height of the video frame.
+				/// </summary>
+				///
+				property int Height
+				{
+					int get()
+					{
+						return m_height;
+					}
+				}
+
+				/// <summary>
+				/// Pixel format of the video frame.
+				/// </summary>
+				///
+				property VideoPixelFormat Format
+				{
+					VideoPixelFormat get()
+					{
+						return m_format;
+					}
+				}
+
+				/// <summary>
+				/// Presentation time of the video frame, relative to the start of the video stream.
+				/// </summary>
+				///
+				property TimeSpan Timestamp
+				{
+					TimeSpan get()
+					{
+						return m_timestamp;
+					}
+				}
+
+				/// <summary>
+				/// Number of planes of the video frame.
+				/// </summary>
+				///
+				/// <remarks><para>Packed formats and <see cref="VideoPixelFormat::Gray8"/> have a single plane,
+				/// <see cref="VideoPixelFormat::Nv12"/> has two planes and <see cref="VideoPixelFormat::Yuv420P"/>
+				/// has three planes.</para></remarks>
+				///
+				property int PlaneCount
+				{
+					int get()
+					{
+						return (m_format == VideoPixelFormat::Yuv420P) ? 3 : (m_format == VideoPixelFormat::Nv12) ? 2 : 1;
+					}
+				}
+
+				/// <summary>
+				/// Get pointer to the first line of the specified plane.
+				/// </summary>
+				///
+				/// <param name="plane">Index of the plane.</param>
+				///
+				/// <returns>Returns pointer to the plane, which is valid until the frame is disposed.</returns>
+				///
+				/// <exception cref="ArgumentOutOfRangeException">The frame does not have plane with the specified index.</exception>
+				/// <exception cref="System::ObjectDisposedException">The video frame was already given back to the reader.</exception>
+				///
+				IntPtr GetPlane(int plane);
+
+				/// <summary>
+				/// Get line size (stride) of the specified plane in bytes.
+				/// </summary>
+				///
+				/// <param name="plane">Index of the plane.</param>
+				///
+				/// <returns>Returns line size of the plane.</returns>
+				///
+				/// <exception cref="ArgumentOutOfRangeException">The frame does not have plane with the specified index.</exception>
+				/// <exception cref="System::ObjectDisposedException">The video frame was already given back to the reader.</exception>
+				///
+				int GetStride(int plane);
+
+				/// <summary>
+				/// Get unmanaged image, which shares memory with the video frame.
+				/// </summary>
+				///
+				/// <returns>Returns 24 bpp image for <see cref="VideoPixelFormat::Bgr24"/> frames, 32 bpp image for
+				/// <see cref="VideoPixelFormat::Bgra"/> frames and 8 bpp grayscale image of the luma plane for
+				/// <see cref="VideoPixelFormat::Gray8"/>, <see cref="VideoPixelFormat::Nv12"/> and
+				/// <see cref="VideoPixelFormat::Yuv420P"/> frames.</returns>
+				///
+				/// <remarks><para>No memory is copied, so the image is valid only until the frame is disposed.</para>
+				///
+				/// <para><note>Luma values of most video files use limited range from 16 to 235.</note></para>
+				/// </remarks>
+				///
+				/// <exception cref="InvalidOperationException">The pixel format of the frame cannot be represented by unmanaged image.</exception>
+				/// <exception cref="System::ObjectDisposedException">The video frame was already given back to the reader.</exception>
+				///
+				UnmanagedImage^ ToUnmanagedImage();
+			};
+		}
+	}
+}
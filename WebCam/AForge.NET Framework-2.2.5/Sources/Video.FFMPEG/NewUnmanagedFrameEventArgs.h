@@ -0,0 +1,61 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+using namespace System;
+using namespace AForge::Imaging;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Arguments for new unmanaged frame event from video source.
+			/// </summary>
+			///
+			public ref class NewUnmanagedFrameEventArgs : EventArgs
+			{
+				UnmanagedImage^ m_frame;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="NewUnmanagedFrameEventArgs"/> class.
+				/// </summary>
+				///
+				/// <param name="frame">New frame.</param>
+				///
+				NewUnmanagedFrameEventArgs(UnmanagedImage^ frame) : m_frame(frame) { }
+
+				/// <summary>
+				/// New frame from video source.
+				/// </summary>
+				///
+				property UnmanagedImage^ Frame
+				{
+					UnmanagedImage^ get()
+					{
+						return m_frame;
+					}
+				}
+			};
+
+			/// <summary>
+			/// Delegate for new unmanaged frame event handler.
+			/// </summary>
+			///
+			/// <param name="sender">Sender object.</param>
+			/// <param name="eventArgs">Event arguments.</param>
+			///
+			public delegate void NewUnmanagedFrameEventHandler(Object^ sender, NewUnmanagedFrameEventArgs^ eventArgs);
+		}
+	}
+}
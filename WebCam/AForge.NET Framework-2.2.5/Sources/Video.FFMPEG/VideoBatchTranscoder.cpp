@@ -0,0 +1,337 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#include "StdAfx.h"
+#include "VideoBatchTranscoder.h"
+#include "VideoFileReader.h"
+#include "VideoFileWriter.h"
+
+using namespace System::IO;
+using namespace System::Diagnostics;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			// size of the queue of frames waiting for encoder, which lets decoding overlap with encoding
+			static const int EncoderQueueSize = 4;
+
+			// key of a video file in the journal
+			static String^ journal_key(VideoTranscodeJob^ job)
+			{
+				return Path::GetFullPath(job->SourceFileName) + "\t" + Path::GetFullPath(job->TargetFileName);
+			}
+
+			VideoTranscodeJob::VideoTranscodeJob(String^ sourceFileName, String^ targetFileName)
+			{
+				if (sourceFileName == nullptr)
+				{
+					throw gcnew ArgumentNullException("sourceFileName");
+				}
+				if (targetFileName == nullptr)
+				{
+					throw gcnew ArgumentNullException("targetFileName");
+				}
+
+				m_sourceFileName = sourceFileName;
+				m_targetFileName = targetFileName;
+			}
+
+			VideoBatchTranscoder::VideoBatchTranscoder() :
+				m_codec(VideoCodec::h264), m_bitRate(4000000), m_encoderOptions(gcnew VideoEncoderOptions()),
+				m_maxConcurrentFiles(System::Math::Max(1, Environment::ProcessorCount / 4)),
+				m_outputSize(System::Drawing::Size::Empty), m_burnInTimestamp(false), m_journalFileName(nullptr),
+				m_sync(gcnew Object()), m_stopping(false), m_handlerErrors(gcnew List<Exception^>())
+			{
+			}
+
+			int VideoBatchTranscoder::Run(IEnumerable<VideoTranscodeJob^>^ jobs)
+			{
+				if (jobs == nullptr)
+				{
+					throw gcnew ArgumentNullException("jobs");
+				}
+
+				// collect video files completed by previous runs
+				Dictionary<String^, bool>^ completed = gcnew Dictionary<String^, bool>(StringComparer::OrdinalIgnoreCase);
+
+				if ((m_journalFileName != nullptr) && File::Exists(m_journalFileName))
+				{
+					for each (String^ line in File::ReadAllLines(m_journalFileName))
+					{
+						if (line->Length != 0)
+						{
+							completed[line] = true;
+						}
+					}
+				}
+
+				List<VideoTranscodeJob^>^ skipped = gcnew List<VideoTranscodeJob^>();
+
+				m_pendingJobs = gcnew Queue<VideoTranscodeJob^>();
+				m_completedCount = 0;
+
+				Monitor::Enter(m_sync);
+				try
+				{
+					m_handlerErrors->Clear();
+				}
+				finally
+				{
+					Monitor::Exit(m_sync);
+				}
+
+				for each (VideoTranscodeJob^ job in jobs)
+				{
+					if (completed->ContainsKey(journal_key(job)) && File::Exists(job->TargetFileName))
+					{
+						skipped->Add(job);
+					}
+					else
+					{
+						m_pendingJobs->Enqueue(job);
+					}
+				}
+
+				for each (VideoTranscodeJob^ job in skipped)
+				{
+					ReportFile(gcnew VideoTranscodeEventArgs(job, 0, TimeSpan::Zero, nullptr, true, false));
+				}
+
+				// split processors between video files transcoded at once, giving most of them to encoders,
+				// which are far more expensive than decoders
+				int workersCount = System::Math::Min(m_maxConcurrentFiles, m_pendingJobs->Count);
+				int threadsPerFile = System::Math::Max(1, Environment::ProcessorCount / System::Math::Max(1, workersCount));
+
+				m_decoderThreads = System::Math::Max(1, threadsPerFile / 4);
+				m_encoderThreads = System::Math::Max(1, threadsPerFile - m_decoderThreads);
+
+				array<Thread^>^ workers = gcnew array<Thread^>(workersCount);
+
+				for (int i = 0; i < workersCount; i++)
+				{
+					workers[i] = gcnew Thread(gcnew ThreadStart(this, &VideoBatchTranscoder::WorkerThread));
+					workers[i]->Name = "VideoBatchTranscoder";
+					workers[i]->IsBackground = true;
+					workers[i]->Start();
+				}
+
+				for (int i = 0; i < workersCount; i++)
+				{
+					workers[i]->Join();
+				}
+
+				m_pendingJobs = nullptr;
+
+				// the next run starts anew, while stopping requested before this one was not lost
+				m_stopping = false;
+
+				return m_completedCount;
+			}
+
+			void VideoBatchTranscoder::Stop()
+			{
+				m_stopping = true;
+			}
+
+			void VideoBatchTranscoder::WorkerThread()
+			{
+				while (!m_stopping)
+				{
+					VideoTranscodeJob^ job = nullptr;
+
+					Monitor::Enter(m_sync);
+					try
+					{
+						if (m_pendingJobs->Count != 0)
+						{
+							job = m_pendingJobs->Dequeue();
+						}
+					}
+					finally
+					{
+						Monitor::Exit(m_sync);
+					}
+
+					if (job == nullptr)
+					{
+						break;
+					}
+
+					TranscodeFile(job);
+				}
+			}
+
+			void VideoBatchTranscoder::TranscodeFile(VideoTranscodeJob^ job)
+			{
+				Stopwatch^ stopwatch = Stopwatch::StartNew();
+				VideoFileReader^ reader = gcnew VideoFileReader();
+				VideoFileWriter^ writer = gcnew VideoFileWriter();
+				System::Drawing::Font^ font = nullptr;
+				Int64 framesCount = 0;
+				Exception^ error = nullptr;
+				bool cancelled = false;
+
+				try
+				{
+					reader->ThreadCount = m_decoderThreads;
+					reader->UseIndexFile = false;
+					reader->OutputSize = m_outputSize;
+					reader->Open(job->SourceFileName);
+
+					VideoEncoderOptions^ options = gcnew VideoEncoderOptions();
+
+					options->ThreadCount = m_encoderThreads;
+					options->ThreadingMode = m_encoderOptions->ThreadingMode;
+					options->Preset = m_encoderOptions->Preset;
+					options->Tune = m_encoderOptions->Tune;
+					options->Crf = m_encoderOptions->Crf;
+					options->GopSize = m_encoderOptions->GopSize;
+					options->MaxBFrames = m_encoderOptions->MaxBFrames;
+					options->Lossless = m_encoderOptions->Lossless;
+
+					for each (KeyValuePair<String^, String^> option in m_encoderOptions->CodecOptions)
+					{
+						options->CodecOptions[option.Key] = option.Value;
+					}
+
+					String^ targetFolder = Path::GetDirectoryName(Path::GetFullPath(job->TargetFileName));
+
+					if (!String::IsNullOrEmpty(targetFolder))
+					{
+						Directory::CreateDirectory(targetFolder);
+					}
+
+					writer->VariableFrameRate = true;
+					writer->QueueSize = EncoderQueueSize;
+					writer->QueuePolicy = VideoQueuePolicy::Block;
+					writer->Open(job->TargetFileName, reader->Width, reader->Height, reader->FrameRate,
+						m_codec, m_bitRate, options);
+
+					if (m_burnInTimestamp)
+					{
+						font = gcnew System::Drawing::Font(FontFamily::GenericMonospace,
+							(float) System::Math::Max(10, reader->Height / 30), GraphicsUnit::Pixel);
+					}
+
+					while (true)
+					{
+						if (m_stopping)
+						{
+							cancelled = true;
+							break;
+						}
+
+						Bitmap^ frame = reader->ReadVideoFrame();
+
+						if (frame == nullptr)
+						{
+							break;
+						}
+
+						try
+						{
+							TimeSpan timestamp = reader->FrameTimestamp;
+
+							if (font != nullptr)
+							{
+								Graphics^ graphics = Graphics::FromImage(frame);
+								String^ text = timestamp.ToString("hh\\:mm\\:ss\\.fff");
+
+								try
+								{
+									graphics->DrawString(text, font, Brushes::Black, 5.0f, 5.0f);
+									graphics->DrawString(text, font, Brushes::White, 4.0f, 4.0f);
+								}
+								finally
+								{
+									delete graphics;
+								}
+							}
+
+							// the writer copies the frame, so it can be returned to the reader right away
+							writer->WriteVideoFrame(frame, timestamp);
+						}
+						finally
+						{
+							reader->ReturnVideoFrame(frame);
+						}
+
+						framesCount++;
+					}
+
+					writer->Close();
+
+					if (!cancelled)
+					{
+						AppendJournal(job);
+						Interlocked::Increment(m_completedCount);
+					}
+				}
+				catch (Exception^ ex)
+				{
+					error = ex;
+				}
+				finally
+				{
+					delete font;
+					writer->Close();
+					reader->Close();
+				}
+
+				stopwatch->Stop();
+
+				ReportFile(gcnew VideoTranscodeEventArgs(job, framesCount, stopwatch->Elapsed, error, false, cancelled));
+			}
+
+			void VideoBatchTranscoder::ReportFile(VideoTranscodeEventArgs^ eventArgs)
+			{
+				// the event is fired on a worker thread, where exception of a handler would end the process
+				try
+				{
+					FileCompleted(this, eventArgs);
+				}
+				catch (Exception^ ex)
+				{
+					Monitor::Enter(m_sync);
+					try
+					{
+						m_handlerErrors->Add(gcnew VideoException("Handler of FileCompleted event failed for " +
+							eventArgs->Job->SourceFileName + ": " + ex->Message, ex));
+					}
+					finally
+					{
+						Monitor::Exit(m_sync);
+					}
+				}
+			}
+
+			void VideoBatchTranscoder::AppendJournal(VideoTranscodeJob^ job)
+			{
+				if (m_journalFileName == nullptr)
+				{
+					return;
+				}
+
+				// the journal is opened for every completed video file, so it is complete on disk
+				// even if the process is killed
+				Monitor::Enter(m_sync);
+				try
+				{
+					File::AppendAllText(m_journalFileName, journal_key(job) + Environment::NewLine);
+				}
+				finally
+				{
+					Monitor::Exit(m_sync);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,476 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+#include "VideoCodec.h"
+#include "VideoEncoderOptions.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+using namespace System::Drawing;
+using namespace System::Threading;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Video file to transcode by <see cref="VideoBatchTranscoder"/>.
+			/// </summary>
+			///
+			public ref class VideoTranscodeJob
+			{
+				String^ m_sourceFileName;
+				String^ m_targetFileName;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoTranscodeJob"/> class.
+				/// </summary>
+				///
+				/// <param name="sourceFileName">Video file to read.</param>
+				/// <param name="targetFileName">Video file to create.</param>
+				///
+				/// <exception cref="ArgumentNullException">File name is not specified.</exception>
+				///
+				VideoTranscodeJob(String^ sourceFileName, String^ targetFileName);
+
+				/// <summary>
+				/// Video file to read.
+				/// </summary>
+				///
+				property String^ SourceFileName
+				{
+					String^ get()
+					{
+						return m_sourceFileName;
+					}
+				}
+
+				/// <summary>
+				/// Video file to create.
+				/// </summary>
+				///
+				property String^ TargetFileName
+				{
+					String^ get()
+					{
+						return m_targetFileName;
+					}
+				}
+			};
+
+			/// <summary>
+			/// Arguments of the event, which reports transcoding of a single video file.
+			/// </summary>
+			///
+			public ref class VideoTranscodeEventArgs : EventArgs
+			{
+				VideoTranscodeJob^ m_job;
+				Int64 m_framesCount;
+				TimeSpan m_elapsed;
+				Exception^ m_error;
+				bool m_skipped;
+				bool m_cancelled;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoTranscodeEventArgs"/> class.
+				/// </summary>
+				///
+				/// <param name="job">Transcoded video file.</param>
+				/// <param name="framesCount">Number of transcoded frames.</param>
+				/// <param name="elapsed">Time spent on transcoding the video file.</param>
+				/// <param name="error">Error, which stopped transcoding, or <see langword="null"/>.</param>
+				/// <param name="skipped">Video file was transcoded by previous run.</param>
+				/// <param name="cancelled">Transcoding was stopped before reaching end of the video file.</param>
+				///
+				VideoTranscodeEventArgs(VideoTranscodeJob^ job, Int64 framesCount, TimeSpan elapsed, Exception^ error,
+					bool skipped, bool cancelled) :
+					m_job(job), m_framesCount(framesCount), m_elapsed(elapsed), m_error(error),
+					m_skipped(skipped), m_cancelled(cancelled) { }
+
+				/// <summary>
+				/// Transcoded video file.
+				/// </summary>
+				///
+				property VideoTranscodeJob^ Job
+				{
+					VideoTranscodeJob^ get()
+					{
+						return m_job;
+					}
+				}
+
+				/// <summary>
+				/// Number of transcoded frames.
+				/// </summary>
+				///
+				property Int64 FramesCount
+				{
+					Int64 get()
+					{
+						return m_framesCount;
+					}
+				}
+
+				/// <summary>
+				/// Time spent on transcoding the video file.
+				/// </summary>
+				///
+				property TimeSpan Elapsed
+				{
+					TimeSpan get()
+					{
+						return m_elapsed;
+					}
+				}
+
+				/// <summary>
+				/// Transcoding throughput, frames per second.
+				/// </summary>
+				///
+				property double FramesPerSecond
+				{
+					double get()
+					{
+						return (m_elapsed.TotalSeconds > 0) ? m_framesCount / m_elapsed.TotalSeconds : 0;
+					}
+				}
+
+				/// <summary>
+				/// Error, which stopped transcoding of the video file, or <see langword="null"/> if there was no error.
+				/// </summary>
+				///
+				property Exception^ Error
+				{
+					Exception^ get()
+					{
+						return m_error;
+					}
+				}
+
+				/// <summary>
+				/// The video file was not transcoded, since it was completed by previous run.
+				/// </summary>
+				///
+				/// <remarks><para>See <see cref="VideoBatchTranscoder::JournalFileName"/>.</para></remarks>
+				///
+				property bool Skipped
+				{
+					bool get()
+					{
+						return m_skipped;
+					}
+				}
+
+				/// <summary>
+				/// Transcoding was stopped by <see cref="VideoBatchTranscoder::Stop"/> before reaching end
+				/// of the video file, so the created video file is incomplete.
+				/// </summary>
+				///
+				property bool Cancelled
+				{
+					bool get()
+					{
+						return m_cancelled;
+					}
+				}
+			};
+
+			/// <summary>
+			/// Delegate for the event reporting transcoding of a single video file.
+			/// </summary>
+			///
+			/// <param name="sender">Sender object.</param>
+			/// <param name="eventArgs">Event arguments.</param>
+			///
+			public delegate void VideoTranscodeEventHandler(Object^ sender, VideoTranscodeEventArgs^ eventArgs);
+
+			/// <summary>
+			/// Class for transcoding a batch of video files.
+			/// </summary>
+			///
+			/// <remarks><para>The class reads video files with <see cref="VideoFileReader"/> and writes them again
+			/// with <see cref="VideoFileWriter"/>, re-encoding video with the specified codec and bit rate. Several video
+			/// files are transcoded at once (see <see cref="MaxConcurrentFiles"/>), each one on its own thread, while
+			/// the available processors are split between decoders and encoders of the video files, so they do not
+			/// compete for processors with each other. Encoding of every video file runs on a separate thread as well
+			/// (see <see cref="VideoFileWriter::QueueSize"/>), so it overlaps with decoding.</para>
+			///
+			/// <para>Frames keep presentation time of the source video file (see <see cref="VideoFileWriter::VariableFrameRate"/>)
+			/// and may get it drawn in their corner (see <see cref="BurnInTimestamp"/>). Sound is not transcoded.</para>
+			///
+			/// <para>Completed video files are recorded in a journal (see <see cref="JournalFileName"/>), so an
+			/// interrupted batch can be run again and continues with the files, which were not completed.</para>
+			///
+			/// <para>Sample usage:</para>
+			/// <code>
+			/// VideoBatchTranscoder transcoder = new VideoBatchTranscoder( );
+			/// transcoder.BitRate = 4000000;
+			/// transcoder.JournalFileName = @"export\journal.txt";
+			/// transcoder.FileCompleted += ( sender, e ) =&gt;
+			///     Console.WriteLine( "{0}: {1} frames, {2:F1} fps", e.Job.SourceFileName, e.FramesCount, e.FramesPerSecond );
+			///
+			/// List&lt;VideoTranscodeJob&gt; jobs = new List&lt;VideoTranscodeJob&gt;( );
+			/// foreach ( string file in Directory.GetFiles( "recordings", "*.avi" ) )
+			/// {
+			///     jobs.Add( new VideoTranscodeJob( file, Path.Combine( "export", Path.GetFileNameWithoutExtension( file ) + ".mp4" ) ) );
+			/// }
+			/// transcoder.Run( jobs );
+			/// </code>
+			/// </remarks>
+			///
+			public ref class VideoBatchTranscoder
+			{
+				VideoCodec m_codec;
+				int m_bitRate;
+				VideoEncoderOptions^ m_encoderOptions;
+				int m_maxConcurrentFiles;
+				System::Drawing::Size m_outputSize;
+				bool m_burnInTimestamp;
+				String^ m_journalFileName;
+
+				// state of the running batch
+				Object^ m_sync;
+				Queue<VideoTranscodeJob^>^ m_pendingJobs;
+				int m_decoderThreads;
+				int m_encoderThreads;
+				int m_completedCount;
+				volatile bool m_stopping;
+				List<Exception^>^ m_handlerErrors;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoBatchTranscoder"/> class.
+				/// </summary>
+				///
+				VideoBatchTranscoder();
+
+				/// <summary>
+				/// Video codec to encode video files with.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <see cref="VideoCodec::h264"/>.</para></remarks>
+				///
+				property VideoCodec Codec
+				{
+					VideoCodec get()
+					{
+						return m_codec;
+					}
+					void set(VideoCodec codec)
+					{
+						m_codec = codec;
+					}
+				}
+
+				/// <summary>
+				/// Bit rate to encode video files with.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <b>4000000</b>.</para></remarks>
+				///
+				property int BitRate
+				{
+					int get()
+					{
+						return m_bitRate;
+					}
+					void set(int bitRate)
+					{
+						m_bitRate = System::Math::Max(0, bitRate);
+					}
+				}
+
+				/// <summary>
+				/// Encoder settings used for every video file.
+				/// </summary>
+				///
+				/// <remarks><para>The <see cref="VideoEncoderOptions::ThreadCount"/> setting is ignored, since
+				/// processors are split between video files transcoded at once.</para></remarks>
+				///
+				property VideoEncoderOptions^ EncoderOptions
+				{
+					VideoEncoderOptions^ get()
+					{
+						return m_encoderOptions;
+					}
+				}
+
+				/// <summary>
+				/// Maximum number of video files transcoded at once.
+				/// </summary>
+				///
+				/// <remarks><para>Decoders and encoders of a single video file do not scale well over many
+				/// threads, so transcoding several video files at once makes better use of processors. Each video
+				/// file gets its share of processors for decoding and encoding.</para>
+				///
+				/// <para>Default value is set to quarter of the number of processors in the system, but at least <b>1</b>.</para>
+				/// </remarks>
+				///
+				property int MaxConcurrentFiles
+				{
+					int get()
+					{
+						return m_maxConcurrentFiles;
+					}
+					void set(int maxConcurrentFiles)
+					{
+						m_maxConcurrentFiles = System::Math::Max(1, maxConcurrentFiles);
+					}
+				}
+
+				/// <summary>
+				/// Size of created video files.
+				/// </summary>
+				///
+				/// <remarks><para>Video frames are scaled while decoding (see <see cref="VideoFileReader::OutputSize"/>).</para>
+				///
+				/// <para>Default value is set to <see cref="System::Drawing::Size::Empty"/>, which keeps size
+				/// of the source video files.</para>
+				/// </remarks>
+				///
+				/// <exception cref="ArgumentException">Width and height must be both positive or both zero.</exception>
+				///
+				property System::Drawing::Size OutputSize
+				{
+					System::Drawing::Size get()
+					{
+						return m_outputSize;
+					}
+					void set(System::Drawing::Size outputSize)
+					{
+						if ((outputSize.Width < 0) || (outputSize.Height < 0) ||
+							((outputSize.Width == 0) != (outputSize.Height == 0)))
+						{
+							throw gcnew ArgumentException("Width and height must be both positive or both zero.");
+						}
+						m_outputSize = outputSize;
+					}
+				}
+
+				/// <summary>
+				/// Draw presentation time of every frame into its top left corner.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <see langword="false"/>.</para></remarks>
+				///
+				property bool BurnInTimestamp
+				{
+					bool get()
+					{
+						return m_burnInTimestamp;
+					}
+					void set(bool burnInTimestamp)
+					{
+						m_burnInTimestamp = burnInTimestamp;
+					}
+				}
+
+				/// <summary>
+				/// Text file recording completed video files.
+				/// </summary>
+				///
+				/// <remarks><para>When the property is set, every completed video file is appended to the journal.
+				/// Running a batch again skips video files, which are listed in the journal for the same target file,
+				/// if the target file still exists. Video files, which were not completed, are transcoded from the
+				/// beginning.</para>
+				///
+				/// <para>Default value is set to <see langword="null"/>, which means no journal is kept.</para>
+				/// </remarks>
+				///
+				property String^ JournalFileName
+				{
+					String^ get()
+					{
+						return m_journalFileName;
+					}
+					void set(String^ journalFileName)
+					{
+						m_journalFileName = journalFileName;
+					}
+				}
+
+				/// <summary>
+				/// Event reporting each completed, failed or skipped video file.
+				/// </summary>
+				///
+				/// <remarks><para><note>The event is fired on the thread transcoding the video file, so several
+				/// handlers may run at once. Exceptions thrown by handlers do not stop the batch, they are collected
+				/// in <see cref="HandlerErrors"/>.</note></para></remarks>
+				///
+				event VideoTranscodeEventHandler^ FileCompleted;
+
+				/// <summary>
+				/// Exceptions thrown by handlers of <see cref="FileCompleted"/> event during the last run.
+				/// </summary>
+				///
+				/// <remarks><para>Each exception is a <see cref="VideoException"/> naming the reported video file,
+				/// which has the exception thrown by the handler as its inner exception.</para></remarks>
+				///
+				property array<Exception^>^ HandlerErrors
+				{
+					array<Exception^>^ get()
+					{
+						Monitor::Enter(m_sync);
+						try
+						{
+							return m_handlerErrors->ToArray();
+						}
+						finally
+						{
+							Monitor::Exit(m_sync);
+						}
+					}
+				}
+
+				/// <summary>
+				/// Transcode the specified video files.
+				/// </summary>
+				///
+				/// <param name="jobs">Video files to transcode.</param>
+				///
+				/// <returns>Returns number of video files transcoded successfully, not counting skipped ones.</returns>
+				///
+				/// <remarks><para>The method blocks until all video files are transcoded or <see cref="Stop"/> is called.
+				/// An error in one video file does not stop the batch, it is reported by <see cref="FileCompleted"/>
+				/// event.</para></remarks>
+				///
+				/// <exception cref="ArgumentNullException">Jobs are not specified.</exception>
+				/// <exception cref="System::IO::IOException">Cannot read or write the journal file.</exception>
+				///
+				int Run(IEnumerable<VideoTranscodeJob^>^ jobs);
+
+				/// <summary>
+				/// Stop the running batch.
+				/// </summary>
+				///
+				/// <remarks><para>The method does not wait, <see cref="Run"/> returns once the video files being
+				/// transcoded are closed. These are reported as cancelled and are not recorded in the journal.
+				/// If the method is called before <see cref="Run"/>, the next run stops before transcoding any
+				/// video file.</para></remarks>
+				///
+				void Stop();
+
+			private:
+
+				void WorkerThread();
+				void TranscodeFile(VideoTranscodeJob^ job);
+				void AppendJournal(VideoTranscodeJob^ job);
+				void ReportFile(VideoTranscodeEventArgs^ eventArgs);
+			};
+		}
+	}
+}
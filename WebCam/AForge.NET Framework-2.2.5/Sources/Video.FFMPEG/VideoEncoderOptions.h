@@ -0,0 +1,260 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+#include "VideoThreadingMode.h"
+
+using namespace System;
+using namespace System::Collections::Generic;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Encoder settings used by <see cref="VideoFileWriter"/> when creating new video file.
+			/// </summary>
+			///
+			/// <remarks><para>The class allows to tune the video encoder beyond codec and bit rate, which are
+			/// specified directly to <see cref="VideoFileWriter::Open( String^, int, int, Rational, VideoCodec, int, VideoEncoderOptions^ )"/>.
+			/// Settings not supported by the selected codec are ignored.</para>
+			///
+			/// <para>Sample usage:</para>
+			/// <code>
+			/// VideoEncoderOptions options = new VideoEncoderOptions( );
+			/// options.Preset = "veryfast";
+			/// options.Tune   = "zerolatency";
+			/// options.Crf    = 23;
+			/// options.CodecOptions["x264-params"] = "rc-lookahead=10";
+			///
+			/// VideoFileWriter writer = new VideoFileWriter( );
+			/// writer.Open( "test.mp4", 3840, 2160, 30, VideoCodec.h264, 20000000, options );
+			/// </code>
+			/// </remarks>
+			///
+			public ref class VideoEncoderOptions
+			{
+				int m_threadCount;
+				VideoThreadingMode m_threadingMode;
+				String^ m_preset;
+				String^ m_tune;
+				int m_crf;
+				int m_gopSize;
+				int m_maxBFrames;
+				bool m_lossless;
+				Dictionary<String^, String^>^ m_codecOptions;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoEncoderOptions"/> class.
+				/// </summary>
+				///
+				VideoEncoderOptions()
+					: m_threadCount(0), m_threadingMode(VideoThreadingMode::Frame), m_preset(nullptr), m_tune(nullptr),
+					  m_crf(-1), m_gopSize(12), m_maxBFrames(0), m_lossless(false),
+					  m_codecOptions(gcnew Dictionary<String^, String^>()) { }
+
+				/// <summary>
+				/// Number of threads used by the encoder.
+				/// </summary>
+				///
+				/// <remarks><para>Setting the property to <b>0</b> makes encoder to use as many threads
+				/// as there are processors in the system.</para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property int ThreadCount
+				{
+					int get()
+					{
+						return m_threadCount;
+					}
+					void set(int threadCount)
+					{
+						m_threadCount = System::Math::Max(0, threadCount);
+					}
+				}
+
+				/// <summary>
+				/// Multithreading method used by the encoder.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <see cref="VideoThreadingMode::Frame"/>.</para></remarks>
+				///
+				property VideoThreadingMode ThreadingMode
+				{
+					VideoThreadingMode get()
+					{
+						return m_threadingMode;
+					}
+					void set(VideoThreadingMode threadingMode)
+					{
+						m_threadingMode = threadingMode;
+					}
+				}
+
+				/// <summary>
+				/// Encoder preset, like "ultrafast", "veryfast" or "medium" for H.264/H.265.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <see langword="null"/>, which keeps encoder's default.</para></remarks>
+				///
+				property String^ Preset
+				{
+					String^ get()
+					{
+						return m_preset;
+					}
+					void set(String^ preset)
+					{
+						m_preset = preset;
+					}
+				}
+
+				/// <summary>
+				/// Encoder tuning, like "zerolatency" or "film" for H.264/H.265.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <see langword="null"/>, which keeps encoder's default.</para></remarks>
+				///
+				property String^ Tune
+				{
+					String^ get()
+					{
+						return m_tune;
+					}
+					void set(String^ tune)
+					{
+						m_tune = tune;
+					}
+				}
+
+				/// <summary>
+				/// Constant rate factor - quality based rate control of H.264/H.265 and VP8/VP9 encoders.
+				/// </summary>
+				///
+				/// <remarks><para>Lower values give better quality and larger files. Setting the property to
+				/// <b>-1</b> keeps encoder using bit rate specified on opening video file.</para>
+				///
+				/// <para>Default value is set to <b>-1</b>.</para>
+				/// </remarks>
+				///
+				property int Crf
+				{
+					int get()
+					{
+						return m_crf;
+					}
+					void set(int crf)
+					{
+						m_crf = System::Math::Max(-1, crf);
+					}
+				}
+
+				/// <summary>
+				/// Maximum distance between two key frames, in frames.
+				/// </summary>
+				///
+				/// <remarks><para>Default value is set to <b>12</b>.</para></remarks>
+				///
+				property int GopSize
+				{
+					int get()
+					{
+						return m_gopSize;
+					}
+					void set(int gopSize)
+					{
+						m_gopSize = System::Math::Max(0, gopSize);
+					}
+				}
+
+				/// <summary>
+				/// Maximum number of B-frames between non B-frames.
+				/// </summary>
+				///
+				/// <remarks><para><note>H.264 video is encoded using baseline profile only when the property
+				/// is set to <b>0</b>, since the profile does not support B-frames.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property int MaxBFrames
+				{
+					int get()
+					{
+						return m_maxBFrames;
+					}
+					void set(int maxBFrames)
+					{
+						m_maxBFrames = System::Math::Max(0, maxBFrames);
+					}
+				}
+
+				/// <summary>
+				/// Lossless recording of RGB images.
+				/// </summary>
+				///
+				/// <remarks><para>By default images are converted to the pixel format of the codec listed in
+				/// <see cref="VideoCodec"/> documentation, which is YUV for most codecs, even lossless ones like
+				/// <see cref="VideoCodec::ffv1"/> or <see cref="VideoCodec::huffyuv"/>. When the property is set
+				/// to <see langword="true"/>, the encoder is given RGB pixel format it supports natively, so images
+				/// are stored without any loss and with no or only cheap conversion:</para>
+				/// <list type="bullet">
+				/// <item><see cref="VideoCodec::ffv1"/> - BGR0, 32 bpp images are encoded as they are;</item>
+				/// <item><see cref="VideoCodec::huffyuv"/>, <see cref="VideoCodec::ffvhuff"/> - BGRA, 32 bpp images are encoded as they are;</item>
+				/// <item><see cref="VideoCodec::utvideo"/>, <see cref="VideoCodec::magicyuv"/> - planar GBR;</item>
+				/// <item><see cref="VideoCodec::ljpeg"/>, <see cref="VideoCodec::jpegls"/>, <see cref="VideoCodec::rawvideo"/> - BGR24,
+				/// 24 bpp images are encoded as they are;</item>
+				/// <item><see cref="VideoCodec::png"/> - RGB24.</item>
+				/// </list>
+				///
+				/// <para>Images, which still need conversion, are repacked using nearest neighbour conversion
+				/// without any filtering, since the image size never changes.</para>
+				///
+				/// <para>Opening video file with other codecs fails, if the property is set.</para>
+				///
+				/// <para>Default value is set to <see langword="false"/>.</para>
+				/// </remarks>
+				///
+				property bool Lossless
+				{
+					bool get()
+					{
+						return m_lossless;
+					}
+					void set(bool lossless)
+					{
+						m_lossless = lossless;
+					}
+				}
+
+				/// <summary>
+				/// Private options of the encoder, which are passed to FFmpeg as they are.
+				/// </summary>
+				///
+				/// <remarks><para>The dictionary allows to set any option supported by the selected encoder,
+				/// for example "x264-params" for H.264 or "deadline" for VP8/VP9. Options set here take precedence
+				/// over <see cref="Preset"/>, <see cref="Tune"/> and <see cref="Crf"/> properties.</para></remarks>
+				///
+				property Dictionary<String^, String^>^ CodecOptions
+				{
+					Dictionary<String^, String^>^ get()
+					{
+						return m_codecOptions;
+					}
+				}
+			};
+		}
+	}
+}
@@ -2,7 +2,7 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2012
+// Copyright © AForge.NET, 2009-2012
 // contacts@aforgenet.com
 //
 
@@ -33,32 +33,84 @@ namespace AForge
 			{
 			public:
 				libffmpeg::AVFormatContext*		FormatContext;
+				libffmpeg::AVIOContext*			IOContext;
 				libffmpeg::AVStream*			VideoStream;
 				libffmpeg::AVCodecContext*		CodecContext;
 				libffmpeg::AVFrame*				VideoFrame;
 				struct libffmpeg::SwsContext*	ConvertContext;
-				unsigned long int nextFrameIndex;
+
+				// format of decoded frames provided to user and context converting to it, if the
+				// decoder does not produce the format itself
+				VideoPixelFormat OutputFormat;
+				struct libffmpeg::SwsContext*	OutputConvertContext;
+
+				// area of decoded frames provided to user, zero size if whole frames are provided
+				int CropX;
+				int CropY;
+				int CropWidth;
+				int CropHeight;
+				int64_t nextFrameIndex;
 
 				libffmpeg::AVPacket* Packet;
-				int uint8_tsRemaining;
+				bool Draining;
+
+				// the video stream was read without decoding (to build index of frames),
+				// so the next frame has to be found by seeking
+				bool SeekPending;
+
+				// index of video frames in presentation order - timestamp of each frame
+				// and timestamp of the key frame, which its decoding starts from
+				String^ FileName;
+				array<Int64>^ FramePts;
+				array<Int64>^ FrameSeekTs;
+
+				// stream read through custom I/O context, if video is not read from a file
+				System::Runtime::InteropServices::GCHandle InputHandle;
+
+				// video frames given back by user to be reused
+				System::Collections::Generic::Stack<Bitmap^>^ BitmapPool;
+				System::Collections::Generic::Stack<UnmanagedImage^>^ ImagePool;
+				System::Collections::Generic::Stack<DecodedVideoFrame^>^ DecodedPool;
+				Object^ PoolSync;
 
 				ReaderPrivateData()
 				{
 					FormatContext = nullptr;
+					IOContext = nullptr;
 					VideoStream = nullptr;
 					CodecContext = nullptr;
 					VideoFrame = nullptr;
 					ConvertContext = nullptr;
 
+					OutputFormat = VideoPixelFormat::Bgr24;
+					OutputConvertContext = nullptr;
+
+					CropX = 0;
+					CropY = 0;
+					CropWidth = 0;
+					CropHeight = 0;
+
 					Packet = nullptr;
-					uint8_tsRemaining = 0;
+					Draining = false;
+					SeekPending = false;
 					nextFrameIndex = 0;
+
+					FileName = nullptr;
+					FramePts = nullptr;
+					FrameSeekTs = nullptr;
+
+					BitmapPool = gcnew System::Collections::Generic::Stack<Bitmap^>();
+					ImagePool = gcnew System::Collections::Generic::Stack<UnmanagedImage^>();
+					DecodedPool = gcnew System::Collections::Generic::Stack<DecodedVideoFrame^>();
+					PoolSync = gcnew Object();
 				}
 			};
 
 			// Class constructor
 			VideoFileReader::VideoFileReader(void) :
-				data(nullptr), disposed(false) { }
+				data(nullptr), disposed(false), m_threadCount(0), m_threadingMode(VideoThreadingMode::Frame),
+				m_useIndexFile(true), m_streamBufferSize(65536), m_outputFormat(VideoPixelFormat::Bgr24),
+				m_outputSize(System::Drawing::Size::Empty), m_cropRectangle(System::Drawing::Rectangle::Empty) { }
 
 #pragma managed(push, off)
 			static libffmpeg::AVFormatContext* open_file(const char* fileName)
@@ -71,8 +123,318 @@ namespace AForge
 					return nullptr;
 				return formatContext;
 			}
+
+			static libffmpeg::AVFormatContext* open_stream(libffmpeg::AVIOContext* ioContext)
+			{
+				libffmpeg::AVFormatContext* formatContext = libffmpeg::avformat_alloc_context();
+
+				formatContext->pb = ioContext;
+				formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+				int success = libffmpeg::avformat_open_input(&formatContext, nullptr, nullptr, nullptr);
+
+				if (success != 0)
+					return nullptr;
+				return formatContext;
+			}
 #pragma managed(pop)
 
+			// Stream read by FFmpeg through custom I/O context, positions reported to FFmpeg are
+			// relative to position of the stream at the time it was opened
+			ref class StreamInput
+			{
+			public:
+				System::IO::Stream^ Stream;
+				Int64 Origin;
+				array<Byte>^ Buffer;
+			};
+
+			static StreamInput^ get_stream_input(void* opaque)
+			{
+				return (StreamInput^) System::Runtime::InteropServices::GCHandle::FromIntPtr(IntPtr(opaque)).Target;
+			}
+
+			// Callback reading data of custom I/O context
+			static int read_stream(void* opaque, uint8_t* buffer, int size)
+			{
+				StreamInput^ input = get_stream_input(opaque);
+
+				try
+				{
+					if (input->Buffer->Length < size)
+						input->Buffer = gcnew array<Byte>(size);
+
+					int read = input->Stream->Read(input->Buffer, 0, size);
+					if (read == 0)
+						return AVERROR_EOF;
+
+					System::Runtime::InteropServices::Marshal::Copy(input->Buffer, 0, IntPtr(buffer), read);
+					return read;
+				}
+				catch (Exception^)
+				{
+					// exceptions must not get through FFmpeg, which reports the error instead
+					return AVERROR(EIO);
+				}
+			}
+
+			// Callback seeking custom I/O context, it is only used with seekable streams
+			static int64_t seek_stream(void* opaque, int64_t offset, int whence)
+			{
+				StreamInput^ input = get_stream_input(opaque);
+
+				try
+				{
+					if ((whence & AVSEEK_SIZE) != 0)
+						return input->Stream->Length - input->Origin;
+
+					switch (whence & ~AVSEEK_FORCE)
+					{
+					case SEEK_SET:
+						return input->Stream->Seek(input->Origin + offset, System::IO::SeekOrigin::Begin) - input->Origin;
+					case SEEK_CUR:
+						return input->Stream->Seek(offset, System::IO::SeekOrigin::Current) - input->Origin;
+					case SEEK_END:
+						return input->Stream->Seek(offset, System::IO::SeekOrigin::End) - input->Origin;
+					}
+					return AVERROR(EINVAL);
+				}
+				catch (Exception^)
+				{
+					return AVERROR(EIO);
+				}
+			}
+
+			// Checks if planes of frames decoded in the specified format can be provided as the specified output format
+			static bool is_output_format(libffmpeg::AVPixelFormat decoderFormat, VideoPixelFormat outputFormat)
+			{
+				if (decoderFormat == video_pixel_formats[(int)outputFormat])
+					return true;
+
+				switch (outputFormat)
+				{
+				case VideoPixelFormat::Gray8:
+					// the first plane of planar YUV formats with 8 bits per sample is the luma
+					switch (decoderFormat)
+					{
+					case libffmpeg::AV_PIX_FMT_YUV420P:
+					case libffmpeg::AV_PIX_FMT_YUVJ420P:
+					case libffmpeg::AV_PIX_FMT_YUV422P:
+					case libffmpeg::AV_PIX_FMT_YUVJ422P:
+					case libffmpeg::AV_PIX_FMT_YUV444P:
+					case libffmpeg::AV_PIX_FMT_YUVJ444P:
+					case libffmpeg::AV_PIX_FMT_YUV440P:
+					case libffmpeg::AV_PIX_FMT_YUVJ440P:
+					case libffmpeg::AV_PIX_FMT_YUV411P:
+					case libffmpeg::AV_PIX_FMT_YUV410P:
+					case libffmpeg::AV_PIX_FMT_NV12:
+					case libffmpeg::AV_PIX_FMT_NV21:
+						return true;
+					}
+					return false;
+
+				case VideoPixelFormat::Yuv420P:
+					// full range variant has the same layout
+					return (decoderFormat == libffmpeg::AV_PIX_FMT_YUVJ420P);
+				}
+
+				return false;
+			}
+
+			int64_t FrameToPTS(libffmpeg::AVStream* stream, int frame)
+			{
+				return (int64_t(frame) * stream->r_frame_rate.den * stream->time_base.den)
+					/ (int64_t(stream->r_frame_rate.num) * stream->time_base.num);
+			}
+
+			// Reads next packet of the video stream, returns false at the end of file
+			static bool read_video_packet(ReaderPrivateData^ data)
+			{
+				while (true)
+				{
+					libffmpeg::av_packet_unref(data->Packet);
+
+					if (libffmpeg::av_read_frame(data->FormatContext, data->Packet) < 0)
+						return false;
+
+					if (data->Packet->stream_index == data->VideoStream->index)
+						return true;
+				}
+			}
+
+			// Gets context converting the current decoded frame to the specified format and size, the specified
+			// context is reused if it does the same conversion, otherwise it is freed
+			static libffmpeg::SwsContext* get_convert_context(libffmpeg::SwsContext* context, libffmpeg::AVFrame* frame,
+				int width, int height, libffmpeg::AVPixelFormat format)
+			{
+				return libffmpeg::sws_getCachedContext(context,
+					frame->width, frame->height, (libffmpeg::AVPixelFormat) frame->format,
+					width, height, format, SWS_BICUBIC, nullptr, nullptr, nullptr);
+			}
+
+			// Crops decoded frame to the requested area moving pointers to its planes only
+			static void crop_video_frame(ReaderPrivateData^ data)
+			{
+				libffmpeg::AVFrame* frame = data->VideoFrame;
+
+				// frames of unexpected size are left as they are
+				if ((data->CropX + data->CropWidth > frame->width) || (data->CropY + data->CropHeight > frame->height))
+					return;
+
+				frame->crop_left = data->CropX;
+				frame->crop_top = data->CropY;
+				frame->crop_right = frame->width - data->CropX - data->CropWidth;
+				frame->crop_bottom = frame->height - data->CropY - data->CropHeight;
+
+				if (libffmpeg::av_frame_apply_cropping(frame, libffmpeg::AV_FRAME_CROP_UNALIGNED) < 0)
+					throw gcnew VideoException("Cannot crop video frame.");
+			}
+
+			// Signature and version of frame index file
+			static const int IndexFileSignature = 0x58444946;	// "FIDX"
+			static const int IndexFileVersion = 1;
+
+			// Gets name of the frame index file kept next to the video file
+			static String^ get_index_file_name(String^ fileName)
+			{
+				return fileName + ".idx";
+			}
+
+			// Loads frame index from the index file, if it exists and was built for the current video file
+			static void read_index_file(ReaderPrivateData^ data)
+			{
+				try
+				{
+					String^ indexFileName = get_index_file_name(data->FileName);
+					if (!System::IO::File::Exists(indexFileName))
+						return;
+
+					System::IO::FileInfo^ info = gcnew System::IO::FileInfo(data->FileName);
+					System::IO::BinaryReader^ reader = gcnew System::IO::BinaryReader(
+						gcnew System::IO::FileStream(indexFileName, System::IO::FileMode::Open, System::IO::FileAccess::Read,
+							System::IO::FileShare::Read, 65536));
+
+					try
+					{
+						if ((reader->ReadInt32() != IndexFileSignature) ||
+							(reader->ReadInt32() != IndexFileVersion) ||
+							(reader->ReadInt64() != info->Length) ||
+							(reader->ReadInt64() != info->LastWriteTimeUtc.Ticks) ||
+							(reader->ReadInt32() != data->VideoStream->index))
+							return;
+
+						int count = reader->ReadInt32();
+						if (count < 0)
+							return;
+
+						array<Int64>^ framePts = gcnew array<Int64>(count);
+						array<Int64>^ frameSeekTs = gcnew array<Int64>(count);
+
+						for (int i = 0; i < count; i++)
+						{
+							framePts[i] = reader->ReadInt64();
+							frameSeekTs[i] = reader->ReadInt64();
+						}
+
+						data->FramePts = framePts;
+						data->FrameSeekTs = frameSeekTs;
+					}
+					finally
+					{
+						reader->Close();
+					}
+				}
+				catch (Exception^)
+				{
+					// broken or inaccessible index file is rebuilt when needed
+				}
+			}
+
+			// Saves frame index into the index file, so it does not need to be built again
+			static void write_index_file(ReaderPrivateData^ data)
+			{
+				String^ indexFileName = get_index_file_name(data->FileName);
+
+				try
+				{
+					System::IO::FileInfo^ info = gcnew System::IO::FileInfo(data->FileName);
+					System::IO::BinaryWriter^ writer = gcnew System::IO::BinaryWriter(
+						gcnew System::IO::FileStream(indexFileName, System::IO::FileMode::Create, System::IO::FileAccess::Write,
+							System::IO::FileShare::None, 65536));
+
+					try
+					{
+						writer->Write(IndexFileSignature);
+						writer->Write(IndexFileVersion);
+						writer->Write(info->Length);
+						writer->Write(info->LastWriteTimeUtc.Ticks);
+						writer->Write(data->VideoStream->index);
+						writer->Write(data->FramePts->Length);
+
+						for (int i = 0; i < data->FramePts->Length; i++)
+						{
+							writer->Write(data->FramePts[i]);
+							writer->Write(data->FrameSeekTs[i]);
+						}
+					}
+					finally
+					{
+						writer->Close();
+					}
+				}
+				catch (Exception^)
+				{
+					// the index is still used from memory, if it cannot be saved (read only folder, etc.)
+					try
+					{
+						System::IO::File::Delete(indexFileName);
+					}
+					catch (Exception^)
+					{
+					}
+				}
+			}
+
+			// Builds index of video frames reading packets of the whole video stream without decoding them
+			static void build_frame_index(ReaderPrivateData^ data)
+			{
+				libffmpeg::AVStream* stream = data->VideoStream;
+				System::Collections::Generic::List<Int64>^ framePts = gcnew System::Collections::Generic::List<Int64>();
+				System::Collections::Generic::List<Int64>^ frameSeekTs = gcnew System::Collections::Generic::List<Int64>();
+				int64_t keyFrameTs = AV_NOPTS_VALUE;
+
+				int64_t startTs = (stream->start_time != AV_NOPTS_VALUE) ? stream->start_time : 0;
+				if (libffmpeg::av_seek_frame(data->FormatContext, stream->index, startTs, AVSEEK_FLAG_BACKWARD) < 0)
+					return;
+
+				while (read_video_packet(data))
+				{
+					libffmpeg::AVPacket* packet = data->Packet;
+					int64_t pts = (packet->pts != AV_NOPTS_VALUE) ? packet->pts : packet->dts;
+
+					// frames without timestamps cannot be found by seeking
+					if (pts == AV_NOPTS_VALUE)
+					{
+						libffmpeg::av_packet_unref(packet);
+						return;
+					}
+
+					if (((packet->flags & AV_PKT_FLAG_KEY) != 0) || (keyFrameTs == AV_NOPTS_VALUE))
+						keyFrameTs = (packet->dts != AV_NOPTS_VALUE) ? packet->dts : pts;
+
+					framePts->Add(pts);
+					frameSeekTs->Add(keyFrameTs);
+				}
+
+				// packets are read in decoding order, frames are numbered in presentation order
+				array<Int64>^ ptsArray = framePts->ToArray();
+				array<Int64>^ seekTsArray = frameSeekTs->ToArray();
+				Array::Sort(ptsArray, seekTsArray);
+
+				data->FramePts = ptsArray;
+				data->FrameSeekTs = seekTsArray;
+			}
+
 			// Opens the specified video file
 			void VideoFileReader::Open(String^ fileName)
 			{
@@ -82,8 +444,6 @@ namespace AForge
 				Close();
 
 				data = gcnew ReaderPrivateData();
-				data->Packet = new libffmpeg::AVPacket();
-				data->Packet->data = nullptr;
 
 				bool success = false;
 
@@ -95,59 +455,73 @@ namespace AForge
 					int utf8StringSize = WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, NULL, 0, NULL, NULL);
 					char* nativeFileName = new char[utf8StringSize];
 					WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, nativeFileName, utf8StringSize, NULL, NULL);
+					System::Runtime::InteropServices::Marshal::FreeHGlobal(ptr);
 
 					// open the specified video file
 					data->FormatContext = open_file(nativeFileName);
+					delete[] nativeFileName;
 					if (data->FormatContext == nullptr)
 						throw gcnew System::IO::IOException("Cannot open the video file.");
 
-					// retrieve stream information
-					if (libffmpeg::avformat_find_stream_info(data->FormatContext, nullptr) < 0)
-						throw gcnew VideoException("Cannot find stream information.");
+					data->FileName = System::IO::Path::GetFullPath(fileName);
 
-					// search for the first video stream
-					for (unsigned int i = 0; i < data->FormatContext->nb_streams; i++)
-					{
-						if (data->FormatContext->streams[i]->codec->codec_type == libffmpeg::AVMEDIA_TYPE_VIDEO)
-						{
-							// get the pointer to the codec context for the video stream
-							data->CodecContext = data->FormatContext->streams[i]->codec;
-							data->VideoStream = data->FormatContext->streams[i];
-							break;
-						}
-					}
-					if (data->VideoStream == nullptr)
-						throw gcnew VideoException("Cannot find video stream in the specified file.");
+					OpenVideoStream();
 
-					// find decoder for the video stream
-					libffmpeg::AVCodec* codec = libffmpeg::avcodec_find_decoder(data->CodecContext->codec_id);
-					if (codec == nullptr)
-						throw gcnew VideoException("Cannot find codec to decode the video stream.");
+					success = true;
+				}
+				finally
+				{
+					if (!success)
+						Close();
+				}
+			}
 
+			// Opens video from the specified stream
+			void VideoFileReader::Open(System::IO::Stream^ stream)
+			{
+				CheckIfDisposed();
 
-					// open the codec
-					if (libffmpeg::avcodec_open2(data->CodecContext, codec, nullptr) < 0)
-						throw gcnew VideoException("Cannot open video codec.");
+				if (stream == nullptr)
+					throw gcnew ArgumentNullException("stream");
+				if (!stream->CanRead)
+					throw gcnew ArgumentException("The stream does not support reading.");
 
-					// allocate video frame
-					data->VideoFrame = libffmpeg::av_frame_alloc();
+				// close previous file if any was open
+				Close();
 
-					// prepare scaling context to convert RGB image to video format
-					data->ConvertContext = libffmpeg::sws_getContext(data->CodecContext->width, data->CodecContext->height, data->CodecContext->pix_fmt,
-						data->CodecContext->width, data->CodecContext->height, libffmpeg::AV_PIX_FMT_BGR24,
-						SWS_BICUBIC, nullptr, nullptr, nullptr);
+				data = gcnew ReaderPrivateData();
 
-					if (data->ConvertContext == nullptr)
-						throw gcnew VideoException("Cannot initialize frames conversion context.");
+				bool success = false;
 
-					// get some properties of the video file
-					m_width = data->CodecContext->width;
-					m_height = data->CodecContext->height;
-					libffmpeg::AVRational fps = data->VideoStream->r_frame_rate;
-					m_frameRate = Rational(fps.num, fps.den);
-					m_codecName = gcnew String(data->CodecContext->codec->name);
-					m_framesCount = data->VideoStream->nb_frames;
-					m_bitRate = data->CodecContext->bit_rate;
+				try
+				{
+					StreamInput^ input = gcnew StreamInput();
+					input->Stream = stream;
+					input->Origin = (stream->CanSeek) ? stream->Position : 0;
+					input->Buffer = gcnew array<Byte>(m_streamBufferSize);
+
+					data->InputHandle = System::Runtime::InteropServices::GCHandle::Alloc(input);
+
+					// the buffer is owned by the I/O context from now on, FFmpeg may reallocate it
+					unsigned char* buffer = (unsigned char*) libffmpeg::av_malloc(m_streamBufferSize);
+					if (buffer == nullptr)
+						throw gcnew VideoException("Cannot allocate stream buffer.");
+
+					data->IOContext = libffmpeg::avio_alloc_context(buffer, m_streamBufferSize, 0,
+						System::Runtime::InteropServices::GCHandle::ToIntPtr(data->InputHandle).ToPointer(),
+						&read_stream, nullptr, (stream->CanSeek) ? &seek_stream : nullptr);
+
+					if (data->IOContext == nullptr)
+					{
+						libffmpeg::av_free(buffer);
+						throw gcnew VideoException("Cannot allocate stream I/O context.");
+					}
+
+					data->FormatContext = open_stream(data->IOContext);
+					if (data->FormatContext == nullptr)
+						throw gcnew System::IO::IOException("Cannot open video from the stream.");
+
+					OpenVideoStream();
 
 					success = true;
 				}
@@ -158,6 +532,128 @@ namespace AForge
 				}
 			}
 
+			// Finds video stream in the opened input and prepares its decoding
+			void VideoFileReader::OpenVideoStream()
+			{
+				data->Packet = libffmpeg::av_packet_alloc();
+				if (data->Packet == nullptr)
+					throw gcnew VideoException("Cannot allocate video packet.");
+
+				// retrieve stream information
+				if (libffmpeg::avformat_find_stream_info(data->FormatContext, nullptr) < 0)
+					throw gcnew VideoException("Cannot find stream information.");
+
+				// search for the first video stream
+				for (unsigned int i = 0; i < data->FormatContext->nb_streams; i++)
+				{
+					if (data->FormatContext->streams[i]->codecpar->codec_type == libffmpeg::AVMEDIA_TYPE_VIDEO)
+					{
+						data->VideoStream = data->FormatContext->streams[i];
+						break;
+					}
+				}
+				if (data->VideoStream == nullptr)
+					throw gcnew VideoException("Cannot find video stream in the specified file.");
+
+				// let demuxer skip packets of all other streams
+				for (unsigned int i = 0; i < data->FormatContext->nb_streams; i++)
+				{
+					if (data->FormatContext->streams[i] != data->VideoStream)
+						data->FormatContext->streams[i]->discard = libffmpeg::AVDISCARD_ALL;
+				}
+
+				// find decoder for the video stream
+				libffmpeg::AVCodec* codec = libffmpeg::avcodec_find_decoder(data->VideoStream->codecpar->codec_id);
+				if (codec == nullptr)
+					throw gcnew VideoException("Cannot find codec to decode the video stream.");
+
+				// create decoder context from parameters of the video stream
+				data->CodecContext = libffmpeg::avcodec_alloc_context3(codec);
+				if (data->CodecContext == nullptr)
+					throw gcnew VideoException("Cannot allocate codec context.");
+
+				if (libffmpeg::avcodec_parameters_to_context(data->CodecContext, data->VideoStream->codecpar) < 0)
+					throw gcnew VideoException("Cannot copy codec parameters.");
+
+				data->CodecContext->pkt_timebase = data->VideoStream->time_base;
+
+				// find area of frames to provide and their size
+				int frameWidth = data->CodecContext->width;
+				int frameHeight = data->CodecContext->height;
+
+				System::Drawing::Rectangle crop = (m_cropRectangle.IsEmpty) ?
+					System::Drawing::Rectangle(0, 0, frameWidth, frameHeight) : m_cropRectangle;
+
+				if ((crop.X < 0) || (crop.Y < 0) || (crop.Width <= 0) || (crop.Height <= 0) ||
+					(crop.Right > frameWidth) || (crop.Bottom > frameHeight))
+					throw gcnew ArgumentException("Crop rectangle must lie within video frame.");
+
+				int outputWidth = (m_outputSize.IsEmpty) ? crop.Width : m_outputSize.Width;
+				int outputHeight = (m_outputSize.IsEmpty) ? crop.Height : m_outputSize.Height;
+
+				// let decoder to skip details, which are not needed for reduced output size (MJPEG and few others)
+				int lowres = 0;
+				while ((lowres < codec->max_lowres) &&
+					((crop.Width >> (lowres + 1)) >= outputWidth) && ((crop.Height >> (lowres + 1)) >= outputHeight))
+				{
+					lowres++;
+				}
+				data->CodecContext->lowres = lowres;
+
+				if (!m_cropRectangle.IsEmpty)
+				{
+					data->CropX = crop.X >> lowres;
+					data->CropY = crop.Y >> lowres;
+					data->CropWidth = crop.Width >> lowres;
+					data->CropHeight = crop.Height >> lowres;
+				}
+
+				// let the decoder to use all processors by default
+				data->CodecContext->thread_count = (m_threadCount == 0) ? Environment::ProcessorCount : m_threadCount;
+				data->CodecContext->thread_type = (m_threadingMode == VideoThreadingMode::Slice) ?
+					FF_THREAD_SLICE : FF_THREAD_FRAME;
+
+				// open the codec
+				if (libffmpeg::avcodec_open2(data->CodecContext, codec, nullptr) < 0)
+					throw gcnew VideoException("Cannot open video codec.");
+
+				// allocate video frame
+				data->VideoFrame = libffmpeg::av_frame_alloc();
+				if (data->VideoFrame == nullptr)
+					throw gcnew VideoException("Cannot allocate video frame.");
+
+				// prepare scaling context to convert cropped video frame to RGB image of the output size,
+				// it is updated when size or format of decoded frames differ from the expected ones
+				int decodedWidth = (data->CropWidth != 0) ? data->CropWidth : AV_CEIL_RSHIFT(frameWidth, lowres);
+				int decodedHeight = (data->CropHeight != 0) ? data->CropHeight : AV_CEIL_RSHIFT(frameHeight, lowres);
+
+				data->ConvertContext = libffmpeg::sws_getContext(decodedWidth, decodedHeight, data->CodecContext->pix_fmt,
+					outputWidth, outputHeight, libffmpeg::AV_PIX_FMT_BGR24,
+					SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+				if (data->ConvertContext == nullptr)
+					throw gcnew VideoException("Cannot initialize frames conversion context.");
+
+				// conversion to the output format is prepared when needed
+				data->OutputFormat = m_outputFormat;
+
+				// get some properties of the video file
+				m_width = outputWidth;
+				m_height = outputHeight;
+				libffmpeg::AVRational fps = data->VideoStream->r_frame_rate;
+				m_frameRate = Rational(fps.num, fps.den);
+				m_codecName = gcnew String(data->CodecContext->codec->name);
+				m_framesCount = data->VideoStream->nb_frames;
+				m_bitRate = data->CodecContext->bit_rate;
+				m_frameTimestamp = TimeSpan::Zero;
+
+				// frame index built before makes frame count exact
+				if ((m_useIndexFile) && (data->FileName != nullptr))
+					read_index_file(data);
+				if (data->FramePts != nullptr)
+					m_framesCount = data->FramePts->Length;
+			}
+
 			// Close current video file
 			void VideoFileReader::Close()
 			{
@@ -165,10 +661,16 @@ namespace AForge
 					return;
 
 				if (data->VideoFrame != nullptr)
-					libffmpeg::av_free(data->VideoFrame);
+				{
+					libffmpeg::AVFrame* frame = data->VideoFrame;
+					libffmpeg::av_frame_free(&frame);
+				}
 
 				if (data->CodecContext != nullptr)
-					libffmpeg::avcodec_close(data->CodecContext);
+				{
+					libffmpeg::AVCodecContext* codecContext = data->CodecContext;
+					libffmpeg::avcodec_free_context(&codecContext);
+				}
 
 				if (data->FormatContext != nullptr)
 				{
@@ -176,113 +678,368 @@ namespace AForge
 					libffmpeg::avformat_close_input(&c);
 				}
 
+				// custom I/O context is not freed with format context, the stream itself is left open
+				if (data->IOContext != nullptr)
+				{
+					libffmpeg::AVIOContext* ioContext = data->IOContext;
+					libffmpeg::av_freep(&ioContext->buffer);
+					libffmpeg::avio_context_free(&ioContext);
+				}
+
+				if (data->InputHandle.IsAllocated)
+					data->InputHandle.Free();
+
 				if (data->ConvertContext != nullptr)
 					libffmpeg::sws_freeContext(data->ConvertContext);
 
-				if (data->Packet->data != nullptr)
-					libffmpeg::av_packet_unref(data->Packet);
+				if (data->OutputConvertContext != nullptr)
+					libffmpeg::sws_freeContext(data->OutputConvertContext);
 
-				data = nullptr;
-			}
+				if (data->Packet != nullptr)
+				{
+					libffmpeg::AVPacket* packet = data->Packet;
+					libffmpeg::av_packet_free(&packet);
+				}
 
-			int64_t FrameToPTS(libffmpeg::AVStream* stream, int frame)
-			{
-				return (int64_t(frame) * stream->r_frame_rate.den * stream->time_base.den)
-					/ (int64_t(stream->r_frame_rate.num) * stream->time_base.num);
+				// free video frames given back, frames returned later are disposed right away
+				Monitor::Enter(data->PoolSync);
+				try
+				{
+					while (data->BitmapPool->Count != 0)
+						delete data->BitmapPool->Pop();
+					while (data->ImagePool->Count != 0)
+						delete data->ImagePool->Pop();
+					while (data->DecodedPool->Count != 0)
+						data->DecodedPool->Pop()->Free();
+
+					data->BitmapPool = nullptr;
+					data->ImagePool = nullptr;
+					data->DecodedPool = nullptr;
+				}
+				finally
+				{
+					Monitor::Exit(data->PoolSync);
+				}
+
+				data = nullptr;
 			}
 
 			// Read next video frame of the current video file
-			Bitmap^ VideoFileReader::readVideoFrame(int frameIndex, BitmapData^ output)
+			bool VideoFileReader::readVideoFrame(int frameIndex)
 			{
-				if (frameIndex == -1)
-					frameIndex = data->nextFrameIndex;
 				CheckIfDisposed();
 
 				if (data == nullptr)
 					throw gcnew System::IO::IOException("Cannot read video frames since video file is not open.");
 
-				int frameFinished;
-				Bitmap^ bitmap = nullptr;
+				if (frameIndex == -1)
+					frameIndex = (int) data->nextFrameIndex;
+
+				// there are no frames before the first one
+				if (frameIndex < 0)
+					return false;
 
-				int uint8_tsDecoded;
-				bool exit = false;
 				bool needsToSeek = false;
 
-				if (frameIndex != this->data->nextFrameIndex)
+				int64_t targetPts = AV_NOPTS_VALUE;
+
+				if ((frameIndex != this->data->nextFrameIndex) || (data->SeekPending))
 				{
+					if (data->FramePts == nullptr)
+					{
+						// reading the whole video stream moves away from the next frame
+						data->SeekPending = true;
+						build_frame_index(data);
+
+						if ((data->FramePts != nullptr) && (m_useIndexFile) && (data->FileName != nullptr))
+							write_index_file(data);
+						if (data->FramePts != nullptr)
+							m_framesCount = data->FramePts->Length;
+					}
+
+					// frames out of range are rejected before flushing the decoder,
+					// so reading of the following frames is not disturbed
+					if ((data->FramePts != nullptr) && ((frameIndex < 0) || (frameIndex >= data->FramePts->Length)))
+						return false;
+
 					needsToSeek = true;
-					libffmpeg::avcodec_flush_buffers(data->VideoStream->codec);
-					int error = libffmpeg::av_seek_frame(data->FormatContext, data->VideoStream->index, frameIndex, AVSEEK_FLAG_FRAME | AVSEEK_FLAG_BACKWARD);
+					libffmpeg::avcodec_flush_buffers(data->CodecContext);
+					data->Draining = false;
+
+					int error;
+
+					if (data->FramePts != nullptr)
+					{
+						// seek to the key frame decoding of the frame starts from and decode up to the frame
+						targetPts = data->FramePts[frameIndex];
+						error = libffmpeg::av_seek_frame(data->FormatContext, data->VideoStream->index,
+							data->FrameSeekTs[frameIndex], AVSEEK_FLAG_BACKWARD);
+					}
+					else
+					{
+						targetPts = FrameToPTS(data->VideoStream, frameIndex);
+						error = libffmpeg::av_seek_frame(data->FormatContext, data->VideoStream->index, frameIndex, AVSEEK_FLAG_FRAME | AVSEEK_FLAG_BACKWARD);
+					}
+
 					if (error < 0)
 						throw gcnew VideoException("Error while seeking frame.");
+
+					data->SeekPending = false;
 				}
+
 				while (true)
 				{
-					// work on the current packet until we have decoded all of it
-					while (data->uint8_tsRemaining > 0)
-					{
-						// decode the next chunk of data
-						uint8_tsDecoded = libffmpeg::avcodec_decode_video2(data->CodecContext, data->VideoFrame, &frameFinished, data->Packet);
+					// take the next frame the decoder has ready
+					int ret = libffmpeg::avcodec_receive_frame(data->CodecContext, data->VideoFrame);
 
-						// was there an error?
-						if (uint8_tsDecoded < 0)
-							throw gcnew VideoException("Error while decoding frame.");
+					if (ret == 0)
+					{
+						int64_t pts = data->VideoFrame->best_effort_timestamp;
 
-						data->uint8_tsRemaining -= uint8_tsDecoded;
+						if (pts == AV_NOPTS_VALUE)
+							pts = data->VideoFrame->pts;
+						if (pts == AV_NOPTS_VALUE)
+							pts = data->VideoFrame->pkt_dts;
 
-						// did we finish the current frame? Then we can return
-						if (frameFinished)
+						// frame without any timestamp can not be compared with the seeked one, so it is taken for it
+						if ((!needsToSeek) || (pts == AV_NOPTS_VALUE) || (pts >= targetPts))
 						{
-							if (!needsToSeek || data->VideoFrame->pts >= FrameToPTS(data->VideoStream, frameIndex))
+							if (data->CropWidth != 0)
+								crop_video_frame(data);
+
+							libffmpeg::AVStream* stream = data->VideoStream;
+							libffmpeg::AVRational ticks = { 1, (int)TimeSpan::TicksPerSecond };
+
+							// frames with no timestamp are expected to follow the previous one
+							if (pts == AV_NOPTS_VALUE)
+							{
+								libffmpeg::AVRational framePeriod = { stream->r_frame_rate.den, stream->r_frame_rate.num };
+								m_frameTimestamp = m_frameTimestamp + TimeSpan::FromTicks(libffmpeg::av_rescale_q(1, framePeriod, ticks));
+							}
+							else
 							{
-								data->nextFrameIndex = frameIndex + 1;
-								return DecodeVideoFrame(output);
+								if (stream->start_time != AV_NOPTS_VALUE)
+									pts -= stream->start_time;
+								m_frameTimestamp = TimeSpan::FromTicks(libffmpeg::av_rescale_q(pts, stream->time_base, ticks));
 							}
+
+							data->nextFrameIndex = frameIndex + 1;
+							return true;
 						}
+						continue;
+					}
+
+					// all frames were taken from the decoder after the end of file
+					if (ret == AVERROR_EOF)
+						return false;
+
+					if (ret != AVERROR(EAGAIN))
+						throw gcnew VideoException("Error while decoding frame.");
+
+					// the decoder needs more data, at the end of file it is asked to output delayed frames
+					if (data->Draining)
+						return false;
+
+					if (read_video_packet(data))
+					{
+						ret = libffmpeg::avcodec_send_packet(data->CodecContext, data->Packet);
+						libffmpeg::av_packet_unref(data->Packet);
+					}
+					else
+					{
+						ret = libffmpeg::avcodec_send_packet(data->CodecContext, nullptr);
+						data->Draining = true;
 					}
 
-					// read the next packet, skipping all packets that aren't
-					// for this stream
-					do
+					if (ret < 0)
+						throw gcnew VideoException("Error while decoding frame.");
+				}
+			}
+
+			// Read the given video frame into unmanaged image
+			bool VideoFileReader::TryReadVideoFrame(int frameIndex, UnmanagedImage^ output)
+			{
+				CheckIfDisposed();
+
+				if (data == nullptr)
+					throw gcnew System::IO::IOException("Cannot read video frames since video file is not open.");
+
+				if ((output->Width != m_width) || (output->Height != m_height) || (output->PixelFormat != PixelFormat::Format24bppRgb))
+					throw gcnew ArgumentException("The image must be 24 bpp image of the video frame size.");
+
+				if (!readVideoFrame(frameIndex))
+					return false;
+
+				DecodeVideoFrame(output->ImageData, output->Stride);
+				return true;
+			}
+
+			// Read the given video frame into unmanaged image taken from the pool
+			UnmanagedImage^ VideoFileReader::ReadUnmanagedVideoFrame(int frameIndex)
+			{
+				CheckIfDisposed();
+
+				if (data == nullptr)
+					throw gcnew System::IO::IOException("Cannot read video frames since video file is not open.");
+
+				if (!readVideoFrame(frameIndex))
+					return nullptr;
+
+				UnmanagedImage^ image = nullptr;
+
+				Monitor::Enter(data->PoolSync);
+				try
+				{
+					if (data->ImagePool->Count != 0)
+						image = data->ImagePool->Pop();
+				}
+				finally
+				{
+					Monitor::Exit(data->PoolSync);
+				}
+
+				if (image == nullptr)
+					image = UnmanagedImage::Create(m_width, m_height, PixelFormat::Format24bppRgb);
+
+				DecodeVideoFrame(image->ImageData, image->Stride);
+				return image;
+			}
+
+			// Gives video frame back to the pool
+			void VideoFileReader::ReturnVideoFrame(Bitmap^ frame)
+			{
+				if (frame == nullptr)
+					return;
+
+				// keep reference to data, since the file may be closed from another thread
+				ReaderPrivateData^ currentData = data;
+
+				if ((currentData != nullptr) && (frame->Width == m_width) && (frame->Height == m_height) &&
+					(frame->PixelFormat == PixelFormat::Format24bppRgb))
+				{
+					Monitor::Enter(currentData->PoolSync);
+					try
 					{
-						// free old packet if any
-						if (data->Packet->data != nullptr)
+						if (currentData->BitmapPool != nullptr)
 						{
-							libffmpeg::av_packet_unref(data->Packet);
-							data->Packet->data = nullptr;
+							currentData->BitmapPool->Push(frame);
+							return;
 						}
+					}
+					finally
+					{
+						Monitor::Exit(currentData->PoolSync);
+					}
+				}
+
+				delete frame;
+			}
+
+			// Gives video frame back to the pool
+			void VideoFileReader::ReturnVideoFrame(UnmanagedImage^ frame)
+			{
+				if (frame == nullptr)
+					return;
+
+				// keep reference to data, since the file may be closed from another thread
+				ReaderPrivateData^ currentData = data;
 
-						// read new packet
-						if (libffmpeg::av_read_frame(data->FormatContext, data->Packet) < 0)
+				if ((currentData != nullptr) && (frame->Width == m_width) && (frame->Height == m_height) &&
+					(frame->PixelFormat == PixelFormat::Format24bppRgb))
+				{
+					Monitor::Enter(currentData->PoolSync);
+					try
+					{
+						if (currentData->ImagePool != nullptr)
 						{
-							exit = true;
-							break;
+							currentData->ImagePool->Push(frame);
+							return;
 						}
-					} while (data->Packet->stream_index != data->VideoStream->index);
+					}
+					finally
+					{
+						Monitor::Exit(currentData->PoolSync);
+					}
+				}
 
-					// exit ?
-					if (exit)
-						break;
+				delete frame;
+			}
+
+			// Read the given video frame providing access to its planes
+			DecodedVideoFrame^ VideoFileReader::ReadDecodedFrame(int frameIndex)
+			{
+				CheckIfDisposed();
 
-					data->uint8_tsRemaining = data->Packet->size;
+				if (data == nullptr)
+					throw gcnew System::IO::IOException("Cannot read video frames since video file is not open.");
+
+				if (!readVideoFrame(frameIndex))
+					return nullptr;
+
+				// planes of the decoder are provided as they are, if they have the requested format and size
+				libffmpeg::AVFrame* videoFrame = data->VideoFrame;
+				bool convert = (!is_output_format((libffmpeg::AVPixelFormat) videoFrame->format, data->OutputFormat)) ||
+					(videoFrame->width != m_width) || (videoFrame->height != m_height);
+
+				if (convert)
+				{
+					data->OutputConvertContext = get_convert_context(data->OutputConvertContext, videoFrame, m_width, m_height,
+						(libffmpeg::AVPixelFormat) video_pixel_formats[(int)data->OutputFormat]);
+					if (data->OutputConvertContext == nullptr)
+						throw gcnew VideoException("Cannot initialize frames conversion context.");
 				}
 
-				// decode the rest of the last frame
-				uint8_tsDecoded = libffmpeg::avcodec_decode_video2(
-					data->CodecContext, data->VideoFrame, &frameFinished, data->Packet);
+				DecodedVideoFrame^ frame = nullptr;
 
-				// free last packet
-				if (data->Packet->data != nullptr)
+				Monitor::Enter(data->PoolSync);
+				try
 				{
-					libffmpeg::av_packet_unref(data->Packet);
-					data->Packet->data = nullptr;
+					if (data->DecodedPool->Count != 0)
+						frame = data->DecodedPool->Pop();
+				}
+				finally
+				{
+					Monitor::Exit(data->PoolSync);
+				}
+
+				if ((frame != nullptr) && (frame->IsConverted != convert))
+				{
+					frame->Free();
+					frame = nullptr;
 				}
 
-				// is there a frame
-				if (frameFinished)
-					bitmap = DecodeVideoFrame(output);
+				if (frame == nullptr)
+					frame = gcnew DecodedVideoFrame(this, m_width, m_height, data->OutputFormat, convert);
 
-				return bitmap;
+				frame->CheckOut(videoFrame, data->OutputConvertContext, m_frameTimestamp);
+				return frame;
+			}
+
+			// Gives decoded video frame back to the pool
+			void VideoFileReader::ReturnDecodedFrame(DecodedVideoFrame^ frame)
+			{
+				// keep reference to data, since the file may be closed from another thread
+				ReaderPrivateData^ currentData = data;
+
+				if ((currentData != nullptr) && (frame->Width == m_width) && (frame->Height == m_height) &&
+					(frame->Format == currentData->OutputFormat))
+				{
+					Monitor::Enter(currentData->PoolSync);
+					try
+					{
+						if (currentData->DecodedPool != nullptr)
+						{
+							currentData->DecodedPool->Push(frame);
+							return;
+						}
+					}
+					finally
+					{
+						Monitor::Exit(currentData->PoolSync);
+					}
+				}
+
+				frame->Free();
 			}
 
 			// Decodes video frame into managed Bitmap
@@ -291,26 +1048,49 @@ namespace AForge
 				Bitmap^ bitmap = nullptr;
 				if (bitmapData == nullptr)
 				{
-					bitmap = gcnew Bitmap(data->CodecContext->width, data->CodecContext->height, PixelFormat::Format24bppRgb);
+					// reuse bitmap given back by user if any
+					Monitor::Enter(data->PoolSync);
+					try
+					{
+						if (data->BitmapPool->Count != 0)
+							bitmap = data->BitmapPool->Pop();
+					}
+					finally
+					{
+						Monitor::Exit(data->PoolSync);
+					}
+
+					if (bitmap == nullptr)
+						bitmap = gcnew Bitmap(m_width, m_height, PixelFormat::Format24bppRgb);
 
 					// lock the bitmap
-					bitmapData = bitmap->LockBits(System::Drawing::Rectangle(0, 0, data->CodecContext->width, data->CodecContext->height),
+					bitmapData = bitmap->LockBits(System::Drawing::Rectangle(0, 0, m_width, m_height),
 						ImageLockMode::ReadWrite, PixelFormat::Format24bppRgb);
 				}
 
-				uint8_t* srcData[4] = { static_cast<uint8_t*>(static_cast<void*>(bitmapData->Scan0)),
-					nullptr, nullptr, nullptr };
-				int srcLinesize[4] = { bitmapData->Stride, 0, 0, 0 };
-
-				// convert video frame to the RGB bitmap
-				libffmpeg::sws_scale(data->ConvertContext, data->VideoFrame->data, data->VideoFrame->linesize, 0,
-					data->CodecContext->height, srcData, srcLinesize);
+				DecodeVideoFrame(bitmapData->Scan0, bitmapData->Stride);
 
 				if (bitmap != nullptr)
 					bitmap->UnlockBits(bitmapData);
 				return bitmap;
 			}
 
+			// Decodes video frame into the specified 24 bpp image buffer
+			void VideoFileReader::DecodeVideoFrame(IntPtr output, int stride)
+			{
+				uint8_t* srcData[4] = { static_cast<uint8_t*>(static_cast<void*>(output)),
+					nullptr, nullptr, nullptr };
+				int srcLinesize[4] = { stride, 0, 0, 0 };
+
+				// convert video frame to the RGB bitmap
+				data->ConvertContext = get_convert_context(data->ConvertContext, data->VideoFrame, m_width, m_height, libffmpeg::AV_PIX_FMT_BGR24);
+				if (data->ConvertContext == nullptr)
+					throw gcnew VideoException("Cannot initialize frames conversion context.");
+
+				libffmpeg::sws_scale(data->ConvertContext, data->VideoFrame->data, data->VideoFrame->linesize, 0,
+					data->VideoFrame->height, srcData, srcLinesize);
+			}
+
 		}
 	}
 }
@@ -2,17 +2,23 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2011
+// Copyright © AForge.NET, 2009-2011
 // contacts@aforgenet.com
 //
 
 #pragma once
 
+#include "VideoThreadingMode.h"
+#include "VideoPixelFormat.h"
+#include "DecodedVideoFrame.h"
+
 using namespace System;
 using namespace System::Drawing;
 using namespace System::Drawing::Imaging;
+using namespace System::Threading;
 using namespace AForge::Video;
 using namespace AForge::Math;
+using namespace AForge::Imaging;
 
 namespace AForge
 {
@@ -92,14 +98,25 @@ namespace AForge
 				String^ m_codecName;
 				Int64 m_framesCount;
 				int m_bitRate;
+				TimeSpan m_frameTimestamp;
+
+				int m_threadCount;
+				VideoThreadingMode m_threadingMode;
+				bool m_useIndexFile;
+				int m_streamBufferSize;
+				VideoPixelFormat m_outputFormat;
+				System::Drawing::Size m_outputSize;
+				System::Drawing::Rectangle m_cropRectangle;
 
 				// private data of the class
 				ReaderPrivateData^ data;
 				bool disposed;
 
 				Bitmap^ DecodeVideoFrame(BitmapData^ bitmapData);
+				void DecodeVideoFrame(IntPtr output, int stride);
 
-				Bitmap^ readVideoFrame(int frameIndex, BitmapData^ output);
+				bool readVideoFrame(int frameIndex);
+				void OpenVideoStream();
 
 				// Checks if video file was opened
 				void CheckIfVideoFileIsOpen()
@@ -115,6 +132,10 @@ namespace AForge
 						throw gcnew System::ObjectDisposedException("The object was already disposed.");
 				}
 
+			internal:
+				// Gives decoded video frame back to the pool
+				void ReturnDecodedFrame(DecodedVideoFrame^ frame);
+
 			protected:
 				/// <summary>
 				/// Object's finalizer.
@@ -131,6 +152,10 @@ namespace AForge
 				/// Frame width of the opened video file.
 				/// </summary>
 				///
+				/// <remarks><para>The property provides width of video frames provided by the reader, which differs
+				/// from width of video frames stored in the file if <see cref="OutputSize"/> or <see cref="CropRectangle"/>
+				/// is set.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				///
 				property int Width
@@ -146,6 +171,10 @@ namespace AForge
 				/// Frame height of the opened video file.
 				/// </summary>
 				///
+				/// <remarks><para>The property provides height of video frames provided by the reader, which differs
+				/// from height of video frames stored in the file if <see cref="OutputSize"/> or <see cref="CropRectangle"/>
+				/// is set.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				///
 				property int Height
@@ -177,7 +206,8 @@ namespace AForge
 				/// </summary>
 				///
 				/// <remarks><para><note><b>Warning</b>: some video file formats may report different value
-				/// from the actual number of video frames in the file (subject to fix/investigate).</note></para>
+				/// from the actual number of video frames in the file, unless index of video frames was already
+				/// built (see <see cref="UseIndexFile"/>).</note></para>
 				/// </remarks>
 				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
@@ -221,6 +251,223 @@ namespace AForge
 					}
 				}
 
+				/// <summary>
+				/// Number of threads used by the decoder.
+				/// </summary>
+				///
+				/// <remarks><para>Setting the property to <b>0</b> makes decoder to use as many threads
+				/// as there are processors in the system.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property int ThreadCount
+				{
+					int get()
+					{
+						return m_threadCount;
+					}
+					void set(int threadCount)
+					{
+						m_threadCount = System::Math::Max(0, threadCount);
+					}
+				}
+
+				/// <summary>
+				/// Multithreading method used by the decoder.
+				/// </summary>
+				///
+				/// <remarks><para>Frame threading makes decoding of all common codecs scale with number of
+				/// threads, but reading the first frame (and the first frame after seeking) takes longer,
+				/// since the decoder needs as many frames in flight as it has threads.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="VideoThreadingMode::Frame"/>.</para>
+				/// </remarks>
+				///
+				property VideoThreadingMode ThreadingMode
+				{
+					VideoThreadingMode get()
+					{
+						return m_threadingMode;
+					}
+					void set(VideoThreadingMode threadingMode)
+					{
+						m_threadingMode = threadingMode;
+					}
+				}
+
+				/// <summary>
+				/// Presentation time of the last read video frame, relative to the start of the video stream.
+				/// </summary>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				///
+				property TimeSpan FrameTimestamp
+				{
+					TimeSpan get()
+					{
+						CheckIfVideoFileIsOpen();
+						return m_frameTimestamp;
+					}
+				}
+
+				/// <summary>
+				/// Keep index of video frames in a file next to the video file.
+				/// </summary>
+				///
+				/// <remarks><para>Reading video frame by its index with <see cref="ReadVideoFrame( int )"/> requires
+				/// an index of all video frames, which is built by reading all packets of the video stream (without decoding
+				/// them) on the first seek in the opened file. When the property is set to <see langword="true"/>, the index
+				/// is saved into a file with name of the video file followed by ".idx" extension and it is loaded from there
+				/// next time the video file is opened, so the index is built only once for each video file. The index file is
+				/// rebuilt when size or modification time of the video file changes. If the index file cannot be written,
+				/// the index is kept in memory only.</para>
+				///
+				/// <para>Index of video opened from a stream (see <see cref="Open( System::IO::Stream^ )"/>) is always
+				/// kept in memory only.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <see langword="true"/>.</para>
+				/// </remarks>
+				///
+				property bool UseIndexFile
+				{
+					bool get()
+					{
+						return m_useIndexFile;
+					}
+					void set(bool useIndexFile)
+					{
+						m_useIndexFile = useIndexFile;
+					}
+				}
+
+				/// <summary>
+				/// Size of buffer used for reading video from a stream, in bytes.
+				/// </summary>
+				///
+				/// <remarks><para>The property has effect only for video opened with <see cref="Open( System::IO::Stream^ )"/>.
+				/// Larger buffer means fewer calls to the stream, which may help with pipes and network streams.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( System::IO::Stream^ )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>65536</b>. Minimum value is <b>4096</b>.</para>
+				/// </remarks>
+				///
+				property int StreamBufferSize
+				{
+					int get()
+					{
+						return m_streamBufferSize;
+					}
+					void set(int streamBufferSize)
+					{
+						m_streamBufferSize = System::Math::Max(4096, streamBufferSize);
+					}
+				}
+
+				/// <summary>
+				/// Pixel format of video frames provided by <see cref="ReadDecodedFrame()"/>.
+				/// </summary>
+				///
+				/// <remarks><para>Analysis, which needs only luma of video frames, should use
+				/// <see cref="VideoPixelFormat::Gray8"/> format - the luma plane of the decoder is provided as it is for
+				/// all planar YUV video (most of video files), so no colour conversion is done at all. Other formats are
+				/// provided with no conversion if the decoder produces them, for example <see cref="VideoPixelFormat::Yuv420P"/>
+				/// for most of H.264/MPEG-4 files or <see cref="VideoPixelFormat::Bgra"/> for RGB files recorded losslessly.
+				/// In all other cases video frames are converted to the specified format.</para>
+				///
+				/// <para><note>The property does not affect methods returning <see cref="Bitmap"/> or
+				/// <see cref="UnmanagedImage"/>, which always provide 24 bpp color images.</note></para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="VideoPixelFormat::Bgr24"/>.</para>
+				/// </remarks>
+				///
+				property VideoPixelFormat OutputFormat
+				{
+					VideoPixelFormat get()
+					{
+						return m_outputFormat;
+					}
+					void set(VideoPixelFormat outputFormat)
+					{
+						m_outputFormat = outputFormat;
+					}
+				}
+
+				/// <summary>
+				/// Size of video frames provided by the reader.
+				/// </summary>
+				///
+				/// <remarks><para>Video frames (or their area specified by <see cref="CropRectangle"/>) are resized to
+				/// the specified size by the same conversion, which converts them to the output pixel format, so resizing
+				/// costs nearly nothing. Codecs supporting decoding at reduced resolution (like MJPEG) decode frames at the
+				/// smallest resolution, which is not smaller than the specified size, so reading video frames is much faster
+				/// when they are reduced at least twice.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="System::Drawing::Size::Empty"/>, which keeps size of video
+				/// frames (or of the cropped area).</para>
+				/// </remarks>
+				///
+				/// <exception cref="ArgumentOutOfRangeException">Width and height must be both positive or both zero.</exception>
+				///
+				property System::Drawing::Size OutputSize
+				{
+					System::Drawing::Size get()
+					{
+						return m_outputSize;
+					}
+					void set(System::Drawing::Size outputSize)
+					{
+						if ((outputSize.Width < 0) || (outputSize.Height < 0) ||
+							((outputSize.Width == 0) != (outputSize.Height == 0)))
+							throw gcnew ArgumentOutOfRangeException("value", "Width and height must be both positive or both zero.");
+						m_outputSize = outputSize;
+					}
+				}
+
+				/// <summary>
+				/// Area of video frames provided by the reader.
+				/// </summary>
+				///
+				/// <remarks><para>Only the specified area of video frames is converted to the output pixel format
+				/// (and resized to <see cref="OutputSize"/> if it is set). Cropping itself does not copy any memory.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open"/>. Opening a video file fails, if the rectangle does not lie
+				/// within video frames of the file.</note></para>
+				///
+				/// <para>Default value is set to <see cref="System::Drawing::Rectangle::Empty"/>, which means whole
+				/// video frames are provided.</para>
+				/// </remarks>
+				///
+				property System::Drawing::Rectangle CropRectangle
+				{
+					System::Drawing::Rectangle get()
+					{
+						return m_cropRectangle;
+					}
+					void set(System::Drawing::Rectangle cropRectangle)
+					{
+						m_cropRectangle = cropRectangle;
+					}
+				}
+
 				/// <summary>
 				/// The property specifies if a video file is opened or not by this instance of the class.
 				/// </summary>
@@ -255,10 +502,35 @@ namespace AForge
 				/// <param name="fileName">Video file name to open.</param>
 				///
 				/// <exception cref="System::IO::IOException">Cannot open video file with the specified name.</exception>
+				/// <exception cref="ArgumentException">Crop rectangle does not lie within video frames.</exception>
 				/// <exception cref="VideoException">A error occurred while opening the video file. See exception message.</exception>
 				///
 				void Open(String^ fileName);
 
+				/// <summary>
+				/// Open video from the specified stream.
+				/// </summary>
+				///
+				/// <param name="stream">Stream to read video from.</param>
+				///
+				/// <remarks><para>The method allows to read video from memory, pipes or containers of other
+				/// files without storing the video into a file first. Video is read starting from the current position of
+				/// the stream. Format of the video is detected from the data, so it must be a format, which can be
+				/// probed (most container formats are).</para>
+				///
+				/// <para>The stream is not closed by the reader, it must be kept open until the reader is closed.
+				/// Reading a video frame by its index with <see cref="ReadVideoFrame( int )"/> requires a seekable stream,
+				/// while reading frames in order works with any stream. Note that some formats, like MP4 files with
+				/// index at the end, cannot be opened from a stream, which does not support seeking.</para></remarks>
+				///
+				/// <exception cref="ArgumentNullException">The stream is not specified.</exception>
+				/// <exception cref="ArgumentException">The stream does not support reading.</exception>
+				/// <exception cref="System::IO::IOException">Cannot open video from the stream.</exception>
+				/// <exception cref="ArgumentException">Crop rectangle does not lie within video frames.</exception>
+				/// <exception cref="VideoException">A error occurred while opening the video. See exception message.</exception>
+				///
+				void Open(System::IO::Stream^ stream);
+
 				/// <summary>
 				/// Read next video frame of the currently opened video file.
 				/// </summary>
@@ -266,6 +538,10 @@ namespace AForge
 				/// <returns>Returns next video frame of the opened file or <see langword="null"/> if end of
 				/// file was reached. The returned video frame has 24 bpp color format.</returns>
 				/// 
+				/// <remarks><para>The returned video frame can be given back to the reader with
+				/// <see cref="ReturnVideoFrame( Bitmap^ )"/> once it is no longer needed, so its memory is reused
+				/// for further video frames.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
 				/// 
@@ -278,47 +554,234 @@ namespace AForge
 				/// Read the given video frame of the currently opened video file.
 				/// </summary>
 				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				///
 				/// <returns>Returns the desired frame of the opened file or <see langword="null"/> if end of
 				/// file was reached. The returned video frame has 24 bpp color format.</returns>
 				/// 
+				/// <remarks><para>Reading any other frame than the next one seeks to the key frame preceding the desired
+				/// frame and decodes frames from there, so it takes about the same time for any frame of the file. The
+				/// first seek in the opened file builds index of its video frames, unless the index was loaded from
+				/// the index file (see <see cref="UseIndexFile"/>). Files with no timestamps of video frames cannot be
+				/// indexed, so their frames are found by frame rate of the video stream.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
 				/// 
 				Bitmap^ ReadVideoFrame(int frameIndex)
 				{
-					return readVideoFrame(frameIndex, nullptr);
+					return readVideoFrame(frameIndex) ? DecodeVideoFrame(nullptr) : nullptr;
 				}
 
 				/// <summary>
-				/// Read next video frame of the currently opened video file.
+				/// Read next video frame of the currently opened video file into the specified image.
+				/// </summary>
+				/// 
+				/// <param name="output">Locked 24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <remarks><para>The image is left unchanged if end of file was reached. Use <see cref="TryReadVideoFrame( BitmapData^ )"/>
+				/// to find out if the video frame was read.</para></remarks>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				void ReadVideoFrame(BitmapData^ output)
+				{
+					TryReadVideoFrame(-1, output);
+				}
+
+				/// <summary>
+				/// Read the given video frame of the currently opened video file into the specified image.
+				/// </summary>
+				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				/// <param name="output">Locked 24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <remarks><para>The image is left unchanged if end of file was reached. Use <see cref="TryReadVideoFrame( int, BitmapData^ )"/>
+				/// to find out if the video frame was read.</para></remarks>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				void ReadVideoFrame(int frameIndex, BitmapData^ output)
+				{
+					TryReadVideoFrame(frameIndex, output);
+				}
+
+				/// <summary>
+				/// Read next video frame of the currently opened video file into the specified image.
+				/// </summary>
+				/// 
+				/// <param name="output">Locked 24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <returns>Returns <see langword="true"/> if the next video frame was read or <see langword="false"/>
+				/// if end of file was reached.</returns>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				bool TryReadVideoFrame(BitmapData^ output)
+				{
+					return TryReadVideoFrame(-1, output);
+				}
+
+				/// <summary>
+				/// Read the given video frame of the currently opened video file into the specified image.
+				/// </summary>
+				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				/// <param name="output">Locked 24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <returns>Returns <see langword="true"/> if the desired video frame was read or <see langword="false"/>
+				/// if end of file was reached.</returns>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				bool TryReadVideoFrame(int frameIndex, BitmapData^ output)
+				{
+					if (!readVideoFrame(frameIndex))
+						return false;
+
+					DecodeVideoFrame(output);
+					return true;
+				}
+
+				/// <summary>
+				/// Read next video frame of the currently opened video file into the specified unmanaged image.
+				/// </summary>
+				/// 
+				/// <param name="output">24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <returns>Returns <see langword="true"/> if the next video frame was read or <see langword="false"/>
+				/// if end of file was reached.</returns>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="ArgumentException">The image has different size than video frames or is not 24 bpp image.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				bool TryReadVideoFrame(UnmanagedImage^ output)
+				{
+					return TryReadVideoFrame(-1, output);
+				}
+
+				/// <summary>
+				/// Read the given video frame of the currently opened video file into the specified unmanaged image.
+				/// </summary>
+				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				/// <param name="output">24 bpp image of the video frame size to read the video frame into.</param>
+				///
+				/// <returns>Returns <see langword="true"/> if the desired video frame was read or <see langword="false"/>
+				/// if end of file was reached.</returns>
+				/// 
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="ArgumentException">The image has different size than video frames or is not 24 bpp image.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				bool TryReadVideoFrame(int frameIndex, UnmanagedImage^ output);
+
+				/// <summary>
+				/// Read next video frame of the currently opened video file as unmanaged image.
 				/// </summary>
 				/// 
 				/// <returns>Returns next video frame of the opened file or <see langword="null"/> if end of
 				/// file was reached. The returned video frame has 24 bpp color format.</returns>
 				/// 
+				/// <remarks><para>The returned image is taken from the pool of images given back with
+				/// <see cref="ReturnVideoFrame( UnmanagedImage^ )"/>, so reading frames does not allocate any memory
+				/// once images are returned after processing. Decoded frames are never passed through GDI+.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
 				/// 
-				void ReadVideoFrame(BitmapData^ output)
+				UnmanagedImage^ ReadUnmanagedVideoFrame()
 				{
-					readVideoFrame(-1, output);
+					return ReadUnmanagedVideoFrame(-1);
 				}
 
 				/// <summary>
-				/// Read the given video frame of the currently opened video file.
+				/// Read the given video frame of the currently opened video file as unmanaged image.
 				/// </summary>
 				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				///
 				/// <returns>Returns the desired frame of the opened file or <see langword="null"/> if end of
 				/// file was reached. The returned video frame has 24 bpp color format.</returns>
 				/// 
+				/// <remarks><para>The returned image is taken from the pool of images given back with
+				/// <see cref="ReturnVideoFrame( UnmanagedImage^ )"/>.</para></remarks>
+				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
 				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
 				/// 
-				void ReadVideoFrame(int frameIndex, BitmapData^ output)
+				UnmanagedImage^ ReadUnmanagedVideoFrame(int frameIndex);
+
+				/// <summary>
+				/// Give video frame back to the reader, so its memory is reused for further video frames.
+				/// </summary>
+				/// 
+				/// <param name="frame">Video frame returned by <see cref="ReadVideoFrame()"/>, which is no longer needed.</param>
+				///
+				/// <remarks><para>Video frames read by <see cref="ReadVideoFrame()"/> are taken from a pool of returned
+				/// frames, so reading frames does not allocate any memory once frames are returned after processing. The frame
+				/// must not be used after it was returned. Frames, which cannot be reused (no video file is open or the frame
+				/// does not match the opened file) are disposed.</para>
+				///
+				/// <para><note>The method can be called from any thread.</note></para>
+				/// </remarks>
+				///
+				void ReturnVideoFrame(Bitmap^ frame);
+
+				/// <summary>
+				/// Give video frame back to the reader, so its memory is reused for further video frames.
+				/// </summary>
+				/// 
+				/// <param name="frame">Video frame returned by <see cref="ReadUnmanagedVideoFrame()"/>, which is no longer needed.</param>
+				///
+				/// <remarks><para>The frame must not be used after it was returned. Frames, which cannot be reused (no video
+				/// file is open or the frame does not match the opened file) are disposed.</para>
+				///
+				/// <para><note>The method can be called from any thread.</note></para>
+				/// </remarks>
+				///
+				void ReturnVideoFrame(UnmanagedImage^ frame);
+
+				/// <summary>
+				/// Read next video frame of the currently opened video file, providing direct access to its planes.
+				/// </summary>
+				/// 
+				/// <returns>Returns next video frame of the opened file in <see cref="OutputFormat">output format</see>
+				/// or <see langword="null"/> if end of file was reached.</returns>
+				/// 
+				/// <remarks><para>The video frame is checked out of the reader until it is disposed, after that
+				/// it is reused for further video frames. Planes of the frame may be memory of the decoder, so frames
+				/// should be disposed as soon as they are processed.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				DecodedVideoFrame^ ReadDecodedFrame()
 				{
-					readVideoFrame(frameIndex, output);
+					return ReadDecodedFrame(-1);
 				}
 
+				/// <summary>
+				/// Read the given video frame of the currently opened video file, providing direct access to its planes.
+				/// </summary>
+				/// 
+				/// <param name="frameIndex">Index of the video frame in presentation order, starting from 0.</param>
+				///
+				/// <returns>Returns the desired frame of the opened file in <see cref="OutputFormat">output format</see>
+				/// or <see langword="null"/> if end of file was reached.</returns>
+				/// 
+				/// <remarks><para>The video frame is checked out of the reader until it is disposed.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="VideoException">A error occurred while reading next video frame. See exception message.</exception>
+				/// 
+				DecodedVideoFrame^ ReadDecodedFrame(int frameIndex);
+
 				/// <summary>
 				/// Close currently opened video file if any.
 				/// </summary>
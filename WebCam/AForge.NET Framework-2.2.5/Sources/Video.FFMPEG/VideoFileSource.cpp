@@ -2,7 +2,7 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2011
+// Copyright © AForge.NET, 2009-2011
 // contacts@aforgenet.com
 //
 
@@ -10,12 +10,221 @@
 #include "VideoFileSource.h"
 #include "VideoFileReader.h"
 
+using namespace System::Diagnostics;
+
 namespace AForge
 {
 	namespace Video
 	{
 		namespace FFMPEG
 		{
+			// Video frame decoded ahead of its presentation, the bitmap and event arguments are
+			// created once and share memory of the unmanaged image
+			ref struct QueuedFrame
+			{
+			public:
+				UnmanagedImage^ Image;
+				Bitmap^ ManagedImage;
+				NewFrameEventArgs^ BitmapEventArgs;
+				NewUnmanagedFrameEventArgs^ ImageEventArgs;
+				TimeSpan Timestamp;
+			};
+
+			// Bounded queue of video frames, which are decoded on a separate thread ahead of their presentation.
+			// Images of the frames are allocated once and reused for the whole video file, so no memory is
+			// allocated per frame.
+			ref class FrameQueue
+			{
+				VideoFileReader^ reader;
+				Thread^ thread;
+				Object^ sync;
+
+				// ring of frames - the first one is being presented, the rest are waiting for presentation
+				array<QueuedFrame^>^ frames;
+				int head;
+				int count;
+
+				bool stopping;
+				bool finished;
+				Exception^ error;
+
+			public:
+				FrameQueue(VideoFileReader^ reader, int capacity)
+				{
+					this->reader = reader;
+					sync = gcnew Object();
+					head = 0;
+					count = 0;
+					stopping = false;
+					finished = false;
+					error = nullptr;
+
+					frames = gcnew array<QueuedFrame^>(capacity);
+					for (int i = 0; i < capacity; i++)
+					{
+						QueuedFrame^ frame = gcnew QueuedFrame();
+						frame->Image = UnmanagedImage::Create(reader->Width, reader->Height, PixelFormat::Format24bppRgb);
+						frame->ManagedImage = gcnew Bitmap(frame->Image->Width, frame->Image->Height,
+							frame->Image->Stride, PixelFormat::Format24bppRgb, frame->Image->ImageData);
+						frame->BitmapEventArgs = gcnew NewFrameEventArgs(frame->ManagedImage);
+						frame->ImageEventArgs = gcnew NewUnmanagedFrameEventArgs(frame->Image);
+						frames[i] = frame;
+					}
+				}
+
+				// Error, which stopped decoding, if any
+				property Exception^ Error
+				{
+					Exception^ get()
+					{
+						return error;
+					}
+				}
+
+				// Checks if all decoded frames were taken and no more frames will come
+				property bool IsFinished
+				{
+					bool get()
+					{
+						Monitor::Enter(sync);
+						try
+						{
+							return (finished) && (count == 0);
+						}
+						finally
+						{
+							Monitor::Exit(sync);
+						}
+					}
+				}
+
+				// Starts decoding thread
+				void Start()
+				{
+					thread = gcnew Thread(gcnew ThreadStart(this, &FrameQueue::DecoderThreadHandler));
+					thread->Name = "Video decoder";
+					thread->Start();
+				}
+
+				// Stops decoding thread and releases images of frames
+				void Stop()
+				{
+					Monitor::Enter(sync);
+					try
+					{
+						stopping = true;
+						Monitor::PulseAll(sync);
+					}
+					finally
+					{
+						Monitor::Exit(sync);
+					}
+
+					if (thread != nullptr)
+					{
+						thread->Join();
+						thread = nullptr;
+					}
+
+					for (int i = 0; i < frames->Length; i++)
+					{
+						delete frames[i]->ManagedImage;
+						delete frames[i]->Image;
+					}
+				}
+
+				// Gets the next decoded frame, returns nullptr if the frame is not decoded within the specified timeout
+				QueuedFrame^ Peek(int timeout)
+				{
+					Monitor::Enter(sync);
+					try
+					{
+						if ((count == 0) && (!finished))
+							Monitor::Wait(sync, timeout);
+
+						return (count == 0) ? nullptr : frames[head];
+					}
+					finally
+					{
+						Monitor::Exit(sync);
+					}
+				}
+
+				// Returns the presented frame back to decoder
+				void Release()
+				{
+					Monitor::Enter(sync);
+					try
+					{
+						head = (head + 1) % frames->Length;
+						count--;
+						Monitor::PulseAll(sync);
+					}
+					finally
+					{
+						Monitor::Exit(sync);
+					}
+				}
+
+			private:
+				void DecoderThreadHandler()
+				{
+					try
+					{
+						while (true)
+						{
+							QueuedFrame^ frame = nullptr;
+
+							// wait for a free frame
+							Monitor::Enter(sync);
+							try
+							{
+								while ((count == frames->Length) && (!stopping))
+									Monitor::Wait(sync);
+
+								if (stopping)
+									return;
+
+								frame = frames[(head + count) % frames->Length];
+							}
+							finally
+							{
+								Monitor::Exit(sync);
+							}
+
+							bool decoded = reader->TryReadVideoFrame(frame->Image);
+
+							if (decoded)
+								frame->Timestamp = reader->FrameTimestamp;
+
+							Monitor::Enter(sync);
+							try
+							{
+								if (decoded)
+									count++;
+								else
+									finished = true;
+								Monitor::PulseAll(sync);
+							}
+							finally
+							{
+								Monitor::Exit(sync);
+							}
+
+							if (!decoded)
+								return;
+						}
+					}
+					catch (Exception^ exception)
+					{
+						Monitor::Enter(sync);
+						error = exception;
+						finished = true;
+						Monitor::PulseAll(sync);
+						Monitor::Exit(sync);
+					}
+				}
+			};
 
 			VideoFileSource::VideoFileSource(String^ fileName)
 			{
@@ -25,6 +234,10 @@ namespace AForge
 
 				m_frameIntervalFromSource = true;
 				m_frameInterval = 0;
+
+				m_playbackMode = VideoPlaybackMode::FrameInterval;
+				m_playbackSpeed = 1.0;
+				m_queueSize = 4;
 			}
 
 			void VideoFileSource::Start()
@@ -90,6 +303,7 @@ namespace AForge
 			{
 				ReasonToFinishPlaying reasonToStop = ReasonToFinishPlaying::StoppedByUser;
 				VideoFileReader^ videoReader = gcnew VideoFileReader();
+				FrameQueue^ queue = nullptr;
 
 				try
 				{
@@ -100,48 +314,95 @@ namespace AForge
 						? (int)(1000 / ((videoReader->FrameRate == 0) ? 25 : videoReader->FrameRate))
 						: m_frameInterval;
 
+					VideoPlaybackMode mode = m_playbackMode;
+					double speed = m_playbackSpeed;
+
+					// one more frame than queue size, since the presented frame is kept in the queue
+					queue = gcnew FrameQueue(videoReader, m_queueSize + 1);
+					queue->Start();
+
+					// frames are presented at fixed points of high resolution clock, so time spent on
+					// decoding and processing of frames does not accumulate into playback drift
+					Stopwatch^ clock = Stopwatch::StartNew();
+					Int64 startTicks = 0;
+					TimeSpan startTimestamp = TimeSpan::Zero;
+					TimeSpan lastTimestamp = TimeSpan::Zero;
+					Int64 lastDueTicks = 0;
+					bool first = true;
+
 					while (!m_needToStop->WaitOne(0, false))
 					{
-						// start time
-						DateTime start = DateTime::Now;
-
 						// get next video frame
-						Bitmap^ bitmap = videoReader->ReadVideoFrame();
+						QueuedFrame^ frame = queue->Peek(100);
 
-						if (bitmap == nullptr)
+						if (frame == nullptr)
 						{
-							reasonToStop = ReasonToFinishPlaying::EndOfStreamReached;
-							break;
+							if (queue->Error != nullptr)
+								throw queue->Error;
+
+							if (queue->IsFinished)
+							{
+								reasonToStop = ReasonToFinishPlaying::EndOfStreamReached;
+								break;
+							}
+							continue;
 						}
 
-						m_framesReceived++;
-						m_bytessReceived += bitmap->Width * bitmap->Height *
-							(Bitmap::GetPixelFormatSize(bitmap->PixelFormat) >> 3);
+						// time when the frame should be presented
+						Int64 nowTicks = clock->Elapsed.Ticks;
+						Int64 dueTicks = nowTicks;
 
-						// notify clients about the new video frame
-						NewFrame(this, gcnew NewFrameEventArgs(bitmap));
+						if (mode == VideoPlaybackMode::Realtime)
+						{
+							// start over if timestamps go back, so playback does not stall
+							if ((first) || (frame->Timestamp < lastTimestamp))
+							{
+								startTicks = nowTicks;
+								startTimestamp = frame->Timestamp;
+							}
+							dueTicks = startTicks + (Int64)((frame->Timestamp - startTimestamp).Ticks / speed);
+						}
+						else if ((mode == VideoPlaybackMode::FrameInterval) && (!first))
+						{
+							// frames follow due time of the previous one, the schedule starts
+							// over only if it is more than a frame interval late
+							Int64 intervalTicks = (Int64)(interval * TimeSpan::TicksPerMillisecond / speed);
 
-						// dispose the frame since we no longer need it
-						delete bitmap;
+							dueTicks = lastDueTicks + intervalTicks;
+							if (nowTicks - dueTicks > intervalTicks)
+								dueTicks = nowTicks;
+						}
 
-						// wait for a while ?
-						if (interval > 0)
-						{
-							// get frame extract duration
-							TimeSpan^ span = DateTime::Now.Subtract(start);
+						if ((dueTicks > nowTicks) && (m_needToStop->WaitOne(TimeSpan::FromTicks(dueTicks - nowTicks), false) == true))
+							break;
 
-							// miliseconds to sleep
-							int msec = interval - (int)span->TotalMilliseconds;
+						first = false;
+						lastTimestamp = frame->Timestamp;
+						lastDueTicks = dueTicks;
 
-							if ((msec > 0) && (m_needToStop->WaitOne(msec, false) == true))
-								break;
-						}
+						UnmanagedImage^ image = frame->Image;
+
+						m_framesReceived++;
+						m_bytessReceived += image->Width * image->Height *
+							(Bitmap::GetPixelFormatSize(image->PixelFormat) >> 3);
+
+						// notify clients about the new video frame
+						NewUnmanagedFrame(this, frame->ImageEventArgs);
+						NewFrame(this, frame->BitmapEventArgs);
+
+						// give the frame back to decoder, since clients no longer need it
+						queue->Release();
 					}
 				}
 				catch (Exception^ exception)
 				{
 					VideoSourceError(this, gcnew VideoSourceErrorEventArgs(exception->Message));
 				}
+				finally
+				{
+					if (queue != nullptr)
+						queue->Stop();
+				}
 
 				videoReader->Close();
 				PlayingFinished(this, reasonToStop);
@@ -2,17 +2,21 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2011
+// Copyright © AForge.NET, 2009-2011
 // contacts@aforgenet.com
 //
 
 #pragma once
 
+#include "VideoPlaybackMode.h"
+#include "NewUnmanagedFrameEventArgs.h"
+
 using namespace System;
 using namespace System::Drawing;
 using namespace System::Drawing::Imaging;
 using namespace System::Threading;
 using namespace AForge::Video;
+using namespace AForge::Imaging;
 
 namespace AForge
 {
@@ -28,9 +32,11 @@ namespace AForge
 			///
 			/// <para><note>The class provides video only. Sound is not supported.</note></para>
 			/// 
-			/// <para><note>The class ignores presentation time of video frames while retrieving them from
-			/// video file. Instead it provides video frames according to the FPS rate of the video file
-			/// or the configured <see cref="FrameInterval"/>.</note></para>
+			/// <para>Video frames are decoded on a separate thread ahead of their presentation (see <see cref="QueueSize"/>),
+			/// so time spent on decoding does not delay frames provided to clients. By default the class ignores
+			/// presentation time of video frames and provides them according to the FPS rate of the video file
+			/// or the configured <see cref="FrameInterval"/>. Other ways of pacing video frames can be selected with
+			/// <see cref="PlaybackMode"/> property.</para>
 			/// 
 			/// <para><note>Make sure you have <b>FFmpeg</b> binaries (DLLs) in the output folder of your application in order
 			/// to use this class successfully. <b>FFmpeg</b> binaries can be found in Externals folder provided with AForge.NET
@@ -67,6 +73,10 @@ namespace AForge
 				bool m_frameIntervalFromSource;
 				int  m_frameInterval;
 
+				VideoPlaybackMode m_playbackMode;
+				double m_playbackSpeed;
+				int  m_queueSize;
+
 				void Free();
 				void WorkerThreadHandler();
 
@@ -79,12 +89,31 @@ namespace AForge
 				/// <remarks><para>Notifies clients about new available frame from video source.</para>
 				/// 
 				/// <para><note>Since video source may have multiple clients, each client is responsible for
-				/// making a copy (cloning) of the passed video frame, because the video source disposes its
-				/// own original copy after notifying of clients.</note></para>
+				/// making a copy (cloning) of the passed video frame, because the video source reuses its
+				/// own original copy for decoding of further video frames after notifying of clients.</note></para>
+				///
+				/// <para>The passed bitmap shares memory with the image passed to <see cref="NewUnmanagedFrame"/>
+				/// event, which is fired first.</para>
 				/// </remarks>
 				/// 
 				virtual event NewFrameEventHandler^ NewFrame;
 
+				/// <summary>
+				/// New unmanaged frame event.
+				/// </summary>
+				/// 
+				/// <remarks><para>Notifies clients about new available frame from video source, providing it as
+				/// unmanaged image, which can be processed by image processing routines without locking it. Video
+				/// frames are decoded straight into unmanaged memory, which is allocated once when video source is
+				/// started, so playing video does not allocate any memory per frame.</para>
+				/// 
+				/// <para><note>Each client is responsible for making a copy (cloning) of the passed video frame,
+				/// if it needs the frame after returning from event handler, because the video source reuses the
+				/// frame for decoding of further video frames.</note></para>
+				/// </remarks>
+				/// 
+				event NewUnmanagedFrameEventHandler^ NewUnmanagedFrame;
+
 				/// <summary>
 				/// Video source error event.
 				/// </summary>
@@ -230,6 +259,90 @@ namespace AForge
 					}
 				}
 
+				/// <summary>
+				/// Method of pacing video frames.
+				/// </summary>
+				/// 
+				/// <remarks><para>The property specifies when video frames are provided to clients. They can be provided
+				/// with fixed <see cref="FrameInterval">frame interval</see>, according to their presentation time in
+				/// the video file or as fast as possible, which is useful for processing of recorded video. In the first
+				/// two modes playback speed can be changed with <see cref="PlaybackSpeed"/> property.</para>
+				///
+				/// <para><note>The property is taken into account when video source is started, so it
+				/// must be set before calling <see cref="Start"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="VideoPlaybackMode::FrameInterval"/>.</para>
+				/// </remarks>
+				/// 
+				property VideoPlaybackMode PlaybackMode
+				{
+					VideoPlaybackMode get()
+					{
+						return m_playbackMode;
+					}
+					void set(VideoPlaybackMode playbackMode)
+					{
+						m_playbackMode = playbackMode;
+					}
+				}
+
+				/// <summary>
+				/// Playback speed relative to normal speed of the video.
+				/// </summary>
+				/// 
+				/// <remarks><para>Setting the property to 10 makes video to play 10 times faster, setting it to 0.5 makes
+				/// video to play at half of the normal speed. If clients process frames slower than required, video is played
+				/// as fast as they can process it.</para>
+				///
+				/// <para><note>The property has no effect when <see cref="PlaybackMode"/> is set to
+				/// <see cref="VideoPlaybackMode::AsFastAsPossible"/>. It is taken into account when video source is
+				/// started, so it must be set before calling <see cref="Start"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>1</b>.</para>
+				/// </remarks>
+				/// 
+				/// <exception cref="ArgumentOutOfRangeException">Playback speed must be greater than zero.</exception>
+				///
+				property double PlaybackSpeed
+				{
+					double get()
+					{
+						return m_playbackSpeed;
+					}
+					void set(double playbackSpeed)
+					{
+						if (!(playbackSpeed > 0))
+							throw gcnew ArgumentOutOfRangeException("value", "Playback speed must be greater than zero.");
+						m_playbackSpeed = playbackSpeed;
+					}
+				}
+
+				/// <summary>
+				/// Number of video frames decoded ahead of their presentation.
+				/// </summary>
+				/// 
+				/// <remarks><para>Video frames are decoded on a separate thread into a queue of the specified size, which
+				/// absorbs variations of decoding time. Memory for the frames is allocated once, when video source is started,
+				/// and reused for the whole video file.</para>
+				///
+				/// <para><note>The property is taken into account when video source is started, so it
+				/// must be set before calling <see cref="Start"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>4</b>.</para>
+				/// </remarks>
+				/// 
+				property int QueueSize
+				{
+					int get()
+					{
+						return m_queueSize;
+					}
+					void set(int queueSize)
+					{
+						m_queueSize = System::Math::Max(1, queueSize);
+					}
+				}
+
 
 				/// <summary>
 				/// Initializes a new instance of the <see cref="VideoFileSource"/> class.
@@ -2,7 +2,7 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2012
+// Copyright © AForge.NET, 2009-2012
 // contacts@aforgenet.com
 //
 
@@ -17,6 +17,8 @@ namespace libffmpeg
 	{
 #include "libavutil\avutil.h"
 #include "libavutil\imgutils.h"
+#include "libavutil\dict.h"
+#include "libavutil\opt.h"
 #include "libavformat\avformat.h"
 #include "libavformat\avio.h"
 #include "libavcodec\avcodec.h"
@@ -32,60 +34,1117 @@ namespace AForge
 		{
 #pragma region Private methods
 
+			ref class SegmentFile;
+			ref class StreamOutput;
+			ref class FileFlusher;
+
+			// Header of encoded packet kept in pre-trigger buffer, packet data follow it
+			struct BufferedPacket
+			{
+				int64_t Pts;
+				int64_t Dts;
+				int64_t Duration;
+				int Flags;
+				int Size;
+			};
+
+			// Ring of encoded packets kept in preallocated memory, which always starts with a key frame
+			struct PacketRing
+			{
+				uint8_t* Buffer;
+				int64_t Capacity;
+				int64_t Head;		// offset of the oldest packet
+				int64_t Tail;		// offset of the next packet
+				int64_t End;		// end of the packets at the end of the buffer, when the ring has wrapped
+				bool Wrapped;
+				int Count;
+				int64_t Window;		// duration of video to keep, in time base units
+				libffmpeg::AVPacket* Packet;
+			};
+
 			// A structure to encapsulate all FFMPEG related private variable
 			ref struct WriterPrivateData
 			{
 			public:
+				libffmpeg::AVOutputFormat*		OutputFormat;
 				libffmpeg::AVFormatContext*		FormatContext;
 				libffmpeg::AVStream*			VideoStream;
+				libffmpeg::AVCodecContext*		CodecContext;
+				libffmpeg::AVCodecParameters*	CodecParameters;
 				libffmpeg::AVFrame*				VideoFrame;
-				libffmpeg::SwsContext*			ConvertContext;
-				libffmpeg::SwsContext*			ConvertContextGrayscale;
-
-				uint8_t*	VideoOutputBuffer;
-				int VideoOutputBufferSize;
+				libffmpeg::AVFrame*				InputFrame;
+				libffmpeg::SwsContext**			ConvertContexts;
+				int								ConvertFlags;
+				libffmpeg::AVPacket*			Packet;
+				bool							Passthrough;
+				int64_t							LastPts;
+
+				// asynchronous encoding queue - ring of preallocated source frames
+				libffmpeg::AVFrame**	QueueFrames;
+				libffmpeg::AVFrame*		QueueWorkFrame;
+				int QueueCapacity;
+				int QueueHead;
+				int QueueCount;
+				bool QueueBusy;
+				bool QueueStop;
+				Object^ QueueSync;
+				Thread^ EncoderThread;
+				Exception^ EncoderError;
+
+				// video stream parameters, which are needed to create each segment of the video file
+				Rational TimeBase;
+				Rational FrameRate;
+
+				// segmented recording - the next segment is opened in advance,
+				// the previous ones are finished in background
+				String^ FileName;
+				int64_t SegmentDuration;
+				int64_t SegmentSize;
+				int SegmentCount;
+				int SegmentIndex;
+				SegmentFile^ NextSegment;
+				SegmentFile^ ClosingSegment;
+
+				// streams written through custom I/O context instead of the video file
+				StreamOutput^ Output;
+				System::Runtime::InteropServices::GCHandle OutputHandle;
+				int StreamBufferSize;
+
+				// options of the muxer given to each output file
+				libffmpeg::AVDictionary* MuxerOptions;
+
+				// periodic flushing of the video file to disk
+				FileFlusher^ Flusher;
+
+				// first packet written into each output file gets zero time
+				bool ResetTimestamps;
+				int64_t OutputStartDts;
+
+				// pre-trigger buffer, keeping encoded packets until recording is triggered
+				PacketRing* PreTrigger;
+				int Triggered;
 
 				WriterPrivateData()
 				{
+					OutputFormat = nullptr;
 					FormatContext = nullptr;
 					VideoStream = nullptr;
+					CodecContext = nullptr;
+					CodecParameters = nullptr;
 					VideoFrame = nullptr;
-					ConvertContext = nullptr;
-					ConvertContextGrayscale = nullptr;
-					VideoOutputBuffer = nullptr;
+					InputFrame = nullptr;
+					ConvertContexts = nullptr;
+					ConvertFlags = SWS_BICUBIC;
+					Packet = nullptr;
+					Passthrough = false;
+					LastPts = -1;
+
+					QueueFrames = nullptr;
+					QueueWorkFrame = nullptr;
+					QueueCapacity = 0;
+					QueueHead = 0;
+					QueueCount = 0;
+					QueueBusy = false;
+					QueueStop = false;
+					QueueSync = gcnew Object();
+					EncoderThread = nullptr;
+					EncoderError = nullptr;
+
+					FileName = nullptr;
+					SegmentDuration = 0;
+					SegmentSize = 0;
+					SegmentCount = 0;
+					SegmentIndex = 0;
+					NextSegment = nullptr;
+					ClosingSegment = nullptr;
+
+					Output = nullptr;
+					StreamBufferSize = 0;
+
+					MuxerOptions = nullptr;
+					Flusher = nullptr;
+
+					ResetTimestamps = false;
+					OutputStartDts = AV_NOPTS_VALUE;
+
+					PreTrigger = nullptr;
+					Triggered = 0;
 				}
 			};
 
-			// Writes video frame to opened video file
-			void write_video_frame(WriterPrivateData^ data)
+			// Gets description of FFMPEG error code
+			static String^ get_error_message(int err)
 			{
-				libffmpeg::AVCodecContext* codecContext = data->VideoStream->codec;
+				char buff[AV_ERROR_MAX_STRING_SIZE];
+				libffmpeg::av_make_error_string(&buff[0], AV_ERROR_MAX_STRING_SIZE, err);
+				return System::Runtime::InteropServices::Marshal::PtrToStringAnsi((IntPtr)&buff[0]);
+			}
 
-				libffmpeg::AVPacket* packet = libffmpeg::av_packet_alloc();
-				packet->data = nullptr;
-				packet->size = 0;
-				libffmpeg::av_new_packet(packet, packet->size);
+			// Converts file name to UTF-8 string, which must be released with delete[]
+			static char* get_native_file_name(String^ fileName)
+			{
+				IntPtr ptr = System::Runtime::InteropServices::Marshal::StringToHGlobalUni(fileName);
+				wchar_t* nativeFileNameUnicode = (wchar_t*)ptr.ToPointer();
+				int utf8StringSize = WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, NULL, 0, NULL, NULL);
+				char* nativeFileName = new char[utf8StringSize];
+				WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, nativeFileName, utf8StringSize, NULL, NULL);
+				System::Runtime::InteropServices::Marshal::FreeHGlobal(ptr);
+				return nativeFileName;
+			}
 
-				// encode the image
-				if (libffmpeg::avcodec_send_frame(codecContext, data->VideoFrame) < 0)
-					throw gcnew VideoException("Error sending a frame for encoding");
+			// Gets file name of the segment - its index is put between name and extension of the video file
+			static String^ get_segment_file_name(String^ fileName, int index)
+			{
+				return System::IO::Path::Combine(System::IO::Path::GetDirectoryName(fileName),
+					System::IO::Path::GetFileNameWithoutExtension(fileName) + "_" + index.ToString("D4") +
+					System::IO::Path::GetExtension(fileName));
+			}
+
+			// Streams written by FFmpeg through custom I/O context - all of them get the same data,
+			// positions reported to FFmpeg are relative to positions of the streams at the time they were opened
+			ref class StreamOutput
+			{
+			public:
+				array<System::IO::Stream^>^ Streams;
+				array<Int64>^ Origins;
+				array<Byte>^ Buffer;
+
+				StreamOutput(array<System::IO::Stream^>^ streams)
+				{
+					Streams = (array<System::IO::Stream^>^) streams->Clone();
+					Origins = gcnew array<Int64>(streams->Length);
+					Buffer = gcnew array<Byte>(0);
+
+					for (int i = 0; i < streams->Length; i++)
+						Origins[i] = (streams[i]->CanSeek) ? streams[i]->Position : 0;
+				}
 
-				if (libffmpeg::avcodec_receive_packet(codecContext, packet) < 0)
+				// Checks if all the streams support seeking
+				bool CanSeek()
+				{
+					for (int i = 0; i < Streams->Length; i++)
+					{
+						if (!Streams[i]->CanSeek)
+							return false;
+					}
+					return true;
+				}
+
+				// Flushes the streams, which are still written
+				void Flush()
+				{
+					for (int i = 0; i < Streams->Length; i++)
+					{
+						if (Streams[i] == nullptr)
+							continue;
+
+						try
+						{
+							Streams[i]->Flush();
+						}
+						catch (Exception^)
+						{
+							Streams[i] = nullptr;
+						}
+					}
+				}
+			};
+
+			static StreamOutput^ get_stream_output(void* opaque)
+			{
+				return (StreamOutput^) System::Runtime::InteropServices::GCHandle::FromIntPtr(IntPtr(opaque)).Target;
+			}
+
+			// Callback writing data of custom I/O context into all the streams. A stream, which fails, is not
+			// written any more (like a disconnected network client), writing fails only if all streams failed.
+			static int write_stream(void* opaque, uint8_t* buffer, int size)
+			{
+				StreamOutput^ output = get_stream_output(opaque);
+				int written = 0;
+
+				if (output->Buffer->Length < size)
+					output->Buffer = gcnew array<Byte>(size);
+
+				System::Runtime::InteropServices::Marshal::Copy(IntPtr(buffer), output->Buffer, 0, size);
+
+				for (int i = 0; i < output->Streams->Length; i++)
+				{
+					if (output->Streams[i] == nullptr)
+						continue;
+
+					try
+					{
+						output->Streams[i]->Write(output->Buffer, 0, size);
+						written++;
+					}
+					catch (Exception^)
+					{
+						output->Streams[i] = nullptr;
+					}
+				}
+
+				return (written != 0) ? size : AVERROR(EIO);
+			}
+
+			// Callback seeking custom I/O context, it is only used if all streams support seeking
+			static int64_t seek_stream(void* opaque, int64_t offset, int whence)
+			{
+				StreamOutput^ output = get_stream_output(opaque);
+				int64_t position = AVERROR(EIO);
+
+				for (int i = 0; i < output->Streams->Length; i++)
+				{
+					System::IO::Stream^ stream = output->Streams[i];
+					if (stream == nullptr)
+						continue;
+
+					try
+					{
+						if ((whence & AVSEEK_SIZE) != 0)
+							return stream->Length - output->Origins[i];
+
+						switch (whence & ~AVSEEK_FORCE)
+						{
+						case SEEK_SET:
+							position = stream->Seek(output->Origins[i] + offset, System::IO::SeekOrigin::Begin);
+							break;
+						case SEEK_CUR:
+							position = stream->Seek(offset, System::IO::SeekOrigin::Current);
+							break;
+						case SEEK_END:
+							position = stream->Seek(offset, System::IO::SeekOrigin::End);
+							break;
+						default:
+							return AVERROR(EINVAL);
+						}
+
+						position -= output->Origins[i];
+					}
+					catch (Exception^)
+					{
+						output->Streams[i] = nullptr;
+					}
+				}
+
+				return position;
+			}
+
+			// Creates custom I/O context writing into streams of the video file
+			static libffmpeg::AVIOContext* open_stream_output(WriterPrivateData^ data)
+			{
+				// the buffer is owned by the I/O context from now on, FFmpeg may reallocate it
+				unsigned char* buffer = (unsigned char*) libffmpeg::av_malloc(data->StreamBufferSize);
+				if (buffer == nullptr)
+					throw gcnew VideoException("Cannot allocate stream buffer.");
+
+				libffmpeg::AVIOContext* ioContext = libffmpeg::avio_alloc_context(buffer, data->StreamBufferSize, 1,
+					System::Runtime::InteropServices::GCHandle::ToIntPtr(data->OutputHandle).ToPointer(),
+					nullptr, &write_stream, (data->Output->CanSeek()) ? &seek_stream : nullptr);
+
+				if (ioContext == nullptr)
+				{
+					libffmpeg::av_free(buffer);
+					throw gcnew VideoException("Cannot allocate stream I/O context.");
+				}
+
+				return ioContext;
+			}
+
+			// Closes I/O context of the output file, custom I/O context is flushed and freed leaving the streams open
+			static void close_output_io(libffmpeg::AVFormatContext* formatContext)
+			{
+				if (formatContext->pb == nullptr)
 					return;
 
-				if (packet->pts != AV_NOPTS_VALUE)
-					packet->pts = libffmpeg::av_rescale_q(packet->pts, codecContext->time_base, data->VideoStream->time_base);
-				if (packet->dts != AV_NOPTS_VALUE)
-					packet->dts = libffmpeg::av_rescale_q(packet->dts, codecContext->time_base, data->VideoStream->time_base);
+				if (formatContext->flags & AVFMT_FLAG_CUSTOM_IO)
+				{
+					libffmpeg::AVIOContext* ioContext = formatContext->pb;
+					libffmpeg::avio_flush(ioContext);
+					libffmpeg::av_freep(&ioContext->buffer);
+					libffmpeg::avio_context_free(&ioContext);
+					formatContext->pb = nullptr;
+				}
+				else
+				{
+					libffmpeg::avio_closep(&formatContext->pb);
+				}
+			}
+
+			// Creates output file with the video stream and writes its header
+			static libffmpeg::AVFormatContext* open_output(WriterPrivateData^ data, String^ fileName)
+			{
+				libffmpeg::AVFormatContext* formatContext = libffmpeg::avformat_alloc_context();
+				if (!formatContext)
+					throw gcnew VideoException("Cannot allocate format context.");
+
+				formatContext->oformat = data->OutputFormat;
+
+				char* nativeFileName = (fileName != nullptr) ? get_native_file_name(fileName) : nullptr;
+				bool success = false;
+
+				try
+				{
+					libffmpeg::AVStream* stream = libffmpeg::avformat_new_stream(formatContext, nullptr);
+					if (!stream)
+						throw gcnew VideoException("Failed creating new video stream.");
+
+					if (libffmpeg::avcodec_parameters_copy(stream->codecpar, data->CodecParameters) < 0)
+						throw gcnew VideoException("Cannot copy codec parameters.");
+
+					// the time base is only a hint, muxer sets the final one when writing header
+					stream->time_base.num = data->TimeBase.Numerator;
+					stream->time_base.den = data->TimeBase.Denominator;
+					stream->avg_frame_rate.num = data->FrameRate.Numerator;
+					stream->avg_frame_rate.den = data->FrameRate.Denominator;
+
+					if ((stream->codecpar->codec_id == libffmpeg::AV_CODEC_ID_H264) ||
+						(stream->codecpar->codec_id == libffmpeg::AV_CODEC_ID_H265))
+					{
+						stream->need_parsing = libffmpeg::AVSTREAM_PARSE_FULL_ONCE;
+					}
+
+					// open output file or streams
+					if (data->Output != nullptr)
+					{
+						formatContext->pb = open_stream_output(data);
+						formatContext->flags |= AVFMT_FLAG_CUSTOM_IO;
+					}
+					else if (!(data->OutputFormat->flags & AVFMT_NOFILE))
+					{
+						int err = libffmpeg::avio_open(&formatContext->pb, nativeFileName, AVIO_FLAG_WRITE);
+
+						if (err < 0)
+						{
+							throw gcnew System::IO::IOException("Cannot open the video file. Error code: " + err +
+								". Message: " + get_error_message(err) + " when trying to access: " + fileName);
+						}
+					}
+
+					// the muxer takes options it knows from the dictionary, so each file gets its own copy
+					libffmpeg::AVDictionary* muxerOptions = nullptr;
+					libffmpeg::av_dict_copy(&muxerOptions, data->MuxerOptions, 0);
+
+					int ret = libffmpeg::avformat_write_header(formatContext, &muxerOptions);
+					libffmpeg::av_dict_free(&muxerOptions);
+
+					if (ret < 0)
+						throw gcnew VideoException("Cannot write header of the video file.");
 
+					success = true;
+				}
+				finally
+				{
+					delete[] nativeFileName;
+
+					if (!success)
+					{
+						close_output_io(formatContext);
+						libffmpeg::avformat_free_context(formatContext);
+					}
+				}
+
+				return formatContext;
+			}
+
+			// Writes trailer of the output file and closes it
+			static int close_output(libffmpeg::AVFormatContext* formatContext)
+			{
+				int ret = libffmpeg::av_write_trailer(formatContext);
+
+				close_output_io(formatContext);
+				libffmpeg::avformat_free_context(formatContext);
+				return ret;
+			}
+
+			// Segment of the video file, which is opened or finished in background
+			ref class SegmentFile
+			{
+			public:
+				WriterPrivateData^ Data;
+				int Index;
+				libffmpeg::AVFormatContext* FormatContext;
+				SegmentFile^ Previous;
+				ManualResetEvent^ Done;
+				Exception^ Error;
+
+				SegmentFile(WriterPrivateData^ data, int index, libffmpeg::AVFormatContext* formatContext)
+				{
+					Data = data;
+					Index = index;
+					FormatContext = formatContext;
+					Previous = nullptr;
+					Done = gcnew ManualResetEvent(false);
+					Error = nullptr;
+				}
+
+				// Creates the segment file
+				void OpenHandler(Object^ state)
+				{
+					try
+					{
+						FormatContext = open_output(Data, get_segment_file_name(Data->FileName, Index));
+					}
+					catch (Exception^ exception)
+					{
+						Error = exception;
+					}
+					finally
+					{
+						Done->Set();
+					}
+				}
+
+				// Finishes the segment file and deletes the oldest one, which is not kept any more
+				void CloseHandler(Object^ state)
+				{
+					try
+					{
+						// segments are finished in the order they were written, passing errors along
+						if (Previous != nullptr)
+						{
+							Previous->Done->WaitOne();
+							Error = Previous->Error;
+							Previous = nullptr;
+						}
+
+						int ret = close_output(FormatContext);
+						FormatContext = nullptr;
+
+						if (ret < 0)
+							throw gcnew VideoException("Cannot write trailer of the video file.");
+
+						if ((Data->SegmentCount > 0) && (Index >= Data->SegmentCount))
+							System::IO::File::Delete(get_segment_file_name(Data->FileName, Index - Data->SegmentCount + 1));
+					}
+					catch (Exception^ exception)
+					{
+						Error = exception;
+					}
+					finally
+					{
+						Done->Set();
+					}
+				}
+			};
+
+			// Periodically flushes the video file being written from system cache to disk, so power loss
+			// loses only the video written since the last flush. The file is flushed through its own handle,
+			// so the thread writing the video file is never blocked by it.
+			ref class FileFlusher
+			{
+				WriterPrivateData^ Data;
+				Timer^ FlushTimer;
+
+			public:
+				FileFlusher(WriterPrivateData^ data, TimeSpan interval)
+				{
+					Data = data;
+					FlushTimer = gcnew Timer(gcnew TimerCallback(this, &FileFlusher::FlushHandler), nullptr, interval, interval);
+				}
+
+				// Stops flushing, waiting for the flush in progress
+				void Stop()
+				{
+					ManualResetEvent^ stopped = gcnew ManualResetEvent(false);
+
+					FlushTimer->Dispose(stopped);
+					stopped->WaitOne();
+					stopped->Close();
+				}
+
+				void FlushHandler(Object^ state)
+				{
+					String^ fileName = (Data->SegmentIndex != 0) ?
+						get_segment_file_name(Data->FileName, Data->SegmentIndex) : Data->FileName;
+
+					try
+					{
+						System::IO::FileStream^ file = gcnew System::IO::FileStream(fileName, System::IO::FileMode::Open,
+							System::IO::FileAccess::Write, System::IO::FileShare::ReadWrite | System::IO::FileShare::Delete);
+
+						try
+						{
+							file->Flush(true);
+						}
+						finally
+						{
+							file->Close();
+						}
+					}
+					catch (Exception^)
+					{
+						// the file was not created yet (see pre-trigger buffer) or it was finished already
+					}
+				}
+			};
+
+			// Checks if the muxer has the specified private option
+			static bool has_muxer_option(libffmpeg::AVOutputFormat* outputFormat, const char* name)
+			{
+				return (outputFormat->priv_class != nullptr) &&
+					(libffmpeg::av_opt_find((void*) &outputFormat->priv_class, name, nullptr, 0, AV_OPT_SEARCH_FAKE_OBJ) != nullptr);
+			}
+
+			// Starts creating the next segment of the video file in background
+			static void prepare_next_segment(WriterPrivateData^ data)
+			{
+				data->NextSegment = gcnew SegmentFile(data, data->SegmentIndex + 1, nullptr);
+				ThreadPool::QueueUserWorkItem(gcnew WaitCallback(data->NextSegment, &SegmentFile::OpenHandler));
+			}
+
+			// Continues writing into the next segment, the current one is finished in background
+			static void switch_segment(WriterPrivateData^ data)
+			{
+				SegmentFile^ closing = data->ClosingSegment;
+				if ((closing != nullptr) && (closing->Done->WaitOne(0)) && (closing->Error != nullptr))
+					throw gcnew VideoException("Cannot finish segment of the video file: " + closing->Error->Message,
+						closing->Error);
+
+				// the segment was created in advance, so usually there is nothing to wait for
+				SegmentFile^ next = data->NextSegment;
+				next->Done->WaitOne();
+
+				if (next->Error != nullptr)
+					throw gcnew VideoException("Cannot create segment of the video file: " + next->Error->Message,
+						next->Error);
+
+				SegmentFile^ current = gcnew SegmentFile(data, data->SegmentIndex, data->FormatContext);
+				current->Previous = closing;
+				data->ClosingSegment = current;
+				ThreadPool::QueueUserWorkItem(gcnew WaitCallback(current, &SegmentFile::CloseHandler));
+
+				data->FormatContext = next->FormatContext;
+				data->VideoStream = data->FormatContext->streams[0];
+				data->SegmentIndex = next->Index;
+
+				prepare_next_segment(data);
+			}
+
+			// Creates the video file, which is the first segment in segmented recording
+			static void start_output(WriterPrivateData^ data)
+			{
+				if (data->SegmentIndex != 0)
+				{
+					data->FormatContext = open_output(data, get_segment_file_name(data->FileName, 1));
+					prepare_next_segment(data);
+				}
+				else
+				{
+					data->FormatContext = open_output(data, data->FileName);
+				}
+
+				data->VideoStream = data->FormatContext->streams[0];
+			}
+
+			// Writes compressed frame to the video file, starting new segment at key frame if the current one is full
+			static void write_output_packet(WriterPrivateData^ data, libffmpeg::AVPacket* packet, libffmpeg::AVRational timeBase)
+			{
+				if (data->ResetTimestamps)
+				{
+					if (data->OutputStartDts == AV_NOPTS_VALUE)
+					{
+						data->OutputStartDts = packet->dts;
+					}
+					else if ((data->SegmentIndex != 0) && (packet->flags & AV_PKT_FLAG_KEY) &&
+						(((data->SegmentDuration > 0) && (packet->dts - data->OutputStartDts >= data->SegmentDuration)) ||
+						 ((data->SegmentSize > 0) && (data->FormatContext->pb != nullptr) &&
+						  (libffmpeg::avio_tell(data->FormatContext->pb) >= data->SegmentSize))))
+					{
+						switch_segment(data);
+						data->OutputStartDts = packet->dts;
+					}
+
+					// each segment, or triggered recording, starts at zero time
+					if (packet->pts != AV_NOPTS_VALUE)
+						packet->pts -= data->OutputStartDts;
+					packet->dts -= data->OutputStartDts;
+				}
+
+				libffmpeg::av_packet_rescale_ts(packet, timeBase, data->VideoStream->time_base);
 				packet->stream_index = data->VideoStream->index;
-				Console::WriteLine("Stream: {0} PTS: {1} -> {1} bytes", packet->stream_index, packet->pts, packet->size);
 
-				// write the compressed frame to the media file
+				// write the compressed frame to the media file, the muxer takes
+				// ownership of packet's data leaving the packet blank for reuse
 				if (libffmpeg::av_interleaved_write_frame(data->FormatContext, packet) != 0)
 					throw gcnew VideoException("Error while writing video frame.");
 			}
 
+			// Allocate ring of encoded packets of the specified size
+			static PacketRing* alloc_packet_ring(int64_t capacity, int64_t window)
+			{
+				PacketRing* ring = new PacketRing();
+				ring->Buffer = (uint8_t*) libffmpeg::av_malloc((size_t) capacity);
+				ring->Packet = libffmpeg::av_packet_alloc();
+
+				if ((!ring->Buffer) || (!ring->Packet))
+				{
+					libffmpeg::av_free(ring->Buffer);
+					libffmpeg::av_packet_free(&ring->Packet);
+					delete ring;
+					return nullptr;
+				}
+
+				ring->Capacity = capacity;
+				ring->Head = 0;
+				ring->Tail = 0;
+				ring->End = 0;
+				ring->Wrapped = false;
+				ring->Count = 0;
+				ring->Window = window;
+				return ring;
+			}
+
+			// Free ring of encoded packets
+			static void free_packet_ring(PacketRing* ring)
+			{
+				if (ring == nullptr)
+					return;
+
+				libffmpeg::av_free(ring->Buffer);
+				libffmpeg::av_packet_free(&ring->Packet);
+				delete ring;
+			}
+
+			// Size taken by the packet in the ring, packets are aligned for their headers
+			static int64_t get_ring_packet_size(int size)
+			{
+				return ((int64_t)sizeof(BufferedPacket) + size + 7) & ~(int64_t)7;
+			}
+
+			// Get offset of the packet following the one at the specified offset
+			static int64_t get_next_ring_packet(PacketRing* ring, int64_t offset)
+			{
+				offset += get_ring_packet_size(((BufferedPacket*) (ring->Buffer + offset))->Size);
+
+				if ((ring->Wrapped) && (offset == ring->End))
+					offset = 0;
+
+				return offset;
+			}
+
+			// Remove the oldest packet from the ring
+			static void drop_ring_packet(PacketRing* ring)
+			{
+				int64_t next = get_next_ring_packet(ring, ring->Head);
+
+				if ((ring->Wrapped) && (next == 0))
+					ring->Wrapped = false;
+
+				ring->Head = next;
+				ring->Count--;
+			}
+
+			// Remove the oldest group of frames - a key frame and the frames following it
+			static void drop_ring_gop(PacketRing* ring)
+			{
+				do
+				{
+					drop_ring_packet(ring);
+				}
+				while ((ring->Count != 0) && ((((BufferedPacket*) (ring->Buffer + ring->Head))->Flags & AV_PKT_FLAG_KEY) == 0));
+			}
+
+			// Put encoded packet into the ring, the oldest groups of frames are removed
+			// if they are not needed to keep the time window or to free space
+			static void push_ring_packet(PacketRing* ring, libffmpeg::AVPacket* packet)
+			{
+				int64_t size = get_ring_packet_size(packet->size);
+				bool keyFrame = ((packet->flags & AV_PKT_FLAG_KEY) != 0);
+
+				// new group of frames makes the oldest one unnecessary, if the window starts after it
+				if (keyFrame)
+				{
+					while (ring->Count != 0)
+					{
+						// find the second group of frames
+						int64_t offset = get_next_ring_packet(ring, ring->Head);
+						int i = 1;
+
+						while ((i < ring->Count) && ((((BufferedPacket*) (ring->Buffer + offset))->Flags & AV_PKT_FLAG_KEY) == 0))
+						{
+							offset = get_next_ring_packet(ring, offset);
+							i++;
+						}
+
+						if ((i == ring->Count) ||
+							(packet->dts - ((BufferedPacket*) (ring->Buffer + offset))->Dts < ring->Window))
+						{
+							break;
+						}
+
+						drop_ring_gop(ring);
+					}
+				}
+
+				// find space for the packet
+				while (true)
+				{
+					if (ring->Count == 0)
+					{
+						ring->Head = 0;
+						ring->Tail = 0;
+						ring->Wrapped = false;
+
+						// the ring must start with a key frame, and the packet must fit into it
+						if ((!keyFrame) || (size > ring->Capacity))
+							return;
+						break;
+					}
+
+					if (!ring->Wrapped)
+					{
+						if (ring->Tail + size <= ring->Capacity)
+							break;
+
+						if (size <= ring->Head)
+						{
+							ring->End = ring->Tail;
+							ring->Tail = 0;
+							ring->Wrapped = true;
+							break;
+						}
+					}
+					else if (ring->Tail + size <= ring->Head)
+					{
+						break;
+					}
+
+					drop_ring_gop(ring);
+				}
+
+				BufferedPacket* header = (BufferedPacket*) (ring->Buffer + ring->Tail);
+				header->Pts = packet->pts;
+				header->Dts = packet->dts;
+				header->Duration = packet->duration;
+				header->Flags = packet->flags;
+				header->Size = packet->size;
+				memcpy(header + 1, packet->data, packet->size);
+
+				ring->Tail += size;
+				ring->Count++;
+			}
+
+			// Creates the video file, if it was not created yet, and writes the packets kept in the pre-trigger buffer
+			static void write_pretrigger_packets(WriterPrivateData^ data)
+			{
+				PacketRing* ring = data->PreTrigger;
+				libffmpeg::AVPacket* bufferedPacket = ring->Packet;
+				libffmpeg::AVRational timeBase = { data->TimeBase.Numerator, data->TimeBase.Denominator };
+
+				if (data->FormatContext == nullptr)
+					start_output(data);
+
+				while (ring->Count != 0)
+				{
+					BufferedPacket* header = (BufferedPacket*) (ring->Buffer + ring->Head);
+
+					// the packet is not reference counted, so the muxer makes its own copy of the data
+					bufferedPacket->data = (uint8_t*) (header + 1);
+					bufferedPacket->size = header->Size;
+					bufferedPacket->flags = header->Flags;
+					bufferedPacket->pts = header->Pts;
+					bufferedPacket->dts = header->Dts;
+					bufferedPacket->duration = header->Duration;
+
+					// the packet is removed first, so it is not written again if writing fails
+					drop_ring_packet(ring);
+
+					write_output_packet(data, bufferedPacket, timeBase);
+					libffmpeg::av_packet_unref(bufferedPacket);
+				}
+
+				// the buffer is not needed any more
+				data->PreTrigger = nullptr;
+				free_packet_ring(ring);
+			}
+
+			// Writes compressed frame to the video file, or keeps it in memory until recording is triggered
+			static void write_packet(WriterPrivateData^ data, libffmpeg::AVPacket* packet, libffmpeg::AVRational timeBase)
+			{
+				if (data->PreTrigger != nullptr)
+				{
+					if (Thread::VolatileRead(data->Triggered) == 0)
+					{
+						push_ring_packet(data->PreTrigger, packet);
+						libffmpeg::av_packet_unref(packet);
+						return;
+					}
+
+					// recording was triggered, so create the video file and write the buffered packets first
+					write_pretrigger_packets(data);
+				}
+
+				write_output_packet(data, packet, timeBase);
+			}
+
+			// Sends video frame to the encoder and writes all packets it has ready to the video file,
+			// null frame puts encoder into draining mode making it to output all delayed packets
+			void write_video_frame(WriterPrivateData^ data, libffmpeg::AVFrame* frame)
+			{
+				libffmpeg::AVCodecContext* codecContext = data->CodecContext;
+				libffmpeg::AVPacket* packet = data->Packet;
+
+				// encode the image
+				int ret = libffmpeg::avcodec_send_frame(codecContext, frame);
+				if ((ret < 0) && ((frame != nullptr) || (ret != AVERROR_EOF)))
+					throw gcnew VideoException("Error sending a frame for encoding.");
+
+				// an encoder may output any number of packets for a frame, so take all of them
+				while (true)
+				{
+					ret = libffmpeg::avcodec_receive_packet(codecContext, packet);
+					if ((ret == AVERROR(EAGAIN)) || (ret == AVERROR_EOF))
+						break;
+					if (ret < 0)
+						throw gcnew VideoException("Error while encoding video frame.");
+
+					write_packet(data, packet, codecContext->time_base);
+				}
+			}
+
+			// Get context converting images of the specified format to the format of the video file,
+			// contexts are created on first use and kept until the file is closed
+			static libffmpeg::SwsContext* get_convert_context(WriterPrivateData^ data, libffmpeg::AVPixelFormat srcFormat)
+			{
+				libffmpeg::AVCodecContext* codecContext = data->CodecContext;
+
+				for (int i = 0; i < PIXEL_FORMATS_COUNT; i++)
+				{
+					if (video_pixel_formats[i] != srcFormat)
+						continue;
+
+					if (data->ConvertContexts[i] == nullptr)
+					{
+						data->ConvertContexts[i] = libffmpeg::sws_getContext(codecContext->width, codecContext->height,
+							srcFormat,
+							codecContext->width, codecContext->height, codecContext->pix_fmt,
+							data->ConvertFlags, nullptr, nullptr, nullptr);
+
+						if (data->ConvertContexts[i] == nullptr)
+							throw gcnew VideoException("Cannot initialize frames conversion context.");
+					}
+
+					return data->ConvertContexts[i];
+				}
+
+				throw gcnew VideoException("Cannot initialize frames conversion context.");
+			}
+
+			// Converts source image to the format of the video file and writes it
+			static void encode_image(WriterPrivateData^ data, uint8_t* const srcData[4], const int srcLinesize[4],
+				libffmpeg::AVPixelFormat srcFormat, int64_t pts)
+			{
+				libffmpeg::AVFrame* frame = data->VideoFrame;
+
+				// 32 bpp images are given to encoders of BGR0 images, which just ignore the alpha channel
+				if ((srcFormat == data->CodecContext->pix_fmt) ||
+					((srcFormat == libffmpeg::AV_PIX_FMT_BGRA) && (data->CodecContext->pix_fmt == libffmpeg::AV_PIX_FMT_BGR0)))
+				{
+					// source image is already in the format of the encoder, so give it to the
+					// encoder as it is - the encoder makes its own copy if it needs to keep the frame
+					frame = data->InputFrame;
+
+					for (int i = 0; i < 4; i++)
+					{
+						frame->data[i] = srcData[i];
+						frame->linesize[i] = srcLinesize[i];
+					}
+				}
+				else
+				{
+					libffmpeg::sws_scale(get_convert_context(data, srcFormat), srcData, srcLinesize, 0, frame->height,
+						frame->data, frame->linesize);
+				}
+
+				frame->pts = pts;
+
+				// write the frame to the video file
+				write_video_frame(data, frame);
+			}
+
+			// Allocate frame of the asynchronous encoding queue, big enough for any source format
+			static libffmpeg::AVFrame* alloc_queue_frame(int width, int height)
+			{
+				libffmpeg::AVFrame* frame = libffmpeg::av_frame_alloc();
+				if (!frame)
+					return nullptr;
+
+				frame->opaque = libffmpeg::av_malloc(
+					libffmpeg::av_image_get_buffer_size(libffmpeg::AV_PIX_FMT_BGRA, width, height, 1));
+				if (!frame->opaque)
+				{
+					libffmpeg::av_frame_free(&frame);
+					return nullptr;
+				}
+
+				frame->width = width;
+				frame->height = height;
+				return frame;
+			}
+
+			// Free frame of the asynchronous encoding queue
+			static void free_queue_frame(libffmpeg::AVFrame* frame)
+			{
+				if (frame == nullptr)
+					return;
+
+				libffmpeg::av_free(frame->opaque);
+				libffmpeg::av_frame_free(&frame);
+			}
+
+			// Prepare asynchronous encoding queue of the specified capacity
+			static void open_queue(WriterPrivateData^ data, int capacity, int width, int height)
+			{
+				data->QueueFrames = new libffmpeg::AVFrame*[capacity];
+				for (int i = 0; i < capacity; i++)
+					data->QueueFrames[i] = nullptr;
+				data->QueueCapacity = capacity;
+
+				for (int i = 0; i < capacity; i++)
+				{
+					data->QueueFrames[i] = alloc_queue_frame(width, height);
+					if (data->QueueFrames[i] == nullptr)
+						throw gcnew VideoException("Cannot allocate encoding queue.");
+				}
+
+				data->QueueWorkFrame = alloc_queue_frame(width, height);
+				if (data->QueueWorkFrame == nullptr)
+					throw gcnew VideoException("Cannot allocate encoding queue.");
+			}
+
+			// Free asynchronous encoding queue
+			static void close_queue(WriterPrivateData^ data)
+			{
+				if (data->QueueFrames != nullptr)
+				{
+					for (int i = 0; i < data->QueueCapacity; i++)
+						free_queue_frame(data->QueueFrames[i]);
+
+					delete[] data->QueueFrames;
+					data->QueueFrames = nullptr;
+				}
+
+				free_queue_frame(data->QueueWorkFrame);
+				data->QueueWorkFrame = nullptr;
+				data->QueueCapacity = 0;
+				data->QueueCount = 0;
+			}
+
+			// Throws exception if encoding thread has failed, must be called holding the queue lock
+			static void check_encoder_error(WriterPrivateData^ data)
+			{
+				if (data->EncoderError != nullptr)
+					throw gcnew VideoException("Error in the encoding thread: " + data->EncoderError->Message,
+						data->EncoderError);
+			}
+
+			// Waits until all queued frames are encoded
+			static void wait_for_queue(WriterPrivateData^ data)
+			{
+				if (data->EncoderThread == nullptr)
+					return;
+
+				Monitor::Enter(data->QueueSync);
+				try
+				{
+					while (((data->QueueCount != 0) || (data->QueueBusy)) && (data->EncoderError == nullptr))
+						Monitor::Wait(data->QueueSync);
+				}
+				finally
+				{
+					Monitor::Exit(data->QueueSync);
+				}
+			}
+
+			// Writes all frames delayed by the encoder, which is done on closing the video file only -
+			// the encoder does not take new frames once it was drained
+			static void drain_encoder(WriterPrivateData^ data)
+			{
+				// there is no encoder when writing compressed frames
+				if ((data->Packet == nullptr) || (data->Passthrough))
+					return;
+
+				// let encoding thread to finish with queued frames
+				wait_for_queue(data);
+
+				// recording was triggered, but no frame was written since then - so create
+				// the video file and write the buffered frames before the delayed ones
+				if ((data->PreTrigger != nullptr) && (Thread::VolatileRead(data->Triggered) != 0))
+					write_pretrigger_packets(data);
+
+				// delayed frames are not needed if recording was not triggered
+				if (data->FormatContext == nullptr)
+					return;
+
+				write_video_frame(data, nullptr);
+			}
+
+			// Copies source image into the encoding queue, returns true if a frame was discarded
+			static bool enqueue_image(WriterPrivateData^ data, VideoQueuePolicy policy, uint8_t* const srcData[4],
+				const int srcLinesize[4], libffmpeg::AVPixelFormat srcFormat, int64_t pts)
+			{
+				libffmpeg::AVFrame* frame = nullptr;
+				bool dropped = false;
+
+				// reserve a free frame at the tail of the queue
+				Monitor::Enter(data->QueueSync);
+				try
+				{
+					check_encoder_error(data);
+
+					if (data->QueueCount == data->QueueCapacity)
+					{
+						switch (policy)
+						{
+						case VideoQueuePolicy::DropNewest:
+							return true;
+
+						case VideoQueuePolicy::DropOldest:
+							data->QueueHead = (data->QueueHead + 1) % data->QueueCapacity;
+							data->QueueCount--;
+							dropped = true;
+							break;
+
+						default:
+							while ((data->QueueCount == data->QueueCapacity) && (data->EncoderError == nullptr))
+								Monitor::Wait(data->QueueSync);
+
+							check_encoder_error(data);
+							break;
+						}
+					}
+
+					frame = data->QueueFrames[(data->QueueHead + data->QueueCount) % data->QueueCapacity];
+				}
+				finally
+				{
+					Monitor::Exit(data->QueueSync);
+				}
+
+				// the reserved frame is not visible to the encoding thread, so copy without holding the lock
+				libffmpeg::av_image_fill_arrays(frame->data, frame->linesize, (uint8_t*) frame->opaque,
+					srcFormat, frame->width, frame->height, 1);
+				libffmpeg::av_image_copy(frame->data, frame->linesize, (const uint8_t**) srcData, srcLinesize,
+					srcFormat, frame->width, frame->height);
+
+				frame->format = srcFormat;
+				frame->pts = pts;
+
+				// publish the frame to the encoding thread
+				Monitor::Enter(data->QueueSync);
+				try
+				{
+					data->QueueCount++;
+					Monitor::PulseAll(data->QueueSync);
+				}
+				finally
+				{
+					Monitor::Exit(data->QueueSync);
+				}
+
+				return dropped;
+			}
+
 			// Allocate picture of the specified format and size
 			static libffmpeg::AVFrame* alloc_picture(enum libffmpeg::AVPixelFormat pix_fmt, int width, int height)
 			{
@@ -106,19 +1165,74 @@ namespace AForge
 				return picture;
 			}
 
-			// Create new video stream and configure it
-			void add_video_stream(WriterPrivateData^ data, int width, int height, Rational frameRate,
-				int bitRate, libffmpeg::AVCodecID codecId, libffmpeg::AVPixelFormat pixelFormat)
+			// Get time base of frame timestamps - frame period, or fine grained one in variable frame rate mode
+			static libffmpeg::AVRational get_time_base(libffmpeg::AVOutputFormat* outputFormat,
+				libffmpeg::AVCodecID codecId, Rational frameRate, bool variableFrameRate)
+			{
+				libffmpeg::AVRational timeBase = { frameRate.Denominator, frameRate.Numerator };
+
+				if (!variableFrameRate)
+					return timeBase;
+
+				// AVI stores frames at fixed rate, writing empty frames into gaps between timestamps
+				if (strcmp(outputFormat->name, "avi") == 0)
+					return timeBase;
+
+				// MPEG-1/2 video allows only standard frame rates
+				if ((codecId == libffmpeg::AV_CODEC_ID_MPEG1VIDEO) || (codecId == libffmpeg::AV_CODEC_ID_MPEG2VIDEO))
+					return timeBase;
+
+				// MPEG-4 part 2 limits time base denominator to 16 bits
+				timeBase.num = 1;
+				timeBase.den = (codecId == libffmpeg::AV_CODEC_ID_MPEG4) ? 60000 : 90000;
+
+				return timeBase;
+			}
+
+			// Get RGB pixel format, which is natively supported by lossless encoder, or AV_PIX_FMT_NONE if there is no such
+			static libffmpeg::AVPixelFormat get_lossless_pixel_format(libffmpeg::AVCodecID codecId)
+			{
+				switch (codecId)
+				{
+				case libffmpeg::AV_CODEC_ID_FFV1:
+					return libffmpeg::AV_PIX_FMT_BGR0;
+
+				case libffmpeg::AV_CODEC_ID_HUFFYUV:
+				case libffmpeg::AV_CODEC_ID_FFVHUFF:
+					return libffmpeg::AV_PIX_FMT_BGRA;
+
+				case libffmpeg::AV_CODEC_ID_UTVIDEO:
+				case libffmpeg::AV_CODEC_ID_MAGICYUV:
+					return libffmpeg::AV_PIX_FMT_GBRP;
+
+				case libffmpeg::AV_CODEC_ID_LJPEG:
+				case libffmpeg::AV_CODEC_ID_JPEGLS:
+				case libffmpeg::AV_CODEC_ID_RAWVIDEO:
+					return libffmpeg::AV_PIX_FMT_BGR24;
+
+				case libffmpeg::AV_CODEC_ID_PNG:
+					return libffmpeg::AV_PIX_FMT_RGB24;
+
+				default:
+					return libffmpeg::AV_PIX_FMT_NONE;
+				}
+			}
+
+			// Create video encoder and configure it, the encoder is not bound to
+			// any output file, so it outlives segments of the video file
+			void create_video_encoder(WriterPrivateData^ data, int width, int height, Rational frameRate,
+				libffmpeg::AVRational timeBase, int bitRate, libffmpeg::AVCodecID codecId,
+				libffmpeg::AVPixelFormat pixelFormat, VideoEncoderOptions^ options)
 			{
 				libffmpeg::AVCodec *codec = libffmpeg::avcodec_find_encoder(codecId);
 				libffmpeg::AVCodecContext* codecContex;
 
-				// create new stream
-				data->VideoStream = libffmpeg::avformat_new_stream(data->FormatContext, codec);
-				if (!data->VideoStream)
-					throw gcnew VideoException("Failed creating new video stream.");
+				// create new encoder context
+				data->CodecContext = libffmpeg::avcodec_alloc_context3(codec);
+				if (!data->CodecContext)
+					throw gcnew VideoException("Cannot allocate codec context.");
 
-				codecContex = data->VideoStream->codec;
+				codecContex = data->CodecContext;
 				codecContex->codec_id = codecId;
 				codecContex->codec_type = libffmpeg::AVMEDIA_TYPE_VIDEO;
 
@@ -131,16 +1245,29 @@ namespace AForge
 				// of which frame timestamps are represented. for fixed-fps content,
 				// timebase should be 1/framerate and timestamp increments should be
 				// identically 1.
-				codecContex->time_base.num = frameRate.Denominator;
-				codecContex->time_base.den = frameRate.Numerator;
+				codecContex->time_base = timeBase;
+
+				// with fine grained time base, nominal frame rate is still needed for rate control
+				if ((timeBase.num != frameRate.Denominator) || (timeBase.den != frameRate.Numerator))
+				{
+					codecContex->framerate.num = frameRate.Numerator;
+					codecContex->framerate.den = frameRate.Denominator;
+				}
 
 				//codecContex->framerate = { frameRate.Denominator, frameRate.Numerator };
 				//codecContex->ticks_per_frame = 1;
 				//data->VideoStream->time_base = codecContex->time_base;
 
-				codecContex->gop_size = 12; // emit one intra frame every twelve frames at most
+				codecContex->gop_size = options->GopSize; // emit one intra frame every GopSize frames at most
+				codecContex->max_b_frames = options->MaxBFrames;
 				codecContex->pix_fmt = pixelFormat;
 
+				// let the encoder to use all processors by default
+				codecContex->thread_count = (options->ThreadCount == 0) ?
+					Environment::ProcessorCount : options->ThreadCount;
+				codecContex->thread_type = (options->ThreadingMode == VideoThreadingMode::Slice) ?
+					FF_THREAD_SLICE : FF_THREAD_FRAME;
+
 				if (codecContex->codec_id == libffmpeg::AV_CODEC_ID_MPEG1VIDEO)
 				{
 					// Needed to avoid using macroblocks in which some coeffs overflow.
@@ -152,15 +1279,14 @@ namespace AForge
 				if (codecContex->codec_id == libffmpeg::AV_CODEC_ID_H264 ||
 					codecContex->codec_id == libffmpeg::AV_CODEC_ID_H265)
 				{
-					data->VideoStream->need_parsing = libffmpeg::AVSTREAM_PARSE_FULL_ONCE;
-
 					//codecContex->coder_type = FF_CODER_TYPE_AC;
-					codecContex->profile = FF_PROFILE_H264_BASELINE;
+					// baseline profile does not allow B-frames
+					if (codecContex->max_b_frames == 0)
+						codecContex->profile = FF_PROFILE_H264_BASELINE;
 					//codecContex->crf = 25;
 					//codecContex->me_method = 7;
 					codecContex->me_subpel_quality = 4;
 					codecContex->delay = 0;
-					codecContex->max_b_frames = 0;
 					codecContex->refs = 3;
 					/*
 					codecContex->flags            |= CODEC_FLAG_LOOP_FILTER;
@@ -187,32 +1313,95 @@ namespace AForge
 					codecContex->color_range = libffmpeg::AVCOL_RANGE_JPEG;
 				}
 
-				if (codecContex->codec_id == libffmpeg::AV_CODEC_ID_THEORA)
-					codecContex->color_range = libffmpeg::AVCOL_RANGE_JPEG;
+				if (codecContex->codec_id == libffmpeg::AV_CODEC_ID_THEORA)
+					codecContex->color_range = libffmpeg::AVCOL_RANGE_JPEG;
+
+				// some formats want stream headers to be separate
+				if (data->OutputFormat->flags & AVFMT_GLOBALHEADER)
+					codecContex->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+			}
+
+			// Describe video stream of already compressed frames, which are written without encoding
+			static void create_passthrough_parameters(WriterPrivateData^ data, int width, int height,
+				libffmpeg::AVCodecID codecId, array<Byte>^ extraData)
+			{
+				// there is no encoder to provide codec parameters, so muxer gets them directly
+				data->CodecParameters = libffmpeg::avcodec_parameters_alloc();
+				if (!data->CodecParameters)
+					throw gcnew VideoException("Cannot allocate codec parameters.");
+
+				libffmpeg::AVCodecParameters* codecParameters = data->CodecParameters;
+				codecParameters->codec_type = libffmpeg::AVMEDIA_TYPE_VIDEO;
+				codecParameters->codec_id = codecId;
+				codecParameters->width = width;
+				codecParameters->height = height;
+
+				if ((extraData != nullptr) && (extraData->Length != 0))
+				{
+					codecParameters->extradata = (uint8_t*) libffmpeg::av_mallocz(extraData->Length + AV_INPUT_BUFFER_PADDING_SIZE);
+					if (!codecParameters->extradata)
+						throw gcnew VideoException("Cannot allocate codec extra data.");
+
+					System::Runtime::InteropServices::Marshal::Copy(extraData, 0,
+						IntPtr(codecParameters->extradata), extraData->Length);
+					codecParameters->extradata_size = extraData->Length;
+				}
+			}
+
+			// Add option to the dictionary of codec options
+			static void set_codec_option(libffmpeg::AVDictionary** dictionary, String^ key, String^ value)
+			{
+				IntPtr nativeKey = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(key);
+				IntPtr nativeValue = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(value);
 
-				// some formats want stream headers to be separate
-				if (data->FormatContext->oformat->flags & AVFMT_GLOBALHEADER)
-					codecContex->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+				libffmpeg::av_dict_set(dictionary, (const char*) nativeKey.ToPointer(),
+					(const char*) nativeValue.ToPointer(), 0);
+
+				System::Runtime::InteropServices::Marshal::FreeHGlobal(nativeKey);
+				System::Runtime::InteropServices::Marshal::FreeHGlobal(nativeValue);
 			}
 
 			// Open video codec and prepare out buffer and picture
-			void open_video(WriterPrivateData^ data)
+			void open_video(WriterPrivateData^ data, VideoEncoderOptions^ options)
 			{
-				libffmpeg::AVCodecContext* codecContext = data->VideoStream->codec;
+				libffmpeg::AVCodecContext* codecContext = data->CodecContext;
 				libffmpeg::AVCodec* codec = avcodec_find_encoder(codecContext->codec_id);
 
 				if (!codec)
 					throw gcnew VideoException("Cannot find video codec.");
 
+				// collect private options of the encoder, the ones it does not know are left unused
+				libffmpeg::AVDictionary* codecOptions = nullptr;
+
+				if (!String::IsNullOrEmpty(options->Preset))
+					set_codec_option(&codecOptions, "preset", options->Preset);
+				if (!String::IsNullOrEmpty(options->Tune))
+					set_codec_option(&codecOptions, "tune", options->Tune);
+				if (options->Crf >= 0)
+					set_codec_option(&codecOptions, "crf", options->Crf.ToString());
+
+				for each (KeyValuePair<String^, String^> option in options->CodecOptions)
+					set_codec_option(&codecOptions, option.Key, option.Value);
+
 				// open the codec 
-				if (avcodec_open2(codecContext, codec, nullptr) < 0)
+				int ret = avcodec_open2(codecContext, codec, &codecOptions);
+				libffmpeg::av_dict_free(&codecOptions);
+
+				if (ret < 0)
 					throw gcnew VideoException("Cannot open video codec.");
 
-				data->VideoOutputBuffer = nullptr;
+				// parameters of the opened encoder describe video stream of each output file
+				data->CodecParameters = libffmpeg::avcodec_parameters_alloc();
+				if ((!data->CodecParameters) ||
+					(libffmpeg::avcodec_parameters_from_context(data->CodecParameters, codecContext) < 0))
+				{
+					throw gcnew VideoException("Cannot allocate codec parameters.");
+				}
 
-				// allocate output buffer, more than enough even for raw video
-				data->VideoOutputBufferSize = 6 * codecContext->width * codecContext->height;
-				data->VideoOutputBuffer = (uint8_t*)libffmpeg::av_malloc(data->VideoOutputBufferSize);
+				// allocate the packet reused for all encoded frames
+				data->Packet = libffmpeg::av_packet_alloc();
+				if (!data->Packet)
+					throw gcnew VideoException("Cannot allocate video packet.");
 
 				// allocate the encoded raw picture
 				data->VideoFrame = alloc_picture(codecContext->pix_fmt, codecContext->width, codecContext->height);
@@ -223,31 +1412,89 @@ namespace AForge
 				if (!data->VideoFrame)
 					throw gcnew VideoException("Cannot allocate video picture.");
 
-				// prepare scaling context to convert RGB image to video format
-				data->ConvertContext = libffmpeg::sws_getContext(codecContext->width, codecContext->height,
-					libffmpeg::AV_PIX_FMT_BGR24,
-					codecContext->width, codecContext->height, codecContext->pix_fmt,
-					SWS_BICUBIC, nullptr, nullptr, nullptr);
+				// allocate picture referring source images, which don't need conversion
+				data->InputFrame = libffmpeg::av_frame_alloc();
+				if (!data->InputFrame)
+					throw gcnew VideoException("Cannot allocate video picture.");
 
-				// prepare scaling context to convert grayscale image to video format
-				data->ConvertContextGrayscale = libffmpeg::sws_getContext(codecContext->width, codecContext->height,
-					libffmpeg::AV_PIX_FMT_GRAY8,
-					codecContext->width, codecContext->height, codecContext->pix_fmt,
-					SWS_BICUBIC, nullptr, nullptr, nullptr);
+				data->InputFrame->width = codecContext->width;
+				data->InputFrame->height = codecContext->height;
+				data->InputFrame->format = codecContext->pix_fmt;
 
-				if ((data->ConvertContext == nullptr) || (data->ConvertContextGrayscale == nullptr))
-					throw gcnew VideoException("Cannot initialize frames conversion context.");
+				// conversion contexts for all supported source formats, created on first use
+				data->ConvertContexts = new libffmpeg::SwsContext*[PIXEL_FORMATS_COUNT];
+				for (int i = 0; i < PIXEL_FORMATS_COUNT; i++)
+					data->ConvertContexts[i] = nullptr;
 			}
 
 #pragma endregion
 
 			// Class constructor
 			VideoFileWriter::VideoFileWriter()
-				: data(nullptr), disposed(false) { }
+				: data(nullptr), disposed(false), m_queueSize(0), m_queuePolicy(VideoQueuePolicy::Block),
+				  m_variableFrameRate(false), m_segmentDuration(TimeSpan::Zero), m_segmentSize(0), m_segmentCount(0),
+				  m_preTriggerDuration(TimeSpan::Zero), m_preTriggerBufferSize(0), m_streamBufferSize(1048576),
+				  m_fragmentDuration(TimeSpan::Zero), m_flushInterval(TimeSpan::Zero) { }
+
+			// Number of frames waiting in the encoding queue
+			int VideoFileWriter::QueueDepth::get()
+			{
+				CheckIfVideoFileIsOpen();
+				return data->QueueCount;
+			}
 
 			// Creates a video file with the specified name and properties
 			void VideoFileWriter::Open(String^ fileName, int width, int height, Rational frameRate,
-				VideoCodec codec, int bitRate)
+				VideoCodec codec, int bitRate, VideoEncoderOptions^ options)
+			{
+				if (options == nullptr)
+					throw gcnew ArgumentNullException("options");
+
+				OpenFile(fileName, nullptr, nullptr, width, height, frameRate, codec, bitRate, options, nullptr);
+			}
+
+			// Creates a video in the specified streams
+			void VideoFileWriter::Open(array<System::IO::Stream^>^ streams, String^ formatName, int width, int height,
+				Rational frameRate, VideoCodec codec, int bitRate, VideoEncoderOptions^ options)
+			{
+				if (streams == nullptr)
+					throw gcnew ArgumentNullException("streams");
+				if (streams->Length == 0)
+					throw gcnew ArgumentException("At least one stream must be specified.");
+				if (formatName == nullptr)
+					throw gcnew ArgumentNullException("formatName");
+				if (options == nullptr)
+					throw gcnew ArgumentNullException("options");
+
+				for (int i = 0; i < streams->Length; i++)
+				{
+					if (streams[i] == nullptr)
+						throw gcnew ArgumentNullException("streams");
+					if (!streams[i]->CanWrite)
+						throw gcnew ArgumentException("The stream does not support writing.");
+				}
+
+				if ((m_segmentDuration.Ticks > 0) || (m_segmentSize > 0))
+					throw gcnew ArgumentException("Segmented recording requires a video file.");
+
+				OpenFile(nullptr, streams, formatName, width, height, frameRate, codec, bitRate, options, nullptr);
+			}
+
+			// Creates a video file for already compressed frames
+			void VideoFileWriter::OpenPassthrough(String^ fileName, int width, int height, Rational frameRate,
+				VideoCodec codec, array<Byte>^ extraData)
+			{
+				// the codec of compressed frames can not be guessed from file name
+				if (codec == VideoCodec::Default)
+					throw gcnew ArgumentException("Invalid video codec is specified.");
+
+				OpenFile(fileName, nullptr, nullptr, width, height, frameRate, codec, 0, nullptr, extraData);
+			}
+
+			// Creates a video file or video in streams, the one without encoder is created if no encoder options are specified
+			void VideoFileWriter::OpenFile(String^ fileName, array<System::IO::Stream^>^ streams, String^ formatName,
+				int width, int height, Rational frameRate, VideoCodec codec, int bitRate, VideoEncoderOptions^ options,
+				array<Byte>^ extraData)
 			{
 				CheckIfDisposed();
 
@@ -265,25 +1512,47 @@ namespace AForge
 				if (((int)codec < -1) || ((int)codec >= CODECS_COUNT))
 					throw gcnew ArgumentException("Invalid video codec is specified.");
 
+				// size of pre-trigger buffer
+				Int64 preTriggerBufferSize = m_preTriggerBufferSize;
+
+				if ((m_preTriggerDuration.Ticks > 0) && (preTriggerBufferSize == 0))
+				{
+					if (bitRate <= 0)
+						throw gcnew ArgumentException("Size of pre-trigger buffer must be specified, since bit rate is not known.");
+
+					// twice the amount of data encoded at nominal bit rate
+					preTriggerBufferSize = (Int64)bitRate * m_preTriggerDuration.Ticks / (TimeSpan::TicksPerSecond * 4);
+				}
+
 				m_width = width;
 				m_height = height;
 				m_codec = codec;
 				m_frameRate = frameRate;
 				m_bitRate = bitRate;
 				m_framesCount = 0;
+				m_droppedFrames = 0;
 
 				try
 				{
-					// convert specified managed String to unmanaged string
-					IntPtr ptr = System::Runtime::InteropServices::Marshal::StringToHGlobalUni(fileName);
-					wchar_t* nativeFileNameUnicode = (wchar_t*)ptr.ToPointer();
-					int utf8StringSize = WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, NULL, 0, NULL, NULL);
-					char* nativeFileName = new char[utf8StringSize];
-					WideCharToMultiByte(CP_UTF8, 0, nativeFileNameUnicode, -1, nativeFileName, utf8StringSize, NULL, NULL);
+					libffmpeg::AVOutputFormat* outputFormat = nullptr;
+
+					if (formatName != nullptr)
+					{
+						// format of streams is specified by its short name
+						IntPtr nativeFormatName = System::Runtime::InteropServices::Marshal::StringToHGlobalAnsi(formatName);
+						outputFormat = libffmpeg::av_guess_format((char*) nativeFormatName.ToPointer(), nullptr, nullptr);
+						System::Runtime::InteropServices::Marshal::FreeHGlobal(nativeFormatName);
 
-					// guess about destination file format from its file name
-					libffmpeg::AVOutputFormat* outputFormat = libffmpeg::av_guess_format(nullptr,
-						nativeFileName, nullptr);
+						if ((!outputFormat) || (outputFormat->flags & AVFMT_NOFILE))
+							throw gcnew ArgumentException("Unknown output format: " + formatName);
+					}
+					else
+					{
+						// guess about destination file format from its file name
+						char* nativeFileName = get_native_file_name(fileName);
+						outputFormat = libffmpeg::av_guess_format(nullptr, nativeFileName, nullptr);
+						delete[] nativeFileName;
+					}
 
 					if (!outputFormat)
 					{
@@ -294,36 +1563,128 @@ namespace AForge
 							throw gcnew VideoException("Cannot find suitable output format.");
 					}
 
-					// prepare format context
-					data->FormatContext = libffmpeg::avformat_alloc_context();
-					if (!data->FormatContext)
-						throw gcnew VideoException("Cannot allocate format context.");
+					data->OutputFormat = outputFormat;
+
+					// crash safe recording - the file is written in self-contained fragments, each of them passed
+					// to the system as soon as it is complete, so a file which is never closed loses only the last one
+					if (m_fragmentDuration.Ticks > 0)
+					{
+						Int64 fragmentMilliseconds = System::Math::Max((Int64) 1, m_fragmentDuration.Ticks / TimeSpan::TicksPerMillisecond);
+
+						if (has_muxer_option(outputFormat, "movflags"))
+						{
+							// MP4/MOV: empty index at the beginning and a fragment at each key frame or fragment duration
+							set_codec_option(&data->MuxerOptions, "movflags", "frag_keyframe+empty_moov+default_base_moof");
+							set_codec_option(&data->MuxerOptions, "frag_duration", (fragmentMilliseconds * 1000).ToString());
+						}
+
+						if (has_muxer_option(outputFormat, "cluster_time_limit"))
+						{
+							// Matroska/WebM: clusters are playable without index written on closing
+							set_codec_option(&data->MuxerOptions, "cluster_time_limit", fragmentMilliseconds.ToString());
+						}
+
+						set_codec_option(&data->MuxerOptions, "flush_packets", "1");
+					}
+
+					libffmpeg::AVCodecID codecId = (codec == VideoCodec::Default)
+						? outputFormat->video_codec : (libffmpeg::AVCodecID) video_codecs[(int)codec];
+
+					// time base of timestamps given to encoder or muxer
+					libffmpeg::AVRational timeBase = get_time_base(outputFormat, codecId, frameRate, m_variableFrameRate);
+					m_timeBase = Rational(timeBase.num, timeBase.den);
 
-					data->FormatContext->oformat = outputFormat;
+					data->TimeBase = m_timeBase;
+					data->FrameRate = frameRate;
 
-					// add video stream using the specified video codec
-					add_video_stream(data, width, height, frameRate, bitRate,
-						(codec == VideoCodec::Default)
-						? outputFormat->video_codec : (libffmpeg::AVCodecID) video_codecs[(int)codec],
-						(codec == VideoCodec::Default)
-						? libffmpeg::AV_PIX_FMT_YUV420P : (libffmpeg::AVPixelFormat) pixel_formats[(int)codec]);
+					if (options == nullptr)
+					{
+						// muxers of containers with global header (MP4, Matroska and others) take the header
+						// of H.264/H.265 stream only from codec parameters, not from its key frames
+						if (((extraData == nullptr) || (extraData->Length == 0)) && (outputFormat->flags & AVFMT_GLOBALHEADER) &&
+							((codecId == libffmpeg::AV_CODEC_ID_H264) || (codecId == libffmpeg::AV_CODEC_ID_H265)))
+						{
+							throw gcnew ArgumentException("Global header of the codec must be specified for the container format.");
+						}
 
-					open_video(data);
+						// describe video stream of compressed frames written as they are
+						create_passthrough_parameters(data, width, height, codecId, extraData);
 
-					// open output file
-					if (!(outputFormat->flags & AVFMT_NOFILE))
+						data->Passthrough = true;
+						data->Packet = libffmpeg::av_packet_alloc();
+						if (!data->Packet)
+							throw gcnew VideoException("Cannot allocate video packet.");
+					}
+					else
 					{
-						int err = libffmpeg::avio_open(&data->FormatContext->pb, nativeFileName, AVIO_FLAG_WRITE);
+						libffmpeg::AVPixelFormat pixelFormat = (codec == VideoCodec::Default)
+							? libffmpeg::AV_PIX_FMT_YUV420P : (libffmpeg::AVPixelFormat) pixel_formats[(int)codec];
 
-						if (err < 0)
+						// lossless recording keeps RGB images in RGB, so there is no conversion
+						// to YUV and the rest of conversions do not need any filtering
+						if (options->Lossless)
 						{
-							System::String^ msg = GetErrorMessage(err, fileName);
-							throw gcnew System::IO::IOException("Cannot open the video file. Error code: " + err +
-								". Message: " + msg + " when trying to access: " + fileName);
+							pixelFormat = get_lossless_pixel_format(codecId);
+							if (pixelFormat == libffmpeg::AV_PIX_FMT_NONE)
+								throw gcnew ArgumentException("The video codec does not support lossless encoding of RGB images.");
+
+							data->ConvertFlags = SWS_POINT;
 						}
+
+						// create encoder of the specified video codec
+						create_video_encoder(data, width, height, frameRate, timeBase, bitRate, codecId, pixelFormat, options);
+
+						open_video(data, options);
+					}
+
+					data->FileName = fileName;
+
+					if (streams != nullptr)
+					{
+						data->Output = gcnew StreamOutput(streams);
+						data->OutputHandle = System::Runtime::InteropServices::GCHandle::Alloc(data->Output);
+						data->StreamBufferSize = m_streamBufferSize;
+					}
+
+					if ((m_segmentDuration.Ticks > 0) || (m_segmentSize > 0))
+					{
+						data->SegmentDuration = TimestampToTimeBase(m_segmentDuration);
+						data->SegmentSize = m_segmentSize;
+						data->SegmentCount = m_segmentCount;
+						data->SegmentIndex = 1;
+						data->ResetTimestamps = true;
+					}
+
+					if (m_preTriggerDuration.Ticks > 0)
+					{
+						// the output file is created once recording is triggered
+						data->PreTrigger = alloc_packet_ring(preTriggerBufferSize, TimestampToTimeBase(m_preTriggerDuration));
+						if (data->PreTrigger == nullptr)
+							throw gcnew VideoException("Cannot allocate pre-trigger buffer.");
+
+						data->ResetTimestamps = true;
+					}
+					else
+					{
+						// open output file, which is the first segment in segmented recording
+						start_output(data);
+					}
+
+					// start encoding thread if asynchronous encoding was requested
+					// flushing to disk is done for video files only, streams are flushed by their owner
+					if ((m_flushInterval.Ticks > 0) && (data->Output == nullptr))
+						data->Flusher = gcnew FileFlusher(data, m_flushInterval);
+
+					if ((m_queueSize > 0) && (!data->Passthrough))
+					{
+						open_queue(data, m_queueSize, width, height);
+
+						data->EncoderThread = gcnew Thread(gcnew ThreadStart(this, &VideoFileWriter::EncoderThreadHandler));
+						data->EncoderThread->Name = (fileName != nullptr) ? fileName : formatName; // just for debugging
+						data->EncoderThread->IsBackground = true;
+						data->EncoderThread->Start();
 					}
 
-					libffmpeg::avformat_write_header(data->FormatContext, nullptr);
 					success = true;
 				}
 				finally
@@ -335,10 +1696,7 @@ namespace AForge
 
 			System::String^ VideoFileWriter::GetErrorMessage(int err, System::String ^ fileName)
 			{
-				char buff[AV_ERROR_MAX_STRING_SIZE];
-				libffmpeg::av_make_error_string(&buff[0], AV_ERROR_MAX_STRING_SIZE, err);
-				System::String^ msg = System::Runtime::InteropServices::Marshal::PtrToStringAnsi((IntPtr)&buff[0]);
-				return msg;
+				return get_error_message(err);
 			}
 
 			// Close current video file
@@ -347,15 +1705,82 @@ namespace AForge
 				if (data == nullptr)
 					return;
 
-				Flush();
+				try
+				{
+					// stop encoding thread, letting it to encode all queued frames
+					if (data->EncoderThread != nullptr)
+					{
+						Monitor::Enter(data->QueueSync);
+						try
+						{
+							data->QueueStop = true;
+							Monitor::PulseAll(data->QueueSync);
+						}
+						finally
+						{
+							Monitor::Exit(data->QueueSync);
+						}
+
+						data->EncoderThread->Join();
+						data->EncoderThread = nullptr;
+					}
 
-				if (data->FormatContext)
+					// write delayed frames and pass buffered data to the file or streams
+					drain_encoder(data);
+					Flush();
+				}
+				finally
 				{
-					if (data->FormatContext->pb != nullptr)
-						libffmpeg::av_write_trailer(data->FormatContext);
+					// resources are released even if writing of the last frames failed
+					if (data->Flusher != nullptr)
+						data->Flusher->Stop();
+
+					if (data->FormatContext)
+						close_output(data->FormatContext);
+
+					free_packet_ring(data->PreTrigger);
 
-					if (data->VideoStream)
-						libffmpeg::avcodec_close(data->VideoStream->codec);
+					// the segment created in advance has no frames, so it is not needed
+					if (data->NextSegment != nullptr)
+					{
+						data->NextSegment->Done->WaitOne();
+
+						if (data->NextSegment->FormatContext != nullptr)
+						{
+							close_output(data->NextSegment->FormatContext);
+
+							try
+							{
+								System::IO::File::Delete(get_segment_file_name(data->FileName, data->NextSegment->Index));
+							}
+							catch (Exception^)
+							{
+							}
+						}
+					}
+
+					// wait for the previous segments to be finished
+					if (data->ClosingSegment != nullptr)
+						data->ClosingSegment->Done->WaitOne();
+
+					// the output is not called back any more
+					if (data->Output != nullptr)
+						data->OutputHandle.Free();
+
+					libffmpeg::AVDictionary* muxerOptions = data->MuxerOptions;
+					libffmpeg::av_dict_free(&muxerOptions);
+
+					if (data->CodecContext)
+					{
+						libffmpeg::AVCodecContext* codecContext = data->CodecContext;
+						libffmpeg::avcodec_free_context(&codecContext);
+					}
+
+					if (data->CodecParameters)
+					{
+						libffmpeg::AVCodecParameters* codecParameters = data->CodecParameters;
+						libffmpeg::avcodec_parameters_free(&codecParameters);
+					}
 
 					if (data->VideoFrame)
 					{
@@ -363,126 +1788,371 @@ namespace AForge
 						libffmpeg::av_free(data->VideoFrame);
 					}
 
-					if (data->VideoOutputBuffer)
-						libffmpeg::av_free(data->VideoOutputBuffer);
+					if (data->InputFrame)
+					{
+						libffmpeg::AVFrame* frame = data->InputFrame;
+						libffmpeg::av_frame_free(&frame);
+					}
+
+					if (data->Packet)
+					{
+						libffmpeg::AVPacket* packet = data->Packet;
+						libffmpeg::av_packet_free(&packet);
+					}
 
-					if (data->FormatContext->pb != nullptr)
-						libffmpeg::avio_close(data->FormatContext->pb);
+					if (data->ConvertContexts != nullptr)
+					{
+						for (int i = 0; i < PIXEL_FORMATS_COUNT; i++)
+						{
+							if (data->ConvertContexts[i] != nullptr)
+								libffmpeg::sws_freeContext(data->ConvertContexts[i]);
+						}
 
-					libffmpeg::avformat_free_context(data->FormatContext);
-				}
+						delete[] data->ConvertContexts;
+					}
 
-				if (data->ConvertContext != nullptr)
-					libffmpeg::sws_freeContext(data->ConvertContext);
+					close_queue(data);
 
-				if (data->ConvertContextGrayscale != nullptr)
-					libffmpeg::sws_freeContext(data->ConvertContextGrayscale);
+					StreamOutput^ output = data->Output;
 
-				data = nullptr;
-				m_width = 0;
-				m_height = 0;
+					data = nullptr;
+					m_width = 0;
+					m_height = 0;
+
+					// streams get the trailer written on closing, the writer is closed even if they fail
+					if (output != nullptr)
+						output->Flush();
+				}
+			}
+
+			// Starts recording into the video file, which was kept in memory till now
+			void VideoFileWriter::Trigger()
+			{
+				CheckIfVideoFileIsOpen();
+
+				// the frames are written by the thread writing the next encoded frame
+				Interlocked::Exchange(data->Triggered, 1);
 			}
 
-			// Flushes delayed frames to disk
+			// Flushes buffered data to disk, the encoder keeps its delayed frames so writing may continue
 			void VideoFileWriter::Flush()
 			{
-				// This function goes by the data->VideoOutputBuffer extracting
-				// and saving to disk one frame at time, using mostly the same
-				// code which can be found on write_video_frame.
-				if (data == nullptr)
+				// nothing to flush if the encoder was not opened
+				if ((data == nullptr) || (data->Packet == nullptr))
 					return;
 
-				libffmpeg::AVCodecContext* codecContext = data->VideoStream->codec;
+				// let encoding thread to finish with queued frames
+				wait_for_queue(data);
 
-				while (true) // while there are still delayed frames
-				{
-					libffmpeg::AVPacket* packet = libffmpeg::av_packet_alloc();
-					packet->data = nullptr;
-					packet->size = 0;
-					libffmpeg::av_new_packet(packet, packet->size);
+				// recording was triggered, but no frame was written since then - so create
+				// the video file and write the buffered frames
+				if ((data->PreTrigger != nullptr) && (Thread::VolatileRead(data->Triggered) != 0))
+					write_pretrigger_packets(data);
 
-					// encode the image
-					int ret = libffmpeg::avcodec_send_frame(codecContext, nullptr);
-					if ((ret < 0) && (ret != AVERROR_EOF))
-						throw gcnew VideoException("Error sending a (flush)frame for encoding");
+				// nothing to flush if recording was not triggered yet, frames are kept in memory
+				if (data->FormatContext == nullptr)
+					return;
 
-					if (libffmpeg::avcodec_receive_packet(codecContext, packet) < 0)
-						break;
+				// write packets kept by the muxer for interleaving
+				libffmpeg::av_interleaved_write_frame(data->FormatContext, nullptr);
 
-					// TODO: consider refactoring with write_video_frame?
-					if (packet->pts != AV_NOPTS_VALUE)
-						packet->pts = libffmpeg::av_rescale_q(packet->pts, codecContext->time_base, data->VideoStream->time_base);
-					if (packet->dts != AV_NOPTS_VALUE)
-						packet->dts = libffmpeg::av_rescale_q(packet->dts, codecContext->time_base, data->VideoStream->time_base);
+				// pass buffered data to the file or streams
+				if (data->FormatContext->pb != nullptr)
+					libffmpeg::avio_flush(data->FormatContext->pb);
+
+				if (data->Output != nullptr)
+					data->Output->Flush();
+			}
+
+			// Locks bitmap in its own format if it is supported, so GDI+ does not need to convert it
+			BitmapData^ VideoFileWriter::LockBitmap(Bitmap^ frame)
+			{
+				PixelFormat lockFormat = frame->PixelFormat;
+
+				if ((lockFormat != PixelFormat::Format8bppIndexed) &&
+					(lockFormat != PixelFormat::Format32bppArgb) &&
+					(lockFormat != PixelFormat::Format32bppPArgb) &&
+					(lockFormat != PixelFormat::Format32bppRgb))
+				{
+					lockFormat = PixelFormat::Format24bppRgb;
+				}
 
-					packet->stream_index = data->VideoStream->index;
+				return frame->LockBits(System::Drawing::Rectangle(0, 0, m_width, m_height),
+					ImageLockMode::ReadOnly, lockFormat);
+			}
 
-					// write the compressed frame to the media file
-					if (libffmpeg::av_interleaved_write_frame(data->FormatContext, packet) != 0)
-						throw gcnew VideoException("Error while writing video frame.");
+			// Checks if bitmap data can be written to the video file and returns their pixel format
+			VideoPixelFormat VideoFileWriter::CheckBitmapData(BitmapData^ bitmapData)
+			{
+				if ((bitmapData->PixelFormat != PixelFormat::Format24bppRgb) &&
+					(bitmapData->PixelFormat != PixelFormat::Format32bppArgb) &&
+					(bitmapData->PixelFormat != PixelFormat::Format32bppPArgb) &&
+					(bitmapData->PixelFormat != PixelFormat::Format32bppRgb) &&
+					(bitmapData->PixelFormat != PixelFormat::Format8bppIndexed))
+				{
+					throw gcnew ArgumentException("The provided bitmap must be 24 or 32 bpp color image or 8 bpp grayscale image.");
 				}
 
-				libffmpeg::avcodec_flush_buffers(data->VideoStream->codec);
+				if ((bitmapData->Width != m_width) || (bitmapData->Height != m_height))
+					throw gcnew ArgumentException("Bitmap size must be of the same as video size, which was specified on opening video file.");
+
+				if (bitmapData->PixelFormat == PixelFormat::Format8bppIndexed)
+					return VideoPixelFormat::Gray8;
+				if (bitmapData->PixelFormat == PixelFormat::Format24bppRgb)
+					return VideoPixelFormat::Bgr24;
+
+				return VideoPixelFormat::Bgra;
+			}
+
+			// Converts frame index to time base of the video file
+			Int64 VideoFileWriter::FrameIndexToTimeBase(Int64 frameIndex)
+			{
+				libffmpeg::AVRational framePeriod = { m_frameRate.Denominator, m_frameRate.Numerator };
+				libffmpeg::AVRational timeBase = { m_timeBase.Numerator, m_timeBase.Denominator };
+
+				return libffmpeg::av_rescale_q(frameIndex, framePeriod, timeBase);
+			}
+
+			// Converts timestamp to time base of the video file
+			Int64 VideoFileWriter::TimestampToTimeBase(TimeSpan timestamp)
+			{
+				libffmpeg::AVRational ticks = { 1, (int)TimeSpan::TicksPerSecond };
+				libffmpeg::AVRational timeBase = { m_timeBase.Numerator, m_timeBase.Denominator };
+
+				return libffmpeg::av_rescale_q(timestamp.Ticks, ticks, timeBase);
 			}
 
 			// Writes new video frame to the opened video file
 			void VideoFileWriter::WriteVideoFrame(Bitmap^ frame, unsigned long frameIndex)
 			{
-				// lock the bitmap
-				BitmapData^ bitmapData = frame->LockBits(System::Drawing::Rectangle(0, 0, m_width, m_height),
-					ImageLockMode::ReadOnly,
-					(frame->PixelFormat == PixelFormat::Format8bppIndexed) ?
-					PixelFormat::Format8bppIndexed : PixelFormat::Format24bppRgb);
+				BitmapData^ bitmapData = LockBitmap(frame);
 
-				WriteVideoFrame(bitmapData, frameIndex);
+				try
+				{
+					WriteVideoFrame(bitmapData, frameIndex);
+				}
+				finally
+				{
+					frame->UnlockBits(bitmapData);
+				}
+			}
+
+			// Writes new video frame with the specified timestamp to the opened video file
+			void VideoFileWriter::WriteVideoFrame(Bitmap^ frame, TimeSpan timestamp)
+			{
+				BitmapData^ bitmapData = LockBitmap(frame);
 
-				frame->UnlockBits(bitmapData);
+				try
+				{
+					WriteVideoFrame(bitmapData, timestamp);
+				}
+				finally
+				{
+					frame->UnlockBits(bitmapData);
+				}
 			}
 
 			// Writes new video frame to the opened video file
 			void VideoFileWriter::WriteVideoFrame(BitmapData^ bitmapData, unsigned long frameIndex)
+			{
+				VideoPixelFormat format = CheckBitmapData(bitmapData);
+				WriteVideoFrame(bitmapData->Scan0, bitmapData->Stride, format, (Int64)frameIndex);
+			}
+
+			// Writes new video frame with the specified timestamp to the opened video file
+			void VideoFileWriter::WriteVideoFrame(BitmapData^ bitmapData, TimeSpan timestamp)
+			{
+				VideoPixelFormat format = CheckBitmapData(bitmapData);
+				WriteVideoFrame(bitmapData->Scan0, bitmapData->Stride, format, timestamp);
+			}
+
+			// Writes new video frame from native memory buffer to the opened video file
+			void VideoFileWriter::WriteVideoFrame(IntPtr frame, int stride, VideoPixelFormat format, Int64 pts)
+			{
+				WriteRawFrame(frame, stride, format, FrameIndexToTimeBase(pts));
+			}
+
+			// Writes new video frame from native memory buffer with the specified timestamp to the opened video file
+			void VideoFileWriter::WriteVideoFrame(IntPtr frame, int stride, VideoPixelFormat format, TimeSpan timestamp)
+			{
+				WriteRawFrame(frame, stride, format, TimestampToTimeBase(timestamp));
+			}
+
+			// Writes new video frame, which has timestamp in time base of the video file
+			void VideoFileWriter::WriteRawFrame(IntPtr frame, int stride, VideoPixelFormat format, Int64 pts)
 			{
 				CheckIfDisposed();
 
 				if (data == nullptr)
 					throw gcnew System::IO::IOException("A video file was not opened yet.");
 
-				if ((bitmapData->PixelFormat != PixelFormat::Format24bppRgb) &&
-					(bitmapData->PixelFormat != PixelFormat::Format32bppArgb) &&
-					(bitmapData->PixelFormat != PixelFormat::Format32bppPArgb) &&
-					(bitmapData->PixelFormat != PixelFormat::Format32bppRgb) &&
-					(bitmapData->PixelFormat != PixelFormat::Format8bppIndexed))
-				{
-					throw gcnew ArgumentException("The provided bitmap must be 24 or 32 bpp color image or 8 bpp grayscale image.");
-				}
+				if (data->Passthrough)
+					throw gcnew InvalidOperationException("The video file was opened for compressed frames.");
 
-				if ((bitmapData->Width != m_width) || (bitmapData->Height != m_height))
-					throw gcnew ArgumentException("Bitmap size must be of the same as video size, which was specified on opening video file.");
+				if (((int)format < 0) || ((int)format >= PIXEL_FORMATS_COUNT))
+					throw gcnew ArgumentException("Invalid pixel format is specified.");
 
+				if (frame == IntPtr::Zero)
+					throw gcnew ArgumentException("Frame buffer is not specified.");
 
-				uint8_t* srcData[4] = { static_cast<uint8_t*>(static_cast<void*>(bitmapData->Scan0)), nullptr, nullptr, nullptr };
-				int srcLinesize[4] = { bitmapData->Stride, 0, 0, 0 };
+				libffmpeg::AVPixelFormat srcFormat = (libffmpeg::AVPixelFormat) video_pixel_formats[(int)format];
 
-				// convert source image to the format of the video file
-				if (bitmapData->PixelFormat == PixelFormat::Format8bppIndexed)
+				// line sizes of all planes for the frame width, chroma planes follow the stride of the first plane
+				int srcLinesize[4];
+				libffmpeg::av_image_fill_linesizes(srcLinesize, srcFormat, m_width);
+
+				if (stride < srcLinesize[0])
+					throw gcnew ArgumentException("Stride is too small for the video frame width.");
+
+				for (int i = 1; i < 4; i++)
+					srcLinesize[i] = (int)((int64_t)srcLinesize[i] * stride / srcLinesize[0]);
+				srcLinesize[0] = stride;
+
+				uint8_t* srcData[4];
+				libffmpeg::av_image_fill_pointers(srcData, srcFormat, m_height,
+					static_cast<uint8_t*>(frame.ToPointer()), srcLinesize);
+
+				// encoders refuse frames, which are not strictly after the previous one
+				if (pts <= data->LastPts)
+					pts = data->LastPts + 1;
+				data->LastPts = pts;
+
+				if (data->EncoderThread == nullptr)
 				{
-					libffmpeg::sws_scale(data->ConvertContextGrayscale, srcData, srcLinesize, 0,
-						m_height, data->VideoFrame->data, data->VideoFrame->linesize);
+					// convert and write the frame right away
+					encode_image(data, srcData, srcLinesize, srcFormat, pts);
 				}
 				else
 				{
-					libffmpeg::sws_scale(data->ConvertContext, srcData, srcLinesize, 0, m_height,
-						data->VideoFrame->data, data->VideoFrame->linesize);
+					// copy the frame into the queue, the encoding thread does the rest
+					if (enqueue_image(data, m_queuePolicy, srcData, srcLinesize, srcFormat, pts))
+						Interlocked::Increment(m_droppedFrames);
 				}
 
-				data->VideoFrame->pts = frameIndex;
+				m_framesCount++;
+			}
+
+			// Writes new compressed video frame to the opened video file
+			void VideoFileWriter::WriteCompressedFrame(array<Byte>^ frame, bool keyFrame, Int64 pts)
+			{
+				if ((frame == nullptr) || (frame->Length == 0))
+					throw gcnew ArgumentException("Compressed frame is not specified.");
+
+				pin_ptr<Byte> pinnedFrame = &frame[0];
+				WriteCompressedFrame(IntPtr(pinnedFrame), frame->Length, keyFrame, pts);
+			}
+
+			// Writes new compressed video frame to the opened video file
+			void VideoFileWriter::WriteCompressedFrame(IntPtr frame, int size, bool keyFrame, Int64 pts)
+			{
+				WritePacket(frame, size, keyFrame, FrameIndexToTimeBase(pts));
+			}
+
+			// Writes new compressed video frame with the specified timestamp to the opened video file
+			void VideoFileWriter::WriteCompressedFrame(IntPtr frame, int size, bool keyFrame, TimeSpan timestamp)
+			{
+				WritePacket(frame, size, keyFrame, TimestampToTimeBase(timestamp));
+			}
+
+			// Writes new compressed video frame, which has timestamp in time base of the video file
+			void VideoFileWriter::WritePacket(IntPtr frame, int size, bool keyFrame, Int64 pts)
+			{
+				CheckIfDisposed();
+
+				if (data == nullptr)
+					throw gcnew System::IO::IOException("A video file was not opened yet.");
+
+				if (!data->Passthrough)
+					throw gcnew InvalidOperationException("The video file was not opened for compressed frames.");
+
+				if ((frame == IntPtr::Zero) || (size <= 0))
+					throw gcnew ArgumentException("Compressed frame is not specified.");
+
+				libffmpeg::AVPacket* packet = data->Packet;
+				libffmpeg::AVRational timeBase = { m_timeBase.Numerator, m_timeBase.Denominator };
 
-				// write the converted frame to the video file
-				write_video_frame(data);
+				// muxers refuse packets, which are not strictly after the previous one
+				if (pts <= data->LastPts)
+					pts = data->LastPts + 1;
+				data->LastPts = pts;
+
+				// the packet is not reference counted, so the muxer makes its own copy of the data
+				packet->data = static_cast<uint8_t*>(frame.ToPointer());
+				packet->size = size;
+				packet->flags = (keyFrame) ? AV_PKT_FLAG_KEY : 0;
+				packet->pts = pts;
+				packet->dts = pts;
+				packet->duration = FrameIndexToTimeBase(1);
+
+				try
+				{
+					write_packet(data, packet, timeBase);
+				}
+				finally
+				{
+					libffmpeg::av_packet_unref(packet);
+				}
 
 				m_framesCount++;
 			}
 
+			// Encoding thread - converts, encodes and writes queued video frames
+			void VideoFileWriter::EncoderThreadHandler()
+			{
+				WriterPrivateData^ data = this->data;
+
+				try
+				{
+					while (true)
+					{
+						Monitor::Enter(data->QueueSync);
+						try
+						{
+							data->QueueBusy = false;
+							Monitor::PulseAll(data->QueueSync);
+
+							while ((data->QueueCount == 0) && (!data->QueueStop))
+								Monitor::Wait(data->QueueSync);
+
+							// nothing left to encode and the writer is closing
+							if (data->QueueCount == 0)
+								break;
+
+							// take the oldest frame, giving the queue the free one instead
+							libffmpeg::AVFrame* frame = data->QueueFrames[data->QueueHead];
+							data->QueueFrames[data->QueueHead] = data->QueueWorkFrame;
+							data->QueueWorkFrame = frame;
+
+							data->QueueHead = (data->QueueHead + 1) % data->QueueCapacity;
+							data->QueueCount--;
+							data->QueueBusy = true;
+							Monitor::PulseAll(data->QueueSync);
+						}
+						finally
+						{
+							Monitor::Exit(data->QueueSync);
+						}
+
+						libffmpeg::AVFrame* frame = data->QueueWorkFrame;
+						encode_image(data, frame->data, frame->linesize, (libffmpeg::AVPixelFormat) frame->format, frame->pts);
+					}
+				}
+				catch (Exception^ exception)
+				{
+					Monitor::Enter(data->QueueSync);
+					try
+					{
+						data->EncoderError = exception;
+						data->QueueBusy = false;
+						Monitor::PulseAll(data->QueueSync);
+					}
+					finally
+					{
+						Monitor::Exit(data->QueueSync);
+					}
+				}
+			}
+
 			/*
 			// Writes new video frame to the opened video file
 			void VideoFileWriter::WriteAudioFrame( array<System::uint8_t> ^buffer )
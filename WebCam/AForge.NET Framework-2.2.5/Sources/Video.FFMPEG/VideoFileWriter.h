@@ -2,7 +2,7 @@
 // AForge.NET framework
 // http://www.aforgenet.com/framework/
 //
-// Copyright  AForge.NET, 2009-2011
+// Copyright © AForge.NET, 2009-2011
 // contacts@aforgenet.com
 //
 
@@ -11,10 +11,13 @@
 using namespace System;
 using namespace System::Drawing;
 using namespace System::Drawing::Imaging;
+using namespace System::Threading;
 using namespace AForge::Video;
 using namespace AForge::Math;
 
 #include "VideoCodec.h"
+#include "VideoEncoderOptions.h"
+#include "VideoPixelFormat.h"
 
 namespace AForge
 {
@@ -24,6 +27,29 @@ namespace AForge
 		{
 			ref struct WriterPrivateData;
 
+			/// <summary>
+			/// Enumeration of policies applied when the asynchronous encoding queue of
+			/// <see cref="VideoFileWriter"/> is full.
+			/// </summary>
+			///
+			public enum class VideoQueuePolicy
+			{
+				/// <summary>
+				///   The caller is blocked until the encoding thread frees a slot in the queue.
+				/// </summary>
+				Block,
+
+				/// <summary>
+				///   The oldest queued frame is discarded to make room for the new one.
+				/// </summary>
+				DropOldest,
+
+				/// <summary>
+				///   The new frame is discarded, already queued frames are kept.
+				/// </summary>
+				DropNewest,
+			};
+
 			/// <summary>
 			/// Class for writing video files utilizing FFmpeg library.
 			/// </summary>
@@ -64,6 +90,27 @@ namespace AForge
 				VideoCodec m_codec;
 				unsigned long m_framesCount;
 
+				int m_queueSize;
+				VideoQueuePolicy m_queuePolicy;
+				Int64 m_droppedFrames;
+
+				bool m_variableFrameRate;
+				Rational m_timeBase;
+
+				TimeSpan m_segmentDuration;
+				Int64 m_segmentSize;
+				int m_segmentCount;
+
+				TimeSpan m_preTriggerDuration;
+				Int64 m_preTriggerBufferSize;
+
+				int m_streamBufferSize;
+
+				TimeSpan m_fragmentDuration;
+				TimeSpan m_flushInterval;
+
+				void EncoderThreadHandler();
+
 				// Checks if video file was opened
 				void CheckIfVideoFileIsOpen()
 				{
@@ -170,6 +217,24 @@ namespace AForge
 					}
 				}
 
+				/// <summary>
+				/// Time base of the opened video file - unit of time, in seconds, in which timestamps of video frames are stored.
+				/// </summary>
+				///
+				/// <remarks><para>The time base is the inverse of <see cref="FrameRate"/>, unless
+				/// <see cref="VariableFrameRate"/> mode is used.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				///
+				property Rational TimeBase
+				{
+					Rational get()
+					{
+						CheckIfVideoFileIsOpen();
+						return m_timeBase;
+					}
+				}
+
 				/// <summary>
 				/// The property specifies if a video file is opened or not by this instance of the class.
 				/// </summary>
@@ -181,6 +246,362 @@ namespace AForge
 					}
 				}
 
+				/// <summary>
+				/// Size of the asynchronous encoding queue, in frames.
+				/// </summary>
+				///
+				/// <remarks><para>When the property is set to a positive value, video frames passed to
+				/// <see cref="WriteVideoFrame(Bitmap^)"/> are only copied into a queue of preallocated frames
+				/// and the caller returns immediately. Colour conversion, encoding and writing to the file are
+				/// done by a dedicated encoding thread. When the queue is full, the
+				/// <see cref="QueuePolicy"/> is applied.</para>
+				///
+				/// <para>Setting the property to <b>0</b> makes frames to be encoded on the caller's thread.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property int QueueSize
+				{
+					int get()
+					{
+						return m_queueSize;
+					}
+					void set(int queueSize)
+					{
+						m_queueSize = System::Math::Max(0, queueSize);
+					}
+				}
+
+				/// <summary>
+				/// Policy applied when the asynchronous encoding queue is full.
+				/// </summary>
+				///
+				/// <remarks><para>The property has effect only when <see cref="QueueSize"/> is
+				/// set to a positive value.</para>
+				///
+				/// <para>Default value is set to <see cref="VideoQueuePolicy::Block"/>.</para>
+				/// </remarks>
+				///
+				property VideoQueuePolicy QueuePolicy
+				{
+					VideoQueuePolicy get()
+					{
+						return m_queuePolicy;
+					}
+					void set(VideoQueuePolicy policy)
+					{
+						m_queuePolicy = policy;
+					}
+				}
+
+				/// <summary>
+				/// Variable frame rate mode, where video frames are stored with their own timestamps.
+				/// </summary>
+				///
+				/// <remarks><para>By default the video file uses time base of one frame period, so timestamps
+				/// given to <see cref="WriteVideoFrame(Bitmap^, TimeSpan)"/> are rounded to frame index. When the
+				/// property is set to <see langword="true"/>, the video file uses fine grained time base of 1/90000 s
+				/// (1/60000 s for MPEG-4 part 2 video, which can not use more precise one), so each frame keeps
+				/// the time it was captured at. Video captured with frame rate lower than the nominal one
+				/// (long exposure, for example) is then played back at correct speed, without need to duplicate frames.</para>
+				///
+				/// <para>AVI files and MPEG-1/2 video support only constant frame rate, so timestamps are rounded to
+				/// frame periods for them, leaving missing frames as gaps.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <see langword="false"/>.</para>
+				/// </remarks>
+				///
+				property bool VariableFrameRate
+				{
+					bool get()
+					{
+						return m_variableFrameRate;
+					}
+					void set(bool variableFrameRate)
+					{
+						m_variableFrameRate = variableFrameRate;
+					}
+				}
+
+				/// <summary>
+				/// Maximum duration of a single segment of the video file.
+				/// </summary>
+				///
+				/// <remarks><para>When the property (or <see cref="SegmentSize"/>) is set, video is recorded into
+				/// a sequence of files instead of a single one. Index of the segment is added to the file name given to
+				/// <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>, so recording into <b>video.mp4</b>
+				/// creates <b>video_0001.mp4</b>, <b>video_0002.mp4</b> and so on. Each segment is a complete video file,
+				/// which starts with a key frame and at zero time.</para>
+				///
+				/// <para>New segment is started at the first key frame after the current one has reached the specified
+				/// duration, so frames are neither dropped nor encoded again, but the segment may be longer by up to
+				/// one key frame interval (see <see cref="VideoEncoderOptions::GopSize"/>). The next segment file is
+				/// created in advance and the finished one is closed in background, so writing a frame does not wait
+				/// for file system when segments are switched.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="TimeSpan::Zero"/>, which means no limit.</para>
+				/// </remarks>
+				///
+				property TimeSpan SegmentDuration
+				{
+					TimeSpan get()
+					{
+						return m_segmentDuration;
+					}
+					void set(TimeSpan segmentDuration)
+					{
+						m_segmentDuration = (segmentDuration > TimeSpan::Zero) ? segmentDuration : TimeSpan::Zero;
+					}
+				}
+
+				/// <summary>
+				/// Maximum size of a single segment of the video file, in bytes.
+				/// </summary>
+				///
+				/// <remarks><para>New segment is started at the first key frame after the current one has reached
+				/// the specified size. See <see cref="SegmentDuration"/> for more information about segmented recording.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>, which means no limit.</para>
+				/// </remarks>
+				///
+				property Int64 SegmentSize
+				{
+					Int64 get()
+					{
+						return m_segmentSize;
+					}
+					void set(Int64 segmentSize)
+					{
+						m_segmentSize = System::Math::Max((Int64)0, segmentSize);
+					}
+				}
+
+				/// <summary>
+				/// Number of the most recent segments of the video file to keep on disk.
+				/// </summary>
+				///
+				/// <remarks><para>When the property is set to a positive value, the oldest segment is deleted
+				/// each time a new one is started, so the segment being written and the
+				/// <b>SegmentCount - 1</b> segments before it are kept. This bounds disk usage of continuous
+				/// recording. The property has effect only when <see cref="SegmentDuration"/> or
+				/// <see cref="SegmentSize"/> is set.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>, which means all segments are kept.</para>
+				/// </remarks>
+				///
+				property int SegmentCount
+				{
+					int get()
+					{
+						return m_segmentCount;
+					}
+					void set(int segmentCount)
+					{
+						m_segmentCount = System::Math::Max(0, segmentCount);
+					}
+				}
+
+				/// <summary>
+				/// Duration of video kept in memory before recording is triggered.
+				/// </summary>
+				///
+				/// <remarks><para>When the property is set, opening a video file does not create it yet. Video frames
+				/// are encoded as usual, but the encoded frames are only kept in memory buffer, from which the oldest
+				/// groups of frames (a key frame and frames depending on it) are discarded, so the buffer holds at least
+				/// the specified duration of video. Once <see cref="Trigger"/> is called, the video file is created, the
+				/// buffered frames are written into it and the following frames are written as usual. This way the
+				/// video file contains what happened right before the event, which triggered recording. If the video file
+				/// is closed before recording is triggered, it is not created at all.</para>
+				///
+				/// <para>Since frames are encoded all the time, triggering recording does not cause encoding of many
+				/// frames at once. The buffer is allocated once, when the video file is opened, its size is set by
+				/// <see cref="PreTriggerBufferSize"/> property.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="TimeSpan::Zero"/>, which means frames are written
+				/// into the video file right away.</para>
+				/// </remarks>
+				///
+				property TimeSpan PreTriggerDuration
+				{
+					TimeSpan get()
+					{
+						return m_preTriggerDuration;
+					}
+					void set(TimeSpan preTriggerDuration)
+					{
+						m_preTriggerDuration = (preTriggerDuration > TimeSpan::Zero) ? preTriggerDuration : TimeSpan::Zero;
+					}
+				}
+
+				/// <summary>
+				/// Size of memory buffer keeping encoded frames before recording is triggered, in bytes.
+				/// </summary>
+				///
+				/// <remarks><para>If the buffer gets full before it holds <see cref="PreTriggerDuration"/> of video,
+				/// the oldest frames are discarded, so less video is kept.</para>
+				///
+				/// <para>When the property is set to <b>0</b>, the buffer size is calculated as amount of data
+				/// produced at twice the bit rate of the video file during <see cref="PreTriggerDuration"/>, leaving room
+				/// for bit rate variations and for the group of frames, which started before the kept duration. The
+				/// property must be set for video files opened with
+				/// <see cref="OpenPassthrough( String^, int, int, Rational, VideoCodec, array&lt;Byte&gt;^ )"/>,
+				/// since their bit rate is not known.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property Int64 PreTriggerBufferSize
+				{
+					Int64 get()
+					{
+						return m_preTriggerBufferSize;
+					}
+					void set(Int64 preTriggerBufferSize)
+					{
+						m_preTriggerBufferSize = System::Math::Max((Int64)0, preTriggerBufferSize);
+					}
+				}
+
+				/// <summary>
+				/// Size of buffer used for writing video into streams, in bytes.
+				/// </summary>
+				///
+				/// <remarks><para>The property has effect only for video created with
+				/// <see cref="Open( array&lt;System::IO::Stream^&gt;^, String^, int, int, Rational, VideoCodec, int, VideoEncoderOptions^ )"/>.
+				/// Muxed data are collected in the buffer and passed to the streams once it gets full, so the streams are
+				/// written in few large blocks. Smaller buffer reduces latency of live streams, <see cref="Flush"/> can be
+				/// used to pass buffered data to the streams at any time - it does not end encoding, so writing continues
+				/// after it. Frames delayed by the encoder are not passed to the streams before the video is closed.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( array&lt;System::IO::Stream^&gt;^, String^, int, int, Rational, VideoCodec, int, VideoEncoderOptions^ )"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>1048576</b>. Minimum value is <b>4096</b>.</para>
+				/// </remarks>
+				///
+				property int StreamBufferSize
+				{
+					int get()
+					{
+						return m_streamBufferSize;
+					}
+					void set(int streamBufferSize)
+					{
+						m_streamBufferSize = System::Math::Max(4096, streamBufferSize);
+					}
+				}
+
+				/// <summary>
+				/// Maximum duration of fragments of crash safe video file.
+				/// </summary>
+				///
+				/// <remarks><para>MP4 and MOV files are not playable, if they are not closed, since index of their
+				/// frames is written only when the file is closed. When the property is set, such files are written as
+				/// fragmented MP4 - a new self-contained fragment is started at each key frame or when the specified duration
+				/// is reached. Matroska and WebM files are written in clusters of the specified duration. A fragment is passed
+				/// to the system as soon as it is complete, so the video file stays playable even if the application crashes
+				/// or is killed, losing only the last fragment of video. See <see cref="FlushInterval"/> for protection
+				/// against power loss.</para>
+				///
+				/// <para>For other formats the property only makes every frame to be passed to the system right away.</para>
+				///
+				/// <para><note>Some players do not support seeking in fragmented MP4 files as well as in regular ones.</note></para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="TimeSpan::Zero"/>, which means regular (not fragmented) video files are written.</para>
+				/// </remarks>
+				///
+				property TimeSpan FragmentDuration
+				{
+					TimeSpan get()
+					{
+						return m_fragmentDuration;
+					}
+					void set(TimeSpan fragmentDuration)
+					{
+						m_fragmentDuration = (fragmentDuration > TimeSpan::Zero) ? fragmentDuration : TimeSpan::Zero;
+					}
+				}
+
+				/// <summary>
+				/// Interval of flushing the video file from system cache to disk.
+				/// </summary>
+				///
+				/// <remarks><para>Data passed to the system are kept in its cache for a while before they are
+				/// written to disk, so they are lost on power loss. When the property is set, the video file is flushed
+				/// to disk periodically on a background thread, so neither encoding nor writing of frames waits for
+				/// the disk. Together with <see cref="FragmentDuration"/> this limits video lost on power loss to the last
+				/// fragment and the last flush interval.</para>
+				///
+				/// <para>The property has no effect for video written into streams, which are flushed by their owner.</para>
+				///
+				/// <para><note>The property is taken into account when a video file is opened, so it
+				/// must be set before calling <see cref="Open( String^, int, int, Rational, VideoCodec, int )"/>.</note></para>
+				///
+				/// <para>Default value is set to <see cref="TimeSpan::Zero"/>, which means flushing is left to the system.</para>
+				/// </remarks>
+				///
+				property TimeSpan FlushInterval
+				{
+					TimeSpan get()
+					{
+						return m_flushInterval;
+					}
+					void set(TimeSpan flushInterval)
+					{
+						m_flushInterval = (flushInterval > TimeSpan::Zero) ? flushInterval : TimeSpan::Zero;
+					}
+				}
+
+				/// <summary>
+				/// Number of frames currently waiting in the asynchronous encoding queue.
+				/// </summary>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				///
+				property int QueueDepth
+				{
+					int get();
+				}
+
+				/// <summary>
+				/// Number of frames discarded because the asynchronous encoding queue was full.
+				/// </summary>
+				///
+				/// <remarks><para>The counter is reset each time a new video file is opened.</para></remarks>
+				///
+				property Int64 DroppedFrames
+				{
+					Int64 get()
+					{
+						return Interlocked::Read(m_droppedFrames);
+					}
+				}
+
 				/// <summary>
 				/// Initializes a new instance of the <see cref="VideoFileWriter"/> class.
 				/// </summary>
@@ -284,7 +705,7 @@ namespace AForge
 				///
 				/// <para><note>The bit rate parameter represents a trade-off value between video quality
 				/// and video file size. Higher bit rate value increase video quality and result in larger
-				/// file size. Smaller values result in opposite  worse quality and small video files.</note></para>
+				/// file size. Smaller values result in opposite – worse quality and small video files.</note></para>
 				/// </remarks>
 				///
 				/// <exception cref="ArgumentException">Video file resolution must be a multiple of two.</exception>
@@ -292,7 +713,156 @@ namespace AForge
 				/// <exception cref="VideoException">A error occurred while creating new video file. See exception message.</exception>
 				/// <exception cref="System::IO::IOException">Cannot open video file with the specified name.</exception>
 				/// 
-				void Open(String^ fileName, int width, int height, Rational frameRate, VideoCodec codec, int bitRate);
+				void Open(String^ fileName, int width, int height, Rational frameRate, VideoCodec codec, int bitRate)
+				{
+					Open(fileName, width, height, frameRate, codec, bitRate, gcnew VideoEncoderOptions());
+				}
+
+				/// <summary>
+				/// Create video file with the specified name and attributes.
+				/// </summary>
+				///
+				/// <param name="fileName">Video file name to create.</param>
+				/// <param name="width">Frame width of the video file.</param>
+				/// <param name="height">Frame height of the video file.</param>
+				/// <param name="frameRate">Frame rate of the video file.</param>
+				/// <param name="codec">Video codec to use for compression.</param>
+				/// <param name="bitRate">Bit rate of the video stream.</param>
+				/// <param name="options">Encoder settings, like threading, preset or GOP length.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="Open( String^, int, int, Rational, VideoCodec, int )" />
+				/// for more information.</para>
+				///
+				/// <para><note>Encoder options, which are not recognized by the selected codec, are ignored.</note></para>
+				/// </remarks>
+				///
+				/// <exception cref="ArgumentNullException">Encoder options are not specified.</exception>
+				/// <exception cref="ArgumentException">Video file resolution must be a multiple of two.</exception>
+				/// <exception cref="ArgumentException">Invalid video codec is specified.</exception>
+				/// <exception cref="ArgumentException">The video codec does not support lossless encoding of RGB images.</exception>
+				/// <exception cref="VideoException">A error occurred while creating new video file. See exception message.</exception>
+				/// <exception cref="System::IO::IOException">Cannot open video file with the specified name.</exception>
+				/// 
+				void Open(String^ fileName, int width, int height, Rational frameRate, VideoCodec codec, int bitRate,
+					VideoEncoderOptions^ options);
+
+				/// <summary>
+				/// Create video in the specified stream.
+				/// </summary>
+				///
+				/// <param name="stream">Stream to write video into.</param>
+				/// <param name="formatName">Short name of the container format, like "mpegts", "matroska" or "mp4".</param>
+				/// <param name="width">Frame width of the video.</param>
+				/// <param name="height">Frame height of the video.</param>
+				/// <param name="frameRate">Frame rate of the video.</param>
+				/// <param name="codec">Video codec to use for compression.</param>
+				/// <param name="bitRate">Bit rate of the video stream.</param>
+				/// <param name="options">Encoder settings, like threading, preset or GOP length.</param>
+				///
+				/// <remarks><para>See documentation to the
+				/// <see cref="Open( array&lt;System::IO::Stream^&gt;^, String^, int, int, Rational, VideoCodec, int, VideoEncoderOptions^ )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void Open(System::IO::Stream^ stream, String^ formatName, int width, int height, Rational frameRate,
+					VideoCodec codec, int bitRate, VideoEncoderOptions^ options)
+				{
+					Open(gcnew array<System::IO::Stream^> { stream }, formatName, width, height, frameRate, codec, bitRate, options);
+				}
+
+				/// <summary>
+				/// Create video written into all the specified streams at once.
+				/// </summary>
+				///
+				/// <param name="streams">Streams to write video into.</param>
+				/// <param name="formatName">Short name of the container format, like "mpegts", "matroska" or "mp4".</param>
+				/// <param name="width">Frame width of the video.</param>
+				/// <param name="height">Frame height of the video.</param>
+				/// <param name="frameRate">Frame rate of the video.</param>
+				/// <param name="codec">Video codec to use for compression.</param>
+				/// <param name="bitRate">Bit rate of the video stream.</param>
+				/// <param name="options">Encoder settings, like threading, preset or GOP length.</param>
+				///
+				/// <remarks><para>The method allows to write video into memory (<see cref="System::IO::MemoryStream"/>),
+				/// pipes or network connections without creating a video file. Video is encoded and muxed once, the same
+				/// data are written into every stream, so a single encoder can feed, for example, an archive file and
+				/// a live preview connection. Data are written in blocks of <see cref="StreamBufferSize"/> bytes, starting
+				/// from the current positions of the streams. The streams are not closed by the writer.</para>
+				///
+				/// <para>A stream, which throws an exception while being written, is not written any more, so a
+				/// disconnected network client does not stop recording into the rest of the streams. Writing video
+				/// frames fails only when all streams failed.</para>
+				///
+				/// <para><note>Some formats, like MP4 without fragmentation, need to update data written before, which
+				/// requires all streams to support seeking. Formats like "mpegts" or "matroska" can be written
+				/// into any stream.</note></para>
+				///
+				/// <para><note>Segmented recording (see <see cref="SegmentDuration"/>) is not supported for streams.</note></para>
+				/// </remarks>
+				///
+				/// <exception cref="ArgumentNullException">Streams, format name or encoder options are not specified.</exception>
+				/// <exception cref="ArgumentException">A stream does not support writing.</exception>
+				/// <exception cref="ArgumentException">Unknown output format is specified.</exception>
+				/// <exception cref="ArgumentException">Segmented recording requires a video file.</exception>
+				/// <exception cref="ArgumentException">Video resolution must be a multiple of two.</exception>
+				/// <exception cref="ArgumentException">Invalid video codec is specified.</exception>
+				/// <exception cref="VideoException">A error occurred while creating the video. See exception message.</exception>
+				///
+				void Open(array<System::IO::Stream^>^ streams, String^ formatName, int width, int height, Rational frameRate,
+					VideoCodec codec, int bitRate, VideoEncoderOptions^ options);
+
+				/// <summary>
+				/// Create video file for writing video frames, which are already compressed.
+				/// </summary>
+				///
+				/// <param name="fileName">Video file name to create.</param>
+				/// <param name="width">Frame width of the video file.</param>
+				/// <param name="height">Frame height of the video file.</param>
+				/// <param name="frameRate">Frame rate of the video file.</param>
+				/// <param name="codec">Video codec the frames are compressed with.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="OpenPassthrough( String^, int, int, Rational, VideoCodec, array&lt;Byte&gt;^ )" />
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void OpenPassthrough(String^ fileName, int width, int height, Rational frameRate, VideoCodec codec)
+				{
+					OpenPassthrough(fileName, width, height, frameRate, codec, nullptr);
+				}
+
+				/// <summary>
+				/// Create video file for writing video frames, which are already compressed.
+				/// </summary>
+				///
+				/// <param name="fileName">Video file name to create.</param>
+				/// <param name="width">Frame width of the video file.</param>
+				/// <param name="height">Frame height of the video file.</param>
+				/// <param name="frameRate">Frame rate of the video file.</param>
+				/// <param name="codec">Video codec the frames are compressed with.</param>
+				/// <param name="extraData">Global header of the codec (for example SPS/PPS of H.264 stream),
+				/// may be set to <see langword="null"/>.</param>
+				///
+				/// <remarks><para>The method creates video file, which does not use any encoder. Frames compressed
+				/// by a video device (like MJPEG or H.264 streams provided by many USB cameras) are put into the file
+				/// as they are with the help of <see cref="WriteCompressedFrame( IntPtr, int, bool, Int64 )"/> method,
+				/// so neither decoding nor encoding is done.</para>
+				///
+				/// <para>Some containers require codec's global header to be available when the file is created.
+				/// H.264 and H.265 streams written into such containers (MP4, MOV, Matroska, FLV) must have
+				/// <paramref name="extraData"/> specified, since their muxers do not take it from key frames. The
+				/// header may be omitted for containers without global header, like MPEG-TS, which get SPS/PPS
+				/// with each key frame.</para>
+				///
+				/// <para><note>The <see cref="QueueSize"/> property has no effect for such video files, since
+				/// writing a compressed frame does not take time to queue it.</note></para>
+				/// </remarks>
+				///
+				/// <exception cref="ArgumentException">Video file resolution must be a multiple of two.</exception>
+				/// <exception cref="ArgumentException">Invalid video codec is specified.</exception>
+				/// <exception cref="ArgumentException">Global header of the codec must be specified for the container format.</exception>
+				/// <exception cref="VideoException">A error occurred while creating new video file. See exception message.</exception>
+				/// <exception cref="System::IO::IOException">Cannot open video file with the specified name.</exception>
+				///
+				void OpenPassthrough(String^ fileName, int width, int height, Rational frameRate, VideoCodec codec,
+					array<Byte>^ extraData);
 
 				/// <summary>
 				/// Write new video frame into currently opened video file.
@@ -374,8 +944,9 @@ namespace AForge
 				/// <remarks><para>The specified bitmap must be either color 24 or 32 bpp image or grayscale 8 bpp (indexed) image.</para>
 				/// 
 				/// <para><note>The <paramref name="timestamp"/> parameter allows user to specify presentation
-				/// time of the frame being saved. However, it is user's responsibility to make sure the value is increasing
-				/// over time.</note></para>
+				/// time of the frame being saved. The timestamp is rounded to <see cref="TimeBase"/> of the video file,
+				/// frames which would get the same or earlier time than the previous frame are moved just after it.
+				/// See <see cref="VariableFrameRate"/> for more information.</note></para>
 				/// </remarks>
 				///
 				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
@@ -383,17 +954,193 @@ namespace AForge
 				/// <exception cref="ArgumentException">Bitmap size must be of the same as video size, which was specified on opening video file.</exception>
 				/// <exception cref="VideoException">A error occurred while writing new video frame. See exception message.</exception>
 				/// 
-				void WriteVideoFrame(Bitmap^ frame, TimeSpan timestamp)
+				void WriteVideoFrame(Bitmap^ frame, TimeSpan timestamp);
+
+				/// <summary>
+				/// Write new video frame with a specific timestamp into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Bitmap data to add as a new video frame.</param>
+				/// <param name="timestamp">Frame timestamp, total time since recording started.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteVideoFrame( Bitmap^, TimeSpan )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteVideoFrame(BitmapData^ frame, TimeSpan timestamp);
+
+				/// <summary>
+				/// Write new video frame from native memory buffer into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the first line of the video frame.</param>
+				/// <param name="stride">Size of the first plane's line, in bytes.</param>
+				/// <param name="format">Pixel format of the video frame.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteVideoFrame( IntPtr, int, VideoPixelFormat, Int64 )"/>
+				/// for more information.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="ArgumentException">Invalid frame buffer, stride or pixel format is specified.</exception>
+				/// <exception cref="VideoException">A error occurred while writing new video frame. See exception message.</exception>
+				///
+				void WriteVideoFrame(IntPtr frame, int stride, VideoPixelFormat format)
+				{
+					WriteVideoFrame(frame, stride, format, m_framesCount);
+				}
+
+				/// <summary>
+				/// Write new video frame from native memory buffer into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the first line of the video frame.</param>
+				/// <param name="stride">Size of the first plane's line, in bytes.</param>
+				/// <param name="format">Pixel format of the video frame.</param>
+				/// <param name="pts">Presentation time of the frame, in frame periods (same as frame index).</param>
+				///
+				/// <remarks><para>The method allows to write frames of raw video captured by a video device without
+				/// wrapping them into <see cref="Bitmap"/>. The frame must have width and height as specified
+				/// during file opening.</para>
+				///
+				/// <para>If pixel format of the frame is the one used by the encoder (for example
+				/// <see cref="VideoPixelFormat::Yuv420P"/> for most of H.264/MPEG-4 files), the frame is passed
+				/// to the encoder without any conversion. Otherwise it is converted to the encoder's pixel
+				/// format first.</para>
+				/// </remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="InvalidOperationException">The video file was opened for compressed frames.</exception>
+				/// <exception cref="ArgumentException">Invalid frame buffer, stride or pixel format is specified.</exception>
+				/// <exception cref="VideoException">A error occurred while writing new video frame. See exception message.</exception>
+				///
+				void WriteVideoFrame(IntPtr frame, int stride, VideoPixelFormat format, Int64 pts);
+
+				/// <summary>
+				/// Write new video frame from native memory buffer with a specific timestamp into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the first line of the video frame.</param>
+				/// <param name="stride">Size of the first plane's line, in bytes.</param>
+				/// <param name="format">Pixel format of the video frame.</param>
+				/// <param name="timestamp">Frame timestamp, total time since recording started.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteVideoFrame( IntPtr, int, VideoPixelFormat, Int64 )"/>
+				/// and <see cref="WriteVideoFrame( Bitmap^, TimeSpan )"/> for more information and the list of possible exceptions.</para>
+				/// </remarks>
+				///
+				void WriteVideoFrame(IntPtr frame, int stride, VideoPixelFormat format, TimeSpan timestamp);
+
+				/// <summary>
+				/// Write new compressed video frame into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Compressed video frame.</param>
+				/// <param name="keyFrame">Specifies if the frame is a key frame.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteCompressedFrame( IntPtr, int, bool, Int64 )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteCompressedFrame(array<Byte>^ frame, bool keyFrame)
 				{
-					WriteVideoFrame(frame, timestamp.TotalSeconds * m_frameRate.Value);
+					WriteCompressedFrame(frame, keyFrame, m_framesCount);
 				}
 
+				/// <summary>
+				/// Write new compressed video frame into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Compressed video frame.</param>
+				/// <param name="keyFrame">Specifies if the frame is a key frame.</param>
+				/// <param name="pts">Presentation time of the frame, in frame periods (same as frame index).</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteCompressedFrame( IntPtr, int, bool, Int64 )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteCompressedFrame(array<Byte>^ frame, bool keyFrame, Int64 pts);
+
+				/// <summary>
+				/// Write new compressed video frame into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the compressed video frame.</param>
+				/// <param name="size">Size of the compressed video frame, in bytes.</param>
+				/// <param name="keyFrame">Specifies if the frame is a key frame.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteCompressedFrame( IntPtr, int, bool, Int64 )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteCompressedFrame(IntPtr frame, int size, bool keyFrame)
+				{
+					WriteCompressedFrame(frame, size, keyFrame, m_framesCount);
+				}
+
+				/// <summary>
+				/// Write new compressed video frame into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the compressed video frame.</param>
+				/// <param name="size">Size of the compressed video frame, in bytes.</param>
+				/// <param name="keyFrame">Specifies if the frame is a key frame.</param>
+				/// <param name="pts">Presentation time of the frame, in frame periods (same as frame index).</param>
+				///
+				/// <remarks><para>The method puts the frame into the video file as it is, so it must be compressed
+				/// with the codec specified when the file was opened with
+				/// <see cref="OpenPassthrough( String^, int, int, Rational, VideoCodec, array&lt;Byte&gt;^ )"/>.
+				/// The frame data are copied, so the buffer can be reused once the method returns.</para>
+				///
+				/// <para><note>Frames must be passed in decoding order. Decoding time of each frame is set equal
+				/// to its presentation time, so streams with B-frames are not supported.</note></para>
+				/// </remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				/// <exception cref="InvalidOperationException">The video file was not opened for compressed frames.</exception>
+				/// <exception cref="ArgumentException">Compressed frame is not specified.</exception>
+				/// <exception cref="VideoException">A error occurred while writing new video frame. See exception message.</exception>
+				///
+				void WriteCompressedFrame(IntPtr frame, int size, bool keyFrame, Int64 pts);
+
+				/// <summary>
+				/// Write new compressed video frame with a specific timestamp into currently opened video file.
+				/// </summary>
+				///
+				/// <param name="frame">Pointer to the compressed video frame.</param>
+				/// <param name="size">Size of the compressed video frame, in bytes.</param>
+				/// <param name="keyFrame">Specifies if the frame is a key frame.</param>
+				/// <param name="timestamp">Frame timestamp, total time since recording started.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteCompressedFrame( IntPtr, int, bool, Int64 )"/>
+				/// and <see cref="WriteVideoFrame( Bitmap^, TimeSpan )"/> for more information and the list of possible exceptions.</para>
+				/// </remarks>
+				///
+				void WriteCompressedFrame(IntPtr frame, int size, bool keyFrame, TimeSpan timestamp);
+
 				/// <summary>
 				/// Flushes the current write buffer to disk.
 				/// </summary>
 				///
+				/// <remarks><para>If asynchronous encoding is used (see <see cref="QueueSize"/>), the method
+				/// waits until all queued frames are encoded before flushing.</para>
+				///
+				/// <para>Frames delayed by the encoder (for example for B-frames or rate control lookahead) are not
+				/// written, since the encoder does not take new frames after giving them out. They are written when the
+				/// video file is closed, so the method can be called at any time while recording.</para>
+				///
+				/// <para>Video written into streams has its buffer passed to the streams and the streams are flushed.</para></remarks>
+				///
 				void Flush();
 
+				/// <summary>
+				/// Start recording into the video file, which was opened with <see cref="PreTriggerDuration"/> set.
+				/// </summary>
+				///
+				/// <remarks><para>The video file is created when the next encoded frame is ready, or by <see cref="Flush"/>
+				/// or <see cref="Close"/> if no frame follows, then frames kept in memory are written into it followed by
+				/// all frames written after. The method does not wait for that, so it can be called from any thread. The method
+				/// has no effect if the video file is already being recorded.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video file was open.</exception>
+				///
+				void Trigger();
+
 				/// <summary>
 				/// Close currently opened video file if any.
 				/// </summary>
@@ -401,6 +1148,18 @@ namespace AForge
 				void Close();
 
 			private:
+				void OpenFile(String^ fileName, array<System::IO::Stream^>^ streams, String^ formatName, int width, int height,
+					Rational frameRate, VideoCodec codec, int bitRate, VideoEncoderOptions^ options, array<Byte>^ extraData);
+
+				BitmapData^ LockBitmap(Bitmap^ frame);
+				VideoPixelFormat CheckBitmapData(BitmapData^ frame);
+
+				Int64 FrameIndexToTimeBase(Int64 frameIndex);
+				Int64 TimestampToTimeBase(TimeSpan timestamp);
+
+				void WriteRawFrame(IntPtr frame, int stride, VideoPixelFormat format, Int64 pts);
+				void WritePacket(IntPtr frame, int size, bool keyFrame, Int64 pts);
+
 				System::String^ GetErrorMessage(int err, System::String ^ fileName);
 			};
 		}
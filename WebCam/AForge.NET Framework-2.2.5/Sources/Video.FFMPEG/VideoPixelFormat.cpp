@@ -0,0 +1,30 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#include "StdAfx.h"
+#include "VideoPixelFormat.h"
+
+namespace libffmpeg
+{
+	extern "C"
+	{
+#include "libavutil\pixfmt.h"
+	}
+}
+
+int video_pixel_formats[] =
+{
+	libffmpeg::AV_PIX_FMT_BGR24,            // Bgr24
+	libffmpeg::AV_PIX_FMT_BGRA,             // Bgra
+	libffmpeg::AV_PIX_FMT_GRAY8,            // Gray8
+	libffmpeg::AV_PIX_FMT_NV12,             // Nv12
+	libffmpeg::AV_PIX_FMT_YUYV422,          // Yuy2
+	libffmpeg::AV_PIX_FMT_YUV420P,          // Yuv420P
+};
+
+int PIXEL_FORMATS_COUNT(sizeof(video_pixel_formats) / sizeof(libffmpeg::AVPixelFormat));
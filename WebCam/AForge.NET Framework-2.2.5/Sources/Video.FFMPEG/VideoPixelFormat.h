@@ -0,0 +1,64 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+using namespace System;
+
+extern int video_pixel_formats[];
+
+extern int PIXEL_FORMATS_COUNT;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Enumeration of pixel formats of raw video frames, which can be passed to or received from FFmpeg library.
+			/// </summary>
+			///
+			/// <remarks><para>All formats expect planes of an image to follow each other in a single memory block.
+			/// Line size (stride) of chroma planes is derived from line size of the first plane.</para></remarks>
+			///
+			public enum class VideoPixelFormat
+			{
+				/// <summary>
+				///   Packed 24 bpp, B, G, R byte order - the same as <see cref="System::Drawing::Imaging::PixelFormat::Format24bppRgb"/>.
+				/// </summary>
+				Bgr24,
+
+				/// <summary>
+				///   Packed 32 bpp, B, G, R, A byte order - the same as <see cref="System::Drawing::Imaging::PixelFormat::Format32bppArgb"/>.
+				/// </summary>
+				Bgra,
+
+				/// <summary>
+				///   8 bpp grayscale.
+				/// </summary>
+				Gray8,
+
+				/// <summary>
+				///   Planar YUV 4:2:0, Y plane followed by interleaved U and V plane.
+				/// </summary>
+				Nv12,
+
+				/// <summary>
+				///   Packed YUV 4:2:2, Y0, U, Y1, V byte order.
+				/// </summary>
+				Yuy2,
+
+				/// <summary>
+				///   Planar YUV 4:2:0, Y plane followed by U and V planes.
+				/// </summary>
+				Yuv420P,
+			};
+		}
+	}
+}
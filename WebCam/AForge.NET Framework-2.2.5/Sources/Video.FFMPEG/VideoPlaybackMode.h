@@ -0,0 +1,42 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Enumeration of methods, which <see cref="VideoFileSource"/> uses to pace provided video frames.
+			/// </summary>
+			///
+			public enum class VideoPlaybackMode
+			{
+				/// <summary>
+				///   Video frames are provided with a fixed interval, which is taken from frame rate of the video
+				///   file or from <see cref="VideoFileSource::FrameInterval"/> property.
+				/// </summary>
+				FrameInterval,
+
+				/// <summary>
+				///   Video frames are provided according to their presentation time, so the video is played
+				///   the way it was recorded, including variable frame rate.
+				/// </summary>
+				Realtime,
+
+				/// <summary>
+				///   Video frames are provided as fast as they are decoded and processed by clients.
+				/// </summary>
+				AsFastAsPossible,
+			};
+		}
+	}
+}
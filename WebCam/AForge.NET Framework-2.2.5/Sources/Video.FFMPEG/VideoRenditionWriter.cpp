@@ -0,0 +1,417 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#include "StdAfx.h"
+#include "VideoRenditionWriter.h"
+#include "VideoFileWriter.h"
+
+namespace libffmpeg
+{
+	extern "C"
+	{
+#include "libavutil\avutil.h"
+#include "libswscale\swscale.h"
+	}
+}
+
+using namespace System::Collections::Generic;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			// Frame in YUV 4:2:0 format, which chroma planes have half of the stride of the luma plane,
+			// so the frame can be given to VideoFileWriter by pointer to its first plane
+			struct RenditionImage
+			{
+				int Width;
+				int Height;
+				uint8_t* Buffer;
+				uint8_t* Data[4];
+				int Linesize[4];
+				libffmpeg::SwsContext* ScaleContext;	// scales the shared frame to the size of this one
+			};
+
+			// A structure to encapsulate all FFMPEG related private variable
+			ref struct RenditionWriterPrivateData
+			{
+			public:
+				array<VideoFileWriter^>^ Writers;
+
+				// frames of distinct sizes - the first one is the shared frame converted from RGB,
+				// the others are scaled from it, and index of the frame written into each video file
+				RenditionImage* Images;
+				int ImagesCount;
+				array<int>^ WriterImages;
+
+				libffmpeg::SwsContext* ConvertContext;
+
+				// timestamp of the frame being written
+				bool HasTimestamp;
+				TimeSpan Timestamp;
+
+				RenditionWriterPrivateData()
+				{
+					Writers = nullptr;
+					Images = nullptr;
+					ImagesCount = 0;
+					WriterImages = nullptr;
+					ConvertContext = nullptr;
+					HasTimestamp = false;
+					Timestamp = TimeSpan::Zero;
+				}
+
+				// Scales the shared frame to the size of the specified frame
+				void ScaleImage(int index)
+				{
+					RenditionImage* image = &Images[index];
+
+					libffmpeg::sws_scale(image->ScaleContext, Images[0].Data, Images[0].Linesize, 0, Images[0].Height,
+						image->Data, image->Linesize);
+				}
+
+				// Writes frame of its size into the specified video file, the writer converts it only if
+				// its encoder takes other format than YUV 4:2:0 (MJPEG, for example)
+				void WriteImage(int index)
+				{
+					RenditionImage* image = &Images[WriterImages[index]];
+					IntPtr frame(image->Data[0]);
+
+					if (HasTimestamp)
+						Writers[index]->WriteVideoFrame(frame, image->Linesize[0], VideoPixelFormat::Yuv420P, Timestamp);
+					else
+						Writers[index]->WriteVideoFrame(frame, image->Linesize[0], VideoPixelFormat::Yuv420P);
+				}
+			};
+
+			// Allocates buffer of YUV 4:2:0 frame with lines aligned for SIMD code of scaler
+			static bool alloc_rendition_image(RenditionImage* image, int width, int height)
+			{
+				int stride = FFALIGN(width, 64);
+				int chromaHeight = (height + 1) / 2;
+
+				image->Width = width;
+				image->Height = height;
+				image->Buffer = (uint8_t*) libffmpeg::av_malloc((size_t) stride * height + (size_t) stride * chromaHeight);
+
+				if (image->Buffer == nullptr)
+					return false;
+
+				image->Linesize[0] = stride;
+				image->Linesize[1] = stride / 2;
+				image->Linesize[2] = stride / 2;
+				image->Linesize[3] = 0;
+
+				image->Data[0] = image->Buffer;
+				image->Data[1] = image->Data[0] + (size_t) stride * height;
+				image->Data[2] = image->Data[1] + (size_t) (stride / 2) * chromaHeight;
+				image->Data[3] = nullptr;
+
+				return true;
+			}
+
+			// Locks bitmap in its own format if it is supported, so GDI+ does not need to convert it
+			static BitmapData^ lock_bitmap(Bitmap^ frame)
+			{
+				PixelFormat lockFormat = frame->PixelFormat;
+
+				if ((lockFormat != PixelFormat::Format8bppIndexed) &&
+					(lockFormat != PixelFormat::Format32bppArgb) &&
+					(lockFormat != PixelFormat::Format32bppPArgb) &&
+					(lockFormat != PixelFormat::Format32bppRgb))
+				{
+					lockFormat = PixelFormat::Format24bppRgb;
+				}
+
+				return frame->LockBits(System::Drawing::Rectangle(0, 0, frame->Width, frame->Height),
+					ImageLockMode::ReadOnly, lockFormat);
+			}
+
+			// Class constructor
+			VideoRenditionWriter::VideoRenditionWriter()
+				: data(nullptr), disposed(false), m_queueSize(0), m_variableFrameRate(false) { }
+
+			// Creates video files of all renditions
+			void VideoRenditionWriter::Open(int width, int height, Rational frameRate, array<VideoRendition^>^ renditions)
+			{
+				CheckIfDisposed();
+
+				if (renditions == nullptr)
+					throw gcnew ArgumentNullException("renditions");
+				if (renditions->Length == 0)
+					throw gcnew ArgumentException("At least one rendition must be specified.");
+				if ((width <= 0) || (height <= 0))
+					throw gcnew ArgumentException("Frame size must be positive.");
+
+				for (int i = 0; i < renditions->Length; i++)
+				{
+					if (renditions[i] == nullptr)
+						throw gcnew ArgumentNullException("renditions");
+					if (renditions[i]->EncoderOptions->Lossless)
+						throw gcnew ArgumentException("Lossless encoding is not supported.");
+				}
+
+				// close previous files if any open
+				Close();
+
+				data = gcnew RenditionWriterPrivateData();
+				bool success = false;
+
+				try
+				{
+					// find distinct sizes of video files, the shared frame has size of written frames
+					List<System::Drawing::Size>^ sizes = gcnew List<System::Drawing::Size>();
+					sizes->Add(System::Drawing::Size(width, height));
+
+					data->WriterImages = gcnew array<int>(renditions->Length);
+
+					for (int i = 0; i < renditions->Length; i++)
+					{
+						System::Drawing::Size size = (renditions[i]->Width == 0) ? System::Drawing::Size(width, height) :
+							System::Drawing::Size(renditions[i]->Width, renditions[i]->Height);
+
+						int index = sizes->IndexOf(size);
+						if (index < 0)
+						{
+							index = sizes->Count;
+							sizes->Add(size);
+						}
+
+						data->WriterImages[i] = index;
+					}
+
+					data->Images = new RenditionImage[sizes->Count]();
+					data->ImagesCount = sizes->Count;
+
+					for (int i = 0; i < sizes->Count; i++)
+					{
+						if (!alloc_rendition_image(&data->Images[i], sizes[i].Width, sizes[i].Height))
+							throw gcnew VideoException("Cannot allocate video frame.");
+
+						if (i != 0)
+						{
+							data->Images[i].ScaleContext = libffmpeg::sws_getContext(width, height, libffmpeg::AV_PIX_FMT_YUV420P,
+								sizes[i].Width, sizes[i].Height, libffmpeg::AV_PIX_FMT_YUV420P,
+								SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+							if (data->Images[i].ScaleContext == nullptr)
+								throw gcnew VideoException("Cannot initialize frames scaling context.");
+						}
+					}
+
+					// create video files, frames given to them are already in format of most encoders
+					data->Writers = gcnew array<VideoFileWriter^>(renditions->Length);
+
+					for (int i = 0; i < renditions->Length; i++)
+					{
+						VideoRendition^ rendition = renditions[i];
+						RenditionImage* image = &data->Images[data->WriterImages[i]];
+
+						VideoFileWriter^ writer = gcnew VideoFileWriter();
+						writer->QueueSize = m_queueSize;
+						writer->VariableFrameRate = m_variableFrameRate;
+
+						data->Writers[i] = writer;
+
+						writer->Open(rendition->FileName, image->Width, image->Height, frameRate,
+							rendition->Codec, rendition->BitRate, rendition->EncoderOptions);
+					}
+
+					m_width = width;
+					m_height = height;
+					m_frameRate = frameRate;
+
+					success = true;
+				}
+				finally
+				{
+					if (!success)
+						Close();
+				}
+			}
+
+			// Writes new video frame into all video files
+			void VideoRenditionWriter::WriteVideoFrame(Bitmap^ frame)
+			{
+				BitmapData^ bitmapData = lock_bitmap(frame);
+
+				try
+				{
+					WriteFrame(bitmapData, false, TimeSpan::Zero);
+				}
+				finally
+				{
+					frame->UnlockBits(bitmapData);
+				}
+			}
+
+			// Writes new video frame with the specified timestamp into all video files
+			void VideoRenditionWriter::WriteVideoFrame(Bitmap^ frame, TimeSpan timestamp)
+			{
+				BitmapData^ bitmapData = lock_bitmap(frame);
+
+				try
+				{
+					WriteFrame(bitmapData, true, timestamp);
+				}
+				finally
+				{
+					frame->UnlockBits(bitmapData);
+				}
+			}
+
+			// Converts the frame once, then scales and encodes it for all video files in parallel
+			void VideoRenditionWriter::WriteFrame(BitmapData^ bitmapData, bool hasTimestamp, TimeSpan timestamp)
+			{
+				CheckIfDisposed();
+
+				if (data == nullptr)
+					throw gcnew System::IO::IOException("A video file was not opened yet.");
+
+				libffmpeg::AVPixelFormat srcFormat;
+
+				switch (bitmapData->PixelFormat)
+				{
+				case PixelFormat::Format24bppRgb:
+					srcFormat = libffmpeg::AV_PIX_FMT_BGR24;
+					break;
+				case PixelFormat::Format32bppArgb:
+				case PixelFormat::Format32bppPArgb:
+				case PixelFormat::Format32bppRgb:
+					srcFormat = libffmpeg::AV_PIX_FMT_BGRA;
+					break;
+				case PixelFormat::Format8bppIndexed:
+					srcFormat = libffmpeg::AV_PIX_FMT_GRAY8;
+					break;
+				default:
+					throw gcnew ArgumentException("The provided bitmap must be 24 or 32 bpp color image or 8 bpp grayscale image.");
+				}
+
+				if ((bitmapData->Width != m_width) || (bitmapData->Height != m_height))
+					throw gcnew ArgumentException("Bitmap size must be of the same as video size, which was specified on opening video files.");
+
+				// conversion from RGB shared by all video files - video files of encoders taking
+				// YUV 4:2:0 frames get them as they are, the others still convert it to their format
+				data->ConvertContext = libffmpeg::sws_getCachedContext(data->ConvertContext,
+					m_width, m_height, srcFormat, m_width, m_height, libffmpeg::AV_PIX_FMT_YUV420P,
+					SWS_BICUBIC, nullptr, nullptr, nullptr);
+
+				if (data->ConvertContext == nullptr)
+					throw gcnew VideoException("Cannot initialize frames conversion context.");
+
+				uint8_t* srcData[4] = { static_cast<uint8_t*>(bitmapData->Scan0.ToPointer()), nullptr, nullptr, nullptr };
+				int srcLinesize[4] = { bitmapData->Stride, 0, 0, 0 };
+
+				libffmpeg::sws_scale(data->ConvertContext, srcData, srcLinesize, 0, m_height,
+					data->Images[0].Data, data->Images[0].Linesize);
+
+				data->HasTimestamp = hasTimestamp;
+				data->Timestamp = timestamp;
+
+				try
+				{
+					if (data->ImagesCount > 1)
+						System::Threading::Tasks::Parallel::For(1, data->ImagesCount, gcnew Action<int>(data, &RenditionWriterPrivateData::ScaleImage));
+
+					System::Threading::Tasks::Parallel::For(0, data->Writers->Length, gcnew Action<int>(data, &RenditionWriterPrivateData::WriteImage));
+				}
+				catch (AggregateException^ ex)
+				{
+					// report the error the same way as a single video file does
+					throw ex->Flatten()->InnerExceptions[0];
+				}
+			}
+
+			// Flushes all video files, each one is flushed even if flushing of another one failed
+			void VideoRenditionWriter::Flush()
+			{
+				if (data == nullptr)
+					return;
+
+				Exception^ error = nullptr;
+
+				for (int i = 0; i < data->Writers->Length; i++)
+				{
+					try
+					{
+						data->Writers[i]->Flush();
+					}
+					catch (Exception^ ex)
+					{
+						if (error == nullptr)
+							error = ex;
+					}
+				}
+
+				if (error != nullptr)
+					throw error;
+			}
+
+			// Closes all video files, each one is closed even if closing of another one failed
+			void VideoRenditionWriter::Close()
+			{
+				if (data == nullptr)
+					return;
+
+				Exception^ error = nullptr;
+
+				try
+				{
+					if (data->Writers != nullptr)
+					{
+						for (int i = 0; i < data->Writers->Length; i++)
+						{
+							if (data->Writers[i] == nullptr)
+								continue;
+
+							try
+							{
+								data->Writers[i]->Close();
+							}
+							catch (Exception^ ex)
+							{
+								if (error == nullptr)
+									error = ex;
+							}
+						}
+
+						data->Writers = nullptr;
+					}
+				}
+				finally
+				{
+					if (data->Images != nullptr)
+					{
+						for (int i = 0; i < data->ImagesCount; i++)
+						{
+							libffmpeg::av_free(data->Images[i].Buffer);
+
+							if (data->Images[i].ScaleContext != nullptr)
+								libffmpeg::sws_freeContext(data->Images[i].ScaleContext);
+						}
+
+						delete[] data->Images;
+					}
+
+					if (data->ConvertContext != nullptr)
+						libffmpeg::sws_freeContext(data->ConvertContext);
+
+					data = nullptr;
+					m_width = 0;
+					m_height = 0;
+				}
+
+				// the first error is reported once all video files are closed
+				if (error != nullptr)
+					throw error;
+			}
+		}
+	}
+}
@@ -0,0 +1,452 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+#include "VideoCodec.h"
+#include "VideoEncoderOptions.h"
+
+using namespace System;
+using namespace System::Drawing;
+using namespace System::Drawing::Imaging;
+using namespace AForge::Math;
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			ref struct RenditionWriterPrivateData;
+
+			/// <summary>
+			/// Description of a video file written by <see cref="VideoRenditionWriter"/>.
+			/// </summary>
+			///
+			public ref class VideoRendition
+			{
+				String^ m_fileName;
+				int m_width;
+				int m_height;
+				VideoCodec m_codec;
+				int m_bitRate;
+				VideoEncoderOptions^ m_encoderOptions;
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoRendition"/> class, which keeps size of written frames.
+				/// </summary>
+				///
+				/// <param name="fileName">Video file name to create.</param>
+				/// <param name="codec">Video codec to use for compression.</param>
+				/// <param name="bitRate">Bit rate of the video stream.</param>
+				///
+				VideoRendition(String^ fileName, VideoCodec codec, int bitRate)
+				{
+					Init(fileName, 0, 0, codec, bitRate);
+				}
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoRendition"/> class.
+				/// </summary>
+				///
+				/// <param name="fileName">Video file name to create.</param>
+				/// <param name="width">Frame width of the video file.</param>
+				/// <param name="height">Frame height of the video file.</param>
+				/// <param name="codec">Video codec to use for compression.</param>
+				/// <param name="bitRate">Bit rate of the video stream.</param>
+				///
+				/// <exception cref="ArgumentException">Width and height must be both positive or both zero.</exception>
+				///
+				VideoRendition(String^ fileName, int width, int height, VideoCodec codec, int bitRate)
+				{
+					Init(fileName, width, height, codec, bitRate);
+				}
+
+				/// <summary>
+				/// Video file name to create.
+				/// </summary>
+				///
+				property String^ FileName
+				{
+					String^ get()
+					{
+						return m_fileName;
+					}
+				}
+
+				/// <summary>
+				/// Frame width of the video file, <b>0</b> if it is the same as width of written frames.
+				/// </summary>
+				///
+				property int Width
+				{
+					int get()
+					{
+						return m_width;
+					}
+				}
+
+				/// <summary>
+				/// Frame height of the video file, <b>0</b> if it is the same as height of written frames.
+				/// </summary>
+				///
+				property int Height
+				{
+					int get()
+					{
+						return m_height;
+					}
+				}
+
+				/// <summary>
+				/// Video codec to use for compression.
+				/// </summary>
+				///
+				property VideoCodec Codec
+				{
+					VideoCodec get()
+					{
+						return m_codec;
+					}
+				}
+
+				/// <summary>
+				/// Bit rate of the video stream.
+				/// </summary>
+				///
+				property int BitRate
+				{
+					int get()
+					{
+						return m_bitRate;
+					}
+				}
+
+				/// <summary>
+				/// Encoder settings of the video file.
+				/// </summary>
+				///
+				/// <remarks><para><note>Lossless encoding (see <see cref="VideoEncoderOptions::Lossless"/>) is
+				/// not supported, since frames are shared by all video files in YUV 4:2:0 format.</note></para></remarks>
+				///
+				property VideoEncoderOptions^ EncoderOptions
+				{
+					VideoEncoderOptions^ get()
+					{
+						return m_encoderOptions;
+					}
+				}
+
+			private:
+
+				void Init(String^ fileName, int width, int height, VideoCodec codec, int bitRate)
+				{
+					if (fileName == nullptr)
+						throw gcnew ArgumentNullException("fileName");
+					if ((width < 0) || (height < 0) || ((width == 0) != (height == 0)))
+						throw gcnew ArgumentException("Width and height must be both positive or both zero.");
+
+					m_fileName = fileName;
+					m_width = width;
+					m_height = height;
+					m_codec = codec;
+					m_bitRate = bitRate;
+					m_encoderOptions = gcnew VideoEncoderOptions();
+				}
+			};
+
+			/// <summary>
+			/// Class for writing the same video into several video files of different size, codec and bit rate.
+			/// </summary>
+			///
+			/// <remarks><para>The class is an alternative to writing every frame with several instances of
+			/// <see cref="VideoFileWriter"/>, which would convert each frame from RGB to YUV for each video file. Here
+			/// the frame is locked and converted to YUV 4:2:0 only once, frames of smaller video files are scaled from the
+			/// converted frame (which is cheaper than converting RGB frame again) and frames of video files of the same
+			/// size share the scaled frame. Scaling and encoding of all video files run in parallel.</para>
+			///
+			/// <para><note>Video files are given frames in YUV 4:2:0 format, which most encoders take as they are
+			/// (H.264, H.265, MPEG-4 and others). Video files of codecs working with other formats, like MJPEG,
+			/// which takes full range YUV, still convert each frame to their format.</note></para>
+			///
+			/// <para>Sample usage:</para>
+			/// <code>
+			/// VideoRenditionWriter writer = new VideoRenditionWriter( );
+			/// writer.Open( 1920, 1080, 30, new VideoRendition[]
+			/// {
+			///     new VideoRendition( "archive.mp4", VideoCodec.h264, 8000000 ),
+			///     new VideoRendition( "preview.mp4", 640, 360, VideoCodec.h264, 500000 )
+			/// } );
+			///
+			/// // write frames, each one goes to both video files
+			/// writer.WriteVideoFrame( image );
+			/// // ...
+			/// writer.Close( );
+			/// </code>
+			/// </remarks>
+			///
+			public ref class VideoRenditionWriter : IDisposable
+			{
+				int m_width;
+				int m_height;
+				Rational m_frameRate;
+
+				int m_queueSize;
+				bool m_variableFrameRate;
+
+				// private data of the class
+				RenditionWriterPrivateData^ data;
+				bool disposed;
+
+				// Checks if video files were opened
+				void CheckIfVideoFileIsOpen()
+				{
+					if (data == nullptr)
+						throw gcnew System::IO::IOException("Video files are not open, so can not access their properties.");
+				}
+
+				// Check if the object was already disposed
+				void CheckIfDisposed()
+				{
+					if (disposed)
+						throw gcnew System::ObjectDisposedException("The object was already disposed.");
+				}
+
+				void WriteFrame(BitmapData^ bitmapData, bool hasTimestamp, TimeSpan timestamp);
+
+			protected:
+				/// <summary>
+				/// Object's finalizer.
+				/// </summary>
+				///
+				!VideoRenditionWriter()
+				{
+					Close();
+				}
+
+			public:
+
+				/// <summary>
+				/// Initializes a new instance of the <see cref="VideoRenditionWriter"/> class.
+				/// </summary>
+				///
+				VideoRenditionWriter();
+
+				/// <summary>
+				/// Disposes the object and frees its resources.
+				/// </summary>
+				///
+				~VideoRenditionWriter()
+				{
+					this->!VideoRenditionWriter();
+					disposed = true;
+				}
+
+				/// <summary>
+				/// Width of written frames.
+				/// </summary>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video files were open.</exception>
+				///
+				property int Width
+				{
+					int get()
+					{
+						CheckIfVideoFileIsOpen();
+						return m_width;
+					}
+				}
+
+				/// <summary>
+				/// Height of written frames.
+				/// </summary>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video files were open.</exception>
+				///
+				property int Height
+				{
+					int get()
+					{
+						CheckIfVideoFileIsOpen();
+						return m_height;
+					}
+				}
+
+				/// <summary>
+				/// Frame rate of the video files.
+				/// </summary>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video files were open.</exception>
+				///
+				property Rational FrameRate
+				{
+					Rational get()
+					{
+						CheckIfVideoFileIsOpen();
+						return m_frameRate;
+					}
+				}
+
+				/// <summary>
+				/// The property specifies if video files are opened or not by this instance of the class.
+				/// </summary>
+				///
+				property bool IsOpen
+				{
+					bool get()
+					{
+						return (data != nullptr);
+					}
+				}
+
+				/// <summary>
+				/// Size of asynchronous encoding queue of each video file.
+				/// </summary>
+				///
+				/// <remarks><para>See <see cref="VideoFileWriter::QueueSize"/>. Video files are encoded in parallel
+				/// even when the property is set to <b>0</b>, but then writing a frame waits until it is encoded into all
+				/// video files.</para>
+				///
+				/// <para><note>The property is taken into account when video files are opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <b>0</b>.</para>
+				/// </remarks>
+				///
+				property int QueueSize
+				{
+					int get()
+					{
+						return m_queueSize;
+					}
+					void set(int queueSize)
+					{
+						m_queueSize = System::Math::Max(0, queueSize);
+					}
+				}
+
+				/// <summary>
+				/// Use presentation time of frames instead of fixed frame rate.
+				/// </summary>
+				///
+				/// <remarks><para>See <see cref="VideoFileWriter::VariableFrameRate"/>.</para>
+				///
+				/// <para><note>The property is taken into account when video files are opened, so it
+				/// must be set before calling <see cref="Open"/>.</note></para>
+				///
+				/// <para>Default value is set to <see langword="false"/>.</para>
+				/// </remarks>
+				///
+				property bool VariableFrameRate
+				{
+					bool get()
+					{
+						return m_variableFrameRate;
+					}
+					void set(bool variableFrameRate)
+					{
+						m_variableFrameRate = variableFrameRate;
+					}
+				}
+
+				/// <summary>
+				/// Create video files of all the specified renditions.
+				/// </summary>
+				///
+				/// <param name="width">Width of frames, which are going to be written.</param>
+				/// <param name="height">Height of frames, which are going to be written.</param>
+				/// <param name="frameRate">Frame rate of the video files.</param>
+				/// <param name="renditions">Video files to create.</param>
+				///
+				/// <remarks><para>If any of the video files cannot be created, none of them is kept open.</para></remarks>
+				///
+				/// <exception cref="ArgumentNullException">Renditions are not specified.</exception>
+				/// <exception cref="ArgumentException">At least one rendition must be specified.</exception>
+				/// <exception cref="ArgumentException">Lossless encoding is not supported.</exception>
+				/// <exception cref="ArgumentException">Video file resolution must be a multiple of two.</exception>
+				/// <exception cref="ArgumentException">Invalid video codec is specified.</exception>
+				/// <exception cref="VideoException">A error occurred while creating new video file. See exception message.</exception>
+				/// <exception cref="System::IO::IOException">Cannot open video file with the specified name.</exception>
+				///
+				void Open(int width, int height, Rational frameRate, array<VideoRendition^>^ renditions);
+
+				/// <summary>
+				/// Write new video frame into all opened video files.
+				/// </summary>
+				///
+				/// <param name="frame">Bitmap to add as a new video frame.</param>
+				///
+				/// <remarks><para>The specified bitmap must be either color 24 or 32 bpp image or grayscale 8 bpp (indexed) image.</para></remarks>
+				///
+				/// <exception cref="System::IO::IOException">Thrown if no video files were open.</exception>
+				/// <exception cref="ArgumentException">The provided bitmap must be 24 or 32 bpp color image or 8 bpp grayscale image.</exception>
+				/// <exception cref="ArgumentException">Bitmap size must be of the same as video size, which was specified on opening video files.</exception>
+				/// <exception cref="VideoException">A error occurred while writing new video frame. See exception message.</exception>
+				///
+				void WriteVideoFrame(Bitmap^ frame);
+
+				/// <summary>
+				/// Write new video frame with a specific timestamp into all opened video files.
+				/// </summary>
+				///
+				/// <param name="frame">Bitmap to add as a new video frame.</param>
+				/// <param name="timestamp">Frame timestamp, total time since recording started.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="VideoFileWriter::WriteVideoFrame( Bitmap^, TimeSpan )"/>
+				/// for more information and to the <see cref="WriteVideoFrame( Bitmap^ )"/> for the list of possible exceptions.</para></remarks>
+				///
+				void WriteVideoFrame(Bitmap^ frame, TimeSpan timestamp);
+
+				/// <summary>
+				/// Write new video frame into all opened video files.
+				/// </summary>
+				///
+				/// <param name="frame">Bitmap data to add as a new video frame.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteVideoFrame( Bitmap^ )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteVideoFrame(BitmapData^ frame)
+				{
+					WriteFrame(frame, false, TimeSpan::Zero);
+				}
+
+				/// <summary>
+				/// Write new video frame with a specific timestamp into all opened video files.
+				/// </summary>
+				///
+				/// <param name="frame">Bitmap data to add as a new video frame.</param>
+				/// <param name="timestamp">Frame timestamp, total time since recording started.</param>
+				///
+				/// <remarks><para>See documentation to the <see cref="WriteVideoFrame( Bitmap^, TimeSpan )"/>
+				/// for more information and the list of possible exceptions.</para></remarks>
+				///
+				void WriteVideoFrame(BitmapData^ frame, TimeSpan timestamp)
+				{
+					WriteFrame(frame, true, timestamp);
+				}
+
+				/// <summary>
+				/// Flushes write buffers of all video files.
+				/// </summary>
+				///
+				/// <remarks><para>See <see cref="VideoFileWriter::Flush"/>.</para></remarks>
+				///
+				void Flush();
+
+				/// <summary>
+				/// Close currently opened video files if any.
+				/// </summary>
+				///
+				void Close();
+			};
+		}
+	}
+}
@@ -0,0 +1,38 @@
+// AForge FFMPEG Library
+// AForge.NET framework
+// http://www.aforgenet.com/framework/
+//
+// Copyright © AForge.NET, 2009-2011
+// contacts@aforgenet.com
+//
+
+#pragma once
+
+namespace AForge
+{
+	namespace Video
+	{
+		namespace FFMPEG
+		{
+			/// <summary>
+			/// Enumeration of multithreading methods, which can be used by video encoders and decoders.
+			/// </summary>
+			///
+			public enum class VideoThreadingMode
+			{
+				/// <summary>
+				///   Several frames are encoded or decoded in parallel. Gives the best throughput, but the
+				///   codec delays output by about one frame per thread.
+				/// </summary>
+				Frame,
+
+				/// <summary>
+				///   Slices of a single frame are encoded or decoded in parallel. Does not add any delay,
+				///   but scales worse and slightly reduces compression efficiency. Decoders can use it
+				///   only for video, which was encoded with several slices per frame.
+				/// </summary>
+				Slice,
+			};
+		}
+	}
+}
@@ -3,6 +3,7 @@ using AForge.Video.DirectShow;
 using AForge.Video.FFMPEG;
 using Properties;
 using System;
+using System.Diagnostics;
 using System.Drawing;
 using System.Drawing.Imaging;
 using System.Globalization;
@@ -16,11 +17,12 @@ public class WebCam : MeasurementScript, IDisposable
     private VideoCaptureDevice videoSource;
     private VideoFileWriter vfw;
     private int height, width, fr;
-    private bool saveRequested, videoRequested;
+    private bool saveRequested, videoRequested, videoArmed;
     private string SnapShotName = "";
     private readonly object lockobj = new object();
     private TimeSpan stillMeasurementTime, videoMeasurementTime;
     private DateTime stillTriggerTime, videoTriggerTime;
+    private long videoStartTimestamp;
 
     private readonly Bitmap logo = Resources.logoNew;
     private PointF logoPoint;
@@ -31,7 +33,7 @@ public class WebCam : MeasurementScript, IDisposable
     private readonly Font drawFont = new Font("Courier New", 20);
     private readonly StringFormat sf = new StringFormat(StringFormatFlags.NoWrap) { Alignment = StringAlignment.Far };
 
-    private delegate void AsyncMethodCaller(Bitmap frame);
+    private delegate void AsyncMethodCaller(Bitmap frame, long captureTimestamp);
     private AsyncMethodCaller caller;
 
     public override void Initialize()
@@ -117,6 +119,7 @@ public class WebCam : MeasurementScript, IDisposable
             Output.WriteLine("Starting WebCam");
             videoSource.Start();
             ProcessCameraCapabilities();
+            ArmVideo();
         }
     }
 
@@ -157,35 +160,79 @@ public class WebCam : MeasurementScript, IDisposable
         }
     }
 
+    [OnChange(typeof(WebCamSysVar.VideoFileName))]
+    public void VideoFileNameHandler()
+    {
+        if (WebCamSysVar.VideoState.Value != WebCamSysVar.VideoState.Recording)
+        {
+            ArmVideo();
+        }
+    }
+
     [OnChange(typeof(WebCamSysVar.VideoState))]
     public void VideoStateHandler()
     {
         if (WebCamSysVar.VideoState.Value == WebCamSysVar.VideoState.Recording)
         {
-            StopVideo();
-
-            try
+            if ((vfw != null) && videoArmed)
             {
-                vfw = new VideoFileWriter();
-                vfw.Open(WebCamSysVar.VideoFileName.Value, width, height, fr, VideoCodec.Default, WebCamSysVar.VideoBitRate.Value);
-                videoMeasurementTime = Measurement.CurrentTime;
-                videoTriggerTime = DateTime.Now;
-                videoRequested = true;
+                // the video is already being encoded, so just start writing it including the pre-trigger part
+                vfw.Trigger();
+                videoArmed = false;
             }
-            catch (Exception ex)
+            else
             {
-                Output.WriteLine(ex.ToString());
+                StopVideo();
+                OpenVideo(TimeSpan.Zero);
             }
         }
         else
         {
-            StopVideo();
+            // stop recording, pre-trigger video for the next one is kept from now on
+            ArmVideo();
+        }
+    }
+
+    private void ArmVideo()
+    {
+        StopVideo();
+
+        // keep the last seconds of video in memory, so the recording contains what happened before it was started
+        if ((WebCamSysVar.VideoPreTrigger.Value > 0) && !string.IsNullOrWhiteSpace(WebCamSysVar.VideoFileName.Value) &&
+            (videoSource != null) && videoSource.IsRunning)
+        {
+            OpenVideo(TimeSpan.FromSeconds(WebCamSysVar.VideoPreTrigger.Value));
+        }
+    }
+
+    private void OpenVideo(TimeSpan preTriggerDuration)
+    {
+        try
+        {
+            vfw = new VideoFileWriter();
+            // encode on a separate thread, so a slow encoder or disk does not hold the lock
+            vfw.QueueSize = 16;
+            vfw.QueuePolicy = VideoQueuePolicy.Block;
+            // store frames at the time they were captured, the camera may deliver less than nominal frame rate
+            vfw.VariableFrameRate = true;
+            vfw.PreTriggerDuration = preTriggerDuration;
+            vfw.Open(WebCamSysVar.VideoFileName.Value, width, height, fr, VideoCodec.Default, WebCamSysVar.VideoBitRate.Value);
+            videoMeasurementTime = Measurement.CurrentTime;
+            videoTriggerTime = DateTime.Now;
+            videoStartTimestamp = Stopwatch.GetTimestamp();
+            videoArmed = (preTriggerDuration > TimeSpan.Zero);
+            videoRequested = true;
+        }
+        catch (Exception ex)
+        {
+            Output.WriteLine(ex.ToString());
         }
     }
 
     private void StopVideo()
     {
         videoRequested = false;
+        videoArmed = false;
         if (vfw != null)
         {
             // try to obtain lock, frame capture should always complete within 100 ms
@@ -215,9 +262,12 @@ public class WebCam : MeasurementScript, IDisposable
     {
         try
         {
+            // take the capture time before the frame is queued for saving
+            long captureTimestamp = Stopwatch.GetTimestamp();
+
             // call each save method asynchronously
             foreach (AsyncMethodCaller amc in caller.GetInvocationList())
-                amc.BeginInvoke((Bitmap)eventArgs.Frame.Clone(), null, null);
+                amc.BeginInvoke((Bitmap)eventArgs.Frame.Clone(), captureTimestamp, null, null);
         }
         catch (Exception ex)
         {
@@ -225,7 +275,7 @@ public class WebCam : MeasurementScript, IDisposable
         }
     }
 
-    private void SaveSnapShot(Bitmap frame)
+    private void SaveSnapShot(Bitmap frame, long captureTimestamp)
     {
         if (saveRequested)
         {
@@ -274,7 +324,7 @@ public class WebCam : MeasurementScript, IDisposable
         frame.Dispose();
     }
 
-    private void SaveVideo(Bitmap frame)
+    private void SaveVideo(Bitmap frame, long captureTimestamp)
     {
         if (videoRequested)
         {
@@ -286,7 +336,9 @@ public class WebCam : MeasurementScript, IDisposable
 
                 try
                 {
-                    vfw.WriteVideoFrame(b);
+                    // time since recording started, frames captured before the start are put at its beginning
+                    long ticks = (long)((captureTimestamp - videoStartTimestamp) * ((double)TimeSpan.TicksPerSecond / Stopwatch.Frequency));
+                    vfw.WriteVideoFrame(b, TimeSpan.FromTicks(ticks));
                 }
                 catch (Exception ex)
                 {